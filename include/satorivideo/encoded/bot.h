@@ -0,0 +1,61 @@
+// Encoded bot API.
+// Bots that only need bitstream information, like key frame cadence, bitrate or
+// stream health, get frames as they come from the source, without decoding and scaling.
+
+#pragma once
+
+#include <satorivideo/video_bot.h>
+#include <cstddef>
+#include <string>
+
+namespace satori {
+namespace video {
+
+// Codec parameters of the stream
+EXPORT struct encoded_stream_metadata {
+  // FFmpeg codec name, like h264 or vp9
+  std::string codec_name;
+  // Codec specific data, like SPS and PPS of h264
+  std::string codec_data;
+};
+
+// Encoded frame, data is valid only during the callback
+EXPORT struct encoded_frame_view {
+  frame_id id;
+  const uint8_t *data;
+  size_t size;
+  bool key_frame;
+  // Time when the frame came from network, file or camera
+  std::chrono::system_clock::time_point arrival_time;
+  // Presentation time of the frame, as reported by the video source
+  std::chrono::system_clock::time_point capture_time;
+};
+
+// metadata holds the latest codec parameters, it is empty until the source sends them
+using encoded_bot_frame_callback_t =
+    std::function<void(bot_context &context, const encoded_stream_metadata &metadata,
+                       const encoded_frame_view &frame)>;
+
+struct encoded_bot_descriptor {
+  // Invoked on every received frame, frames are dropped only if the input queue
+  // overflows, see --max-queued-frames and --memory-budget-mb
+  encoded_bot_frame_callback_t frame_callback;
+
+  // Invoked on every received control command, guaranteed to be invoked during
+  // initialization
+  bot_ctrl_callback_t ctrl_callback;
+
+  // Distinguishes bots registered in the same process, see bot_descriptor::name
+  std::string name;
+};
+
+// Registers encoded bot.
+// Should be called by bot implementation before starting a bot.
+// Several encoded bots can be registered, but not along with image bots.
+EXPORT void encoded_bot_register(const encoded_bot_descriptor &bot);
+
+// Starts a bot (e.g. launches main event loop).
+// A bot implementation should be registered before calling this method.
+EXPORT int encoded_bot_main(int argc, char *argv[]);
+}  // namespace video
+}  // namespace satori
@@ -24,10 +24,22 @@ struct multiframe_bot_descriptor {
   // Invoked on every received control command, guaranteed to be invoked during
   // initialization
   bot_ctrl_callback_t ctrl_callback;
+
+  // Number of downscaled image copies to build along with every frame,
+  // each one is two times smaller than the previous one
+  uint8_t pyramid_levels{0};
+
+  // Part of the frame the bot is interested in, it is cropped before scaling
+  // and pixel format conversion, see bot_set_region_of_interest()
+  image_region region_of_interest{0, 0, 1, 1};
+
+  // Distinguishes bots registered in the same process, see bot_descriptor::name
+  std::string name;
 };
 
 // Registers opencv bot.
 // Should be called by bot implementation before starting a bot.
+// Several bots can be registered, they share one decoded stream.
 EXPORT void multiframe_bot_register(const multiframe_bot_descriptor &bot);
 
 // Starts a bot (e.g. launches main event loop).
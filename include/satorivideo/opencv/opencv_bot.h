@@ -20,6 +20,19 @@ struct opencv_bot_descriptor {
   // Invoked on every received control command, guaranteed to be invoked during
   // initialization
   bot_ctrl_callback_t ctrl_callback;
+
+  // BGR gives CV_8UC3 images, GRAY8 gives CV_8UC1 images,
+  // YUV420P and NV12 give CV_8UC1 images of luma plane only
+  image_pixel_format pixel_format{image_pixel_format::BGR};
+
+  // Part of the frame the bot is interested in, see bot_set_region_of_interest()
+  image_region region_of_interest{0, 0, 1, 1};
+
+  // Number of frames processed at the same time, see bot_descriptor::concurrency
+  uint8_t concurrency{1};
+
+  // Distinguishes bots registered in the same process, see bot_descriptor::name
+  std::string name;
 };
 
 // Registers opencv bot.
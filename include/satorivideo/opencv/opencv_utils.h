@@ -41,6 +41,17 @@ cv::Rect2d rect_from_json(const nlohmann::json &item);
 // logs/frame1.jpg, logs/frame2.jpg and logs/frame3.jpg
 void log_image(const cv::Mat &image);
 
+// Tile callback receives a view of the image (no copy), its position in the image
+// and tile index, see image_tile::index
+using tile_callback_t =
+    std::function<void(const cv::Mat &tile, const cv::Rect &rect, int index)>;
+
+// OpenCV variant of bot_process_tiles(): splits the image into overlapping tiles
+// and invokes the callback for every tile on a thread pool shared by the process.
+// Returns when all tiles are processed.
+void process_tiles(const cv::Mat &image, const image_tiling &tiling,
+                   const tile_callback_t &callback);
+
 }  // namespace opencv
 }  // namespace video
 }  // namespace satori
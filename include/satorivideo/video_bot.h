@@ -11,9 +11,11 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <json.hpp>
+#include <string>
 
 #include "base.h"
 
@@ -36,6 +38,14 @@ EXPORT struct frame_id {
 
 constexpr uint8_t max_image_planes = 4;
 
+// Max number of downscaled copies (pyramid levels) an image can carry
+constexpr uint8_t max_image_levels = 4;
+
+// Downscaled copy of an image, plane layout is the same as in image_frame
+EXPORT struct image_level {
+  const uint8_t *plane_data[max_image_planes];
+};
+
 // If an image uses packed pixel format like packed RGB or packed YUV,
 // then it has only a single plane, e.g. all it's data is within plane_data[0].
 // If an image uses planar pixel format like planar YUV or HSV,
@@ -45,6 +55,28 @@ constexpr uint8_t max_image_planes = 4;
 EXPORT struct image_frame {
   frame_id id;
   const uint8_t *plane_data[max_image_planes];
+  // Image pyramid, levels[i] is 2^(i+1) times smaller than the frame itself,
+  // only first image_metadata::levels_count entries are filled in
+  image_level levels[max_image_levels];
+  // Time when the frame came from network, file or camera
+  std::chrono::system_clock::time_point arrival_time;
+  // Time when the frame was captured by the video source, as reported by the source
+  std::chrono::system_clock::time_point capture_time;
+};
+
+// Rectangle in fractional coordinates, e.g. {0, 0, 1, 1} is the whole frame
+// and {0.5, 0, 0.5, 1} is its right half, see opencv::to_fractional
+EXPORT struct image_region {
+  double x;
+  double y;
+  double width;
+  double height;
+};
+
+EXPORT struct image_level_metadata {
+  uint16_t width;
+  uint16_t height;
+  uint32_t plane_strides[max_image_planes];
 };
 
 // Metadata contains information which is unchangeable for a channel
@@ -52,6 +84,8 @@ EXPORT struct image_metadata {
   uint16_t width;
   uint16_t height;
   uint32_t plane_strides[max_image_planes];
+  uint8_t levels_count;
+  image_level_metadata levels[max_image_levels];
 };
 
 // In batch mode, framework is waiting for each frame to be processed
@@ -86,7 +120,11 @@ using bot_img_callback_t =
 using bot_ctrl_callback_t =
     std::function<nlohmann::json(bot_context &context, const nlohmann::json &message)>;
 
-enum class image_pixel_format { RGB0 = 1, BGR = 2 };
+// GRAY8 contains only luma plane. YUV420P and NV12 are planar formats with
+// chroma planes of half width and half height, for NV12 U and V are interleaved
+// in plane_data[1]. When the decoder produces the requested format and
+// no scaling is needed, decoded planes are passed to the bot without conversion.
+enum class image_pixel_format { RGB0 = 1, BGR = 2, GRAY8 = 3, YUV420P = 4, NV12 = 5 };
 
 struct bot_descriptor {
   // Pixel format, like RGB0, BGR, etc.
@@ -98,6 +136,25 @@ struct bot_descriptor {
   // Invoked on every received control command, guaranteed to be invoked during
   // initialization
   bot_ctrl_callback_t ctrl_callback;
+
+  // Number of downscaled image copies to build along with every frame,
+  // each one is two times smaller than the previous one
+  uint8_t pyramid_levels{0};
+
+  // Part of the frame the bot is interested in, it is cropped before scaling
+  // and pixel format conversion, see bot_set_region_of_interest()
+  image_region region_of_interest{0, 0, 1, 1};
+
+  // Up to this number of frames of a batch are processed at the same time, on different
+  // threads, the next batch starts after all of them are done.
+  // Only for bots that don't keep state between frames: every thread gets its own
+  // bot_context, the control callback receives configure and shutdown for each of them,
+  // so that every thread has its own instance_data. Messages are published in frame order.
+  uint8_t concurrency{1};
+
+  // Required when several bots are registered in the same process, they all get
+  // frames of one decoder and their bot id becomes "<id>.<name>"
+  std::string name;
 };
 
 // Used by bot implementation to specify type of output.
@@ -109,6 +166,46 @@ EXPORT enum class bot_message_kind { ANALYSIS = 1, DEBUG = 2, CONTROL = 3 };
 EXPORT void bot_message(bot_context &context, bot_message_kind kind,
                         nlohmann::json &&message, const frame_id &id = frame_id{0, 0});
 
+// Changes the part of the frame that is delivered to the bot.
+// Can be called from image or control callback, e.g. while handling "configure"
+// command. New region is applied starting from one of the next frames,
+// so frame_metadata may change. Regions without area inside the frame are ignored,
+// and so are all regions if several bots are registered, since they share frames.
+EXPORT void bot_set_region_of_interest(bot_context &context, const image_region &region);
+
+// How bot_process_tiles() splits a frame
+EXPORT struct image_tiling {
+  uint8_t columns{2};
+  uint8_t rows{2};
+  // Pixels every tile extends into its neighbours, an object crossing a border
+  // is fully visible in one of the tiles if it is not bigger than overlap
+  uint16_t overlap{0};
+};
+
+// Part of a frame. Planes point into the frame data, so plane strides are
+// the ones of the frame, see image_metadata::plane_strides
+EXPORT struct image_tile {
+  // Row by row, from 0 to columns * rows - 1
+  int index;
+  // Position and size in the frame, in pixels, overlap included
+  uint16_t x;
+  uint16_t y;
+  uint16_t width;
+  uint16_t height;
+  const uint8_t *plane_data[max_image_planes];
+};
+
+using bot_tile_callback_t = std::function<void(const image_tile &tile)>;
+
+// Splits the frame into overlapping tiles and invokes the callback for every tile
+// on a thread pool shared by the process. Returns when all tiles are processed.
+// Callback is invoked concurrently, so it shouldn't call bot_message(): store results
+// by tile index and send them after this function returns.
+// Tile edges are aligned to 2 pixels for YUV420P and NV12, so chroma planes match.
+EXPORT void bot_process_tiles(bot_context &context, const image_frame &frame,
+                              const image_tiling &tiling,
+                              const bot_tile_callback_t &callback);
+
 // Registers a bot.
 // Should be called by bot implementation before starting a bot.
 EXPORT void bot_register(const bot_descriptor &bot);
@@ -85,6 +85,30 @@ void dump_filters() {
   LOG(1) << "available filters: " << filters_buffer.str();
 }
 
+// Chroma planes of subsampled formats have less lines than the image itself.
+int plane_height(const AVFrame &frame, uint8_t plane) {
+  const AVPixFmtDescriptor *descriptor =
+      av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame.format));
+  if (descriptor == nullptr || (plane != 1 && plane != 2)) {
+    return frame.height;
+  }
+  const int shift = descriptor->log2_chroma_h;
+  return (frame.height + (1 << shift) - 1) >> shift;
+}
+
+// Copies planes of frames and pyramid levels.
+void copy_planes(const AVFrame &frame, std::string (&plane_data)[max_image_planes],
+                 uint32_t (&plane_strides)[max_image_planes]) {
+  for (uint8_t i = 0; i < max_image_planes; i++) {
+    const auto plane_stride = static_cast<uint32_t>(frame.linesize[i]);
+    plane_strides[i] = plane_stride;
+    if (plane_stride > 0) {
+      const uint8_t *data = frame.data[i];
+      plane_data[i].assign(data, data + (plane_stride * plane_height(frame, i)));
+    }
+  }
+}
+
 }  // namespace
 
 void init() {
@@ -153,6 +177,12 @@ AVPixelFormat to_av_pixel_format(image_pixel_format pixel_format) {
       return AV_PIX_FMT_BGR24;
     case image_pixel_format::RGB0:
       return AV_PIX_FMT_RGB0;
+    case image_pixel_format::GRAY8:
+      return AV_PIX_FMT_GRAY8;
+    case image_pixel_format::YUV420P:
+      return AV_PIX_FMT_YUV420P;
+    case image_pixel_format::NV12:
+      return AV_PIX_FMT_NV12;
     default:
       throw std::runtime_error{"Unsupported pixel format: "
                                + std::to_string((int)pixel_format)};
@@ -165,6 +195,12 @@ image_pixel_format to_image_pixel_format(AVPixelFormat pixel_format) {
       return image_pixel_format::BGR;
     case AV_PIX_FMT_RGB0:
       return image_pixel_format::RGB0;
+    case AV_PIX_FMT_GRAY8:
+      return image_pixel_format::GRAY8;
+    case AV_PIX_FMT_YUV420P:
+      return image_pixel_format::YUV420P;
+    case AV_PIX_FMT_NV12:
+      return image_pixel_format::NV12;
     default:
       throw std::runtime_error{"Unsupported pixel format: "
                                + std::to_string((int)pixel_format)};
@@ -182,6 +218,13 @@ std::shared_ptr<AVCodecContext> encoder_context(const AVCodecID codec_id) {
   }
   LOG(1) << "Encoder '" << encoder_name << "' was found";
 
+  return encoder_context(encoder);
+}
+
+std::shared_ptr<AVCodecContext> encoder_context(const AVCodec *encoder) {
+  const std::string encoder_name = encoder->name;
+  const AVCodecID codec_id = encoder->id;
+
   if (encoder->pix_fmts == nullptr) {
     LOG(ERROR) << "Encoder '" << encoder_name << "' doesn't support any pixel format";
     return nullptr;
@@ -440,18 +483,22 @@ owned_image_frame to_image_frame(const AVFrame &frame) {
   image.timestamp =
       std::chrono::system_clock::time_point{std::chrono::milliseconds(frame.pts)};
 
-  for (uint8_t i = 0; i < max_image_planes; i++) {
-    const auto plane_stride = static_cast<uint32_t>(frame.linesize[i]);
-    image.plane_strides[i] = plane_stride;
-    if (plane_stride > 0) {
-      const uint8_t *plane_data = frame.data[i];
-      image.plane_data[i].assign(plane_data, plane_data + (plane_stride * frame.height));
-    }
-  }
+  copy_planes(frame, image.plane_data, image.plane_strides);
 
   return image;
 }
 
+owned_image_level to_image_level(const AVFrame &frame) {
+  owned_image_level level;
+
+  level.width = static_cast<uint16_t>(frame.width);
+  level.height = static_cast<uint16_t>(frame.height);
+
+  copy_planes(frame, level.plane_data, level.plane_strides);
+
+  return level;
+}
+
 std::shared_ptr<allocated_image> allocate_image(const image_size &size,
                                                 image_pixel_format pixel_format) {
   uint8_t *data[max_image_planes];
@@ -510,6 +557,9 @@ AVCodecID codec_id(const std::string &codec_name) {
   if (codec_name == "h264") {
     return AV_CODEC_ID_H264;
   }
+  if (codec_name == "mjpeg") {
+    return AV_CODEC_ID_MJPEG;
+  }
   ABORT() << "unsupported codec: " << codec_name;
 }
 
@@ -38,6 +38,10 @@ image_pixel_format to_image_pixel_format(AVPixelFormat pixel_format);
 // Creates FFmpeg's encoder context for encoder identified by encoder id.
 std::shared_ptr<AVCodecContext> encoder_context(AVCodecID codec_id);
 
+// Creates FFmpeg's encoder context for given encoder, useful when there are
+// several encoders for the same codec id.
+std::shared_ptr<AVCodecContext> encoder_context(const AVCodec *encoder);
+
 // Creates FFmpeg's decoder context for decoder identified by name.
 std::shared_ptr<AVCodecContext> decoder_context(const std::string &codec_name,
                                                 gsl::cstring_span<> extra_data);
@@ -86,6 +90,9 @@ void copy_image_to_av_frame(const owned_image_frame &image,
 // Converts AVFrame to image frame
 owned_image_frame to_image_frame(const AVFrame &frame);
 
+// Converts AVFrame to image pyramid level
+owned_image_level to_image_level(const AVFrame &frame);
+
 struct allocated_image {
   uint8_t *data[max_image_planes];
   int linesize[max_image_planes];
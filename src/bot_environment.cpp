@@ -6,18 +6,25 @@
 #include <fstream>
 #include <gsl/gsl>
 #include <json.hpp>
+#include <mutex>
+#include <thread>
 
 #include "avutils.h"
 #include "bot_instance.h"
 #include "bot_instance_builder.h"
 #include "logging_impl.h"
 #include "ostream_sink.h"
+#include "profiling.h"
+#include "resource_governor.h"
 #include "rtm_streams.h"
 #include "signal_utils.h"
 #include "streams/asio_streams.h"
-#include "streams/signal_breaker.h"
+#include "streams/broadcast.h"
+#include "streams/manual_breaker.h"
 #include "streams/threaded_worker.h"
 #include "tcmalloc.h"
+#include "threadutils.h"
+#include "tracing.h"
 
 namespace satori {
 namespace video {
@@ -50,6 +57,29 @@ po::options_description bot_custom_options() {
   bot_execution_options.add_options()("max-queued-frames",
                                       po::value<size_t>(),
                                       "limits bot input queue size");
+  bot_execution_options.add_options()(
+      "pool-capacity", po::value<size_t>()->default_value(1),
+      "max number of jobs this process runs at the same time in pool mode");
+  bot_execution_options.add_options()(
+      "trace-file", po::value<std::string>()->default_value("trace.json"),
+      "file for the timeline of pipeline stages, recorded on SIGUSR1 or trace command");
+  bot_execution_options.add_options()(
+      "trace-duration-ms",
+      po::value<size_t>()->default_value(tracing::default_duration.count()),
+      "duration of the timeline recorded on SIGUSR1");
+  bot_execution_options.add_options()(
+      "profile-dir", po::value<std::string>()->default_value("."),
+      "directory for cpu and heap profiles, recorded on SIGUSR2 or start_profiling command");
+  bot_execution_options.add_options()(
+      "profile-duration-ms",
+      po::value<size_t>()->default_value(profiling::default_duration.count()),
+      "duration of the profiles recorded on SIGUSR2");
+  bot_execution_options.add_options()(
+      "memory-budget-mb", po::value<size_t>()->default_value(0),
+      "max memory held by frame and message buffers, sheds load when exceeded");
+  bot_execution_options.add_options()(
+      "cpu-budget-percent", po::value<double>()->default_value(0),
+      "max process cpu usage, 100 is a single core, sheds load when exceeded");
 
   return bot_configuration_options.add(bot_execution_options)
       .add(metrics_options())
@@ -65,6 +95,7 @@ cli_streams::cli_options bot_cli_cfg() {
   cli_cfg.enable_url_input = true;
   cli_cfg.enable_file_batch_mode = true;
   cli_cfg.enable_pool_mode = true;
+  cli_cfg.enable_shm_input = true;
   return cli_cfg;
 }
 
@@ -94,6 +125,43 @@ nlohmann::json init_config(const po::variables_map& vm) {
 
   return json_config;
 }
+
+// bots registered in the same process are told apart by their names
+std::string bot_id(const std::string& id, const multiframe_bot_descriptor& bot,
+                   size_t bots_count) {
+  if (bots_count == 1) {
+    return id;
+  }
+  return id.empty() ? bot.name : id + "." + bot.name;
+}
+
+// state of several bots is an object with bot names as keys
+nlohmann::json bot_state(const nlohmann::json& state, const multiframe_bot_descriptor& bot,
+                         size_t bots_count) {
+  if (bots_count == 1 || state.is_null()) {
+    return state;
+  }
+  if (!state.is_object() || state.find(bot.name) == state.end()) {
+    return nullptr;
+  }
+  return state[bot.name];
+}
+
+// every bot has its own queue, so a slow bot drops frames without delaying others
+template <typename Packet>
+streams::publisher<bot_input> queued_frames(streams::publisher<Packet>&& frames,
+                                            const bot_configuration& config) {
+  if (!config.video_cfg.batch) {
+    return std::move(frames)
+           >> streams::threaded_worker("processing_worker", config.max_queued_frames, true)
+           >> streams::map([](std::queue<Packet>&& q) { return bot_input{std::move(q)}; });
+  }
+  return std::move(frames) >> streams::map([](Packet&& pkt) {
+           std::queue<Packet> q;
+           q.push(std::move(pkt));
+           return bot_input{std::move(q)};
+         });
+}
 }  // namespace
 
 bot_environment& bot_environment::instance() {
@@ -102,27 +170,137 @@ bot_environment& bot_environment::instance() {
 }
 
 void bot_environment::register_bot(const multiframe_bot_descriptor& bot) {
-  _bot_descriptor = bot;
+  CHECK(_encoded_callbacks.empty()) << "image bots can't run along with encoded bots";
+  add_bot_descriptor(bot);
 }
 
-void bot_environment::operator()(const owned_image_metadata& /*metadata*/) {}
-
-void bot_environment::operator()(const owned_image_frame& /*frame*/) {}
+void bot_environment::register_encoded_bot(const encoded_bot_descriptor& bot) {
+  CHECK(_encoded_callbacks.size() == _bot_descriptors.size())
+      << "encoded bots can't run along with image bots";
+  CHECK(bot.frame_callback) << "encoded bot has no frame callback";
+  multiframe_bot_descriptor descriptor{};
+  descriptor.ctrl_callback = bot.ctrl_callback;
+  descriptor.name = bot.name;
+  add_bot_descriptor(descriptor);
+  _encoded_callbacks.push_back(bot.frame_callback);
+}
 
-void bot_environment::operator()(struct bot_message& msg) {
-  switch (msg.kind) {
-    case bot_message_kind::ANALYSIS:
-      _analysis_sink->on_next(std::move(msg.data));
-      break;
-    case bot_message_kind::CONTROL:
-      _control_sink->on_next(std::move(msg.data));
-      break;
-    case bot_message_kind::DEBUG:
-      _debug_sink->on_next(std::move(msg.data));
-      break;
+void bot_environment::add_bot_descriptor(const multiframe_bot_descriptor& bot) {
+  if (!_bot_descriptors.empty()) {
+    // the decoder is shared, so bots can't ask for different frames
+    const multiframe_bot_descriptor& first = _bot_descriptors.front();
+    CHECK(bot.pixel_format == first.pixel_format)
+        << "bots of one process should use the same pixel format";
+    const image_region& r = bot.region_of_interest;
+    const image_region& fr = first.region_of_interest;
+    CHECK(r.x == fr.x && r.y == fr.y && r.width == fr.width && r.height == fr.height)
+        << "bots of one process should use the same region of interest";
+
+    CHECK(!bot.name.empty()) << "bots of one process should have names";
+    for (const multiframe_bot_descriptor& other : _bot_descriptors) {
+      CHECK(!other.name.empty()) << "bots of one process should have names";
+      CHECK(other.name != bot.name) << "bot name is not unique: " << bot.name;
+    }
   }
+  _bot_descriptors.push_back(bot);
 }
 
+// One of the registered bots running as a part of a job
+struct job_bot {
+  std::string name;
+  std::unique_ptr<bot_instance> instance;
+  // frames are cut before the processing queue, so that queued frames still reach the bot
+  std::shared_ptr<streams::breaker_handle> frames_breaker{
+      std::make_shared<streams::breaker_handle>()};
+  std::shared_ptr<streams::breaker_handle> control_breaker{
+      std::make_shared<streams::breaker_handle>()};
+};
+
+struct bot_job : boost::static_visitor<void> {
+  void operator()(const owned_image_metadata& /*metadata*/) {}
+
+  void operator()(const owned_image_frame& /*frame*/) {}
+
+  void operator()(struct bot_message& msg) {
+    switch (msg.kind) {
+      case bot_message_kind::ANALYSIS:
+        analysis_sink->on_next(std::move(msg.data));
+        break;
+      case bot_message_kind::CONTROL:
+        control_sink->on_next(std::move(msg.data));
+        break;
+      case bot_message_kind::DEBUG:
+        debug_sink->on_next(std::move(msg.data));
+        break;
+    }
+  }
+
+  void stop() {
+    for (const job_bot& bot : bots) {
+      bot.frames_breaker->trigger();
+      bot.control_breaker->trigger();
+    }
+  }
+
+  // What the bots returned on shutdown, keyed by names if there are several
+  nlohmann::json shutdown_state() const {
+    if (bots.size() == 1) {
+      return bots.front().instance->shutdown_response();
+    }
+    nlohmann::json state = nlohmann::json::object();
+    for (const job_bot& bot : bots) {
+      if (!bot.instance->shutdown_response().is_null()) {
+        state[bot.name] = bot.instance->shutdown_response();
+      }
+    }
+    return state.empty() ? nlohmann::json(nullptr) : state;
+  }
+
+  // Load of several bots sums busy_percent, other values are the maximum
+  nlohmann::json take_load() {
+    if (bots.size() == 1) {
+      return bots.front().instance->take_load();
+    }
+    nlohmann::json load = nlohmann::json::object();
+    nlohmann::json bots_load = nlohmann::json::object();
+    for (const job_bot& bot : bots) {
+      nlohmann::json bot_load = bot.instance->take_load();
+      for (auto it = bot_load.begin(); it != bot_load.end(); ++it) {
+        const double value = it.value().get<double>();
+        const double current = load.find(it.key()) != load.end()
+                                   ? load[it.key()].get<double>()
+                                   : 0.0;
+        load[it.key()] =
+            it.key() == "busy_percent" ? current + value : std::max(current, value);
+      }
+      bots_load[bot.name] = std::move(bot_load);
+    }
+    load["bots"] = std::move(bots_load);
+    return load;
+  }
+
+  nlohmann::json job;
+  std::vector<job_bot> bots;
+  // set when the pool stops the job
+  job_stopped_callback on_stopped;
+  std::atomic<uint64_t> multiframes_counter{0};
+  // frame pipelines of bots that are still running
+  std::atomic<size_t> running_pipelines{0};
+  // bots that didn't deliver all messages yet, accessed from io_service thread only
+  size_t running_outputs{0};
+
+  // bots deliver messages from their worker threads
+  std::mutex sinks_mutex;
+
+  // completed and freed once all bots delivered their messages
+  streams::observer<nlohmann::json>* analysis_sink;
+  streams::observer<nlohmann::json>* debug_sink;
+  streams::observer<nlohmann::json>* control_sink;
+
+  std::unique_ptr<std::ofstream> analysis_file;
+  std::unique_ptr<std::ofstream> debug_file;
+};
+
 struct env_configuration : cli_streams::configuration {
   env_configuration(int argc, char* argv[])
       : configuration(argc, argv, bot_cli_cfg(), bot_custom_options()) {}
@@ -133,6 +311,21 @@ struct env_configuration : cli_streams::configuration {
                                  : boost::optional<std::string>{};
   }
   std::string id() const { return _vm["id"].as<std::string>(); }
+  size_t pool_capacity() const { return _vm["pool-capacity"].as<size_t>(); }
+  std::string trace_file() const { return _vm["trace-file"].as<std::string>(); }
+  std::string profile_dir() const { return _vm["profile-dir"].as<std::string>(); }
+  std::chrono::milliseconds profile_duration() const {
+    return std::chrono::milliseconds(_vm["profile-duration-ms"].as<size_t>());
+  }
+  std::chrono::milliseconds trace_duration() const {
+    return std::chrono::milliseconds(_vm["trace-duration-ms"].as<size_t>());
+  }
+  resource_governor::budget resource_budget() const {
+    resource_governor::budget b;
+    b.max_bytes = _vm["memory-budget-mb"].as<size_t>() * 1024 * 1024;
+    b.max_cpu_percent = _vm["cpu-budget-percent"].as<double>();
+    return b;
+  }
 };
 
 bot_configuration::bot_configuration(const po::variables_map& vm)
@@ -182,17 +375,42 @@ int bot_environment::main(int argc, char* argv[]) {
   }
   _metrics_config = config.metrics();
   _pool_mode = config.pool().is_initialized();
+  _pool_capacity = config.pool_capacity();
+  CHECK_GT(_pool_capacity, 0) << "bad pool capacity";
+
+  tracing::set_output_file(config.trace_file());
+  const std::chrono::milliseconds trace_duration = config.trace_duration();
+  // tracing and profiling lock mutexes and start threads, which signal handlers can't do
+  signal::register_thread_handler({SIGUSR1}, [trace_duration](int /*signal*/) {
+    tracing::start(trace_duration);
+  });
+
+  profiling::set_output_dir(config.profile_dir());
+  const std::chrono::milliseconds profile_duration = config.profile_duration();
+  signal::register_thread_handler({SIGUSR2}, [profile_duration](int /*signal*/) {
+    profiling::start(true, true, profile_duration);
+  });
+
+  if (!batch) {
+    resource_governor::start(config.resource_budget());
+  }
 
   auto start = [config, this]() {
     if (!_pool_mode) {
-      start_bot(config.bot_config());
+      start_bot(config.bot_config(), nullptr);
     } else {
       std::string pool = config.pool().get();
       // TODO: could use pool-job-type cli option
       std::string job_type = config.id();
 
+      // Metrics are shared by all jobs of the process
+      _metrics_config.push_job = job_type;
+      init_metrics(_metrics_config, _io_service);
+      expose_metrics(_rtm_client.get());
+
       auto job_controller =
-          new pool_job_controller(_io_service, pool, job_type, 1, _rtm_client, *this);
+          new pool_job_controller(_io_service, pool, job_type,
+                                  config.pool_resources(_pool_capacity), _rtm_client, *this);
 
       // Kubernetes sends SIGTERM, and then SIGKILL after 30 seconds
       // https://kubernetes.io/docs/concepts/workloads/pods/pod/#termination-of-pods
@@ -202,6 +420,7 @@ int bot_environment::main(int argc, char* argv[]) {
             job_controller->shutdown();
             delete job_controller;
 
+            _io_service.post([this]() { stop_all_jobs(); });
             _finished = true;
           });
 
@@ -220,6 +439,7 @@ int bot_environment::main(int argc, char* argv[]) {
       LOG(INFO) << "waiting for all threads to finish...";
       std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
+    resource_governor::stop();
   } else {
     start();
   }
@@ -239,132 +459,310 @@ int bot_environment::main(int argc, char* argv[]) {
   return 0;
 }
 
-void bot_environment::start_bot(const bot_configuration& config) {
-  _metrics_config.push_job = config.id;
-  init_metrics(_metrics_config, _io_service);
-  expose_metrics(_rtm_client.get());
+void bot_environment::start_bot(const bot_configuration& config,
+                                const nlohmann::json& job_json,
+                                const nlohmann::json& state) {
+  if (!_pool_mode) {
+    _metrics_config.push_job = config.id;
+    init_metrics(_metrics_config, _io_service);
+    expose_metrics(_rtm_client.get());
+  }
+
+  CHECK(!_bot_descriptors.empty()) << "bot is not registered";
+  auto job = std::make_shared<bot_job>();
+  job->job = job_json;
 
   const bool batch = config.video_cfg.batch;
-  bot_instance_builder builder =
-      bot_instance_builder{_bot_descriptor}
-          .set_execution_mode(batch ? execution_mode::BATCH : execution_mode::LIVE)
-          .set_bot_id(config.id)
-          .set_config(config.bot_config);
-
-  _bot_instance = builder.build();
-  auto single_frame_source = cli_streams::decoded_publisher(
-      _io_service, _rtm_client, config.video_cfg, _bot_descriptor.pixel_format);
-  if (!batch) {
-    _source = std::move(single_frame_source)
-              >> streams::threaded_worker("processing_worker", config.max_queued_frames);
+  const bool encoded = !_encoded_callbacks.empty();
+  const size_t bots_count = _bot_descriptors.size();
+  // region of interest and pixel format are the same for all bots
+  const multiframe_bot_descriptor& first_descriptor = _bot_descriptors.front();
+  uint8_t pyramid_levels = 0;
+  for (const multiframe_bot_descriptor& descriptor : _bot_descriptors) {
+    pyramid_levels = std::max(pyramid_levels, descriptor.pyramid_levels);
+  }
+  // encoded bots have no decoder to tune
+  std::shared_ptr<video::decoder_settings> decoder_settings;
+  if (!encoded) {
+    decoder_settings =
+        std::make_shared<video::decoder_settings>(first_descriptor.region_of_interest);
+  }
+  // frames are shared read-only, so one bot can't change them for the others
+  std::shared_ptr<video::decoder_settings> bot_decoder_settings = decoder_settings;
+  if (bots_count > 1) {
+    LOG(INFO) << bots_count << " bots share the decoder, they can't change resolution, "
+              << "frame rate or region of interest";
+    bot_decoder_settings = nullptr;
+  }
+
+  job->bots.reserve(bots_count);
+  for (size_t i = 0; i < bots_count; i++) {
+    const multiframe_bot_descriptor& descriptor = _bot_descriptors[i];
+    job_bot bot;
+    bot.name = descriptor.name;
+    bot.instance =
+        bot_instance_builder{descriptor}
+            .set_execution_mode(batch ? execution_mode::BATCH : execution_mode::LIVE)
+            .set_bot_id(bot_id(config.id, descriptor, bots_count))
+            .set_channel(config.video_cfg.input_channel.get_value_or(""))
+            .set_config(config.bot_config)
+            .set_state(bot_state(state, descriptor, bots_count))
+            .set_decoder_settings(bot_decoder_settings)
+            .set_encoded_callback(encoded ? _encoded_callbacks[i] : nullptr)
+            .build();
+    job->bots.push_back(std::move(bot));
+  }
+
+  // worker threads cancel the source only after they stop delivering frames,
+  // so the job outlives any bot callback
+  std::vector<streams::publisher<shared_image_packet>> decoded_sources;
+  std::vector<streams::publisher<encoded_packet>> encoded_sources;
+  if (encoded) {
+    // encoded frames are small enough to be copied for every bot
+    encoded_sources = streams::broadcast(
+        cli_streams::encoded_publisher(_io_service, _rtm_client, config.video_cfg)
+            >> streams::do_finally([job]() { LOG(INFO) << "encoded pipeline finished"; }),
+        bots_count);
   } else {
-    _source =
-        std::move(single_frame_source) >> streams::map([](owned_image_packet&& pkt) {
-          std::queue<owned_image_packet> q;
-          q.push(pkt);
-          return q;
-        });
+    // frames are decoded once and shared read-only by all bots of the job
+    decoded_sources = streams::broadcast(
+        cli_streams::decoded_publisher(_io_service, _rtm_client, config.video_cfg,
+                                       first_descriptor.pixel_format, pyramid_levels,
+                                       decoder_settings)
+            >> streams::map([](owned_image_packet&& pkt) {
+                return share_image_packet(std::move(pkt));
+              })
+            >> streams::do_finally([job]() { LOG(INFO) << "decoder pipeline finished"; }),
+        bots_count);
   }
 
   if (config.analysis_file) {
     std::string analysis_file = config.analysis_file.get();
     LOG(INFO) << "saving analysis output to " << analysis_file;
-    _analysis_file = std::make_unique<std::ofstream>(analysis_file.c_str());
-    _analysis_sink = &streams::ostream_sink(*_analysis_file);
+    job->analysis_file = std::make_unique<std::ofstream>(analysis_file.c_str());
+    job->analysis_sink = &streams::ostream_sink(*job->analysis_file);
   } else if (_rtm_client) {
-    _analysis_sink =
+    job->analysis_sink =
         &rtm::sink(_rtm_client, _io_service,
                    config.video_cfg.input_channel.get() + analysis_channel_suffix);
   } else {
-    _analysis_sink = &streams::ostream_sink(std::cout);
+    job->analysis_sink = &streams::ostream_sink(std::cout);
   }
 
   if (config.debug_file) {
     std::string debug_file = config.debug_file.get();
     LOG(INFO) << "saving debug output to " << debug_file;
-    _debug_file = std::make_unique<std::ofstream>(debug_file.c_str());
-    _debug_sink = &streams::ostream_sink(*_debug_file);
+    job->debug_file = std::make_unique<std::ofstream>(debug_file.c_str());
+    job->debug_sink = &streams::ostream_sink(*job->debug_file);
   } else if (_rtm_client) {
-    _debug_sink = &rtm::sink(_rtm_client, _io_service,
-                             config.video_cfg.input_channel.get() + debug_channel_suffix);
+    job->debug_sink =
+        &rtm::sink(_rtm_client, _io_service,
+                   config.video_cfg.input_channel.get() + debug_channel_suffix);
   } else {
-    _debug_sink = &streams::ostream_sink(std::cerr);
+    job->debug_sink = &streams::ostream_sink(std::cerr);
   }
 
+  streams::publisher<nlohmann::json> control_source;
   if (_rtm_client) {
-    _control_sink = &rtm::sink(_rtm_client, _io_service, config.video_cfg.input_channel.get() + control_channel_suffix);
-    _control_source =
+    job->control_sink = &rtm::sink(_rtm_client, _io_service, config.video_cfg.input_channel.get() + control_channel_suffix);
+    control_source =
         rtm::channel(_rtm_client, config.video_cfg.input_channel.get() + control_channel_suffix, {})
         >> streams::map([](rtm::channel_data&& t) { return std::move(t.payload); });
   } else {
-    _control_sink = &streams::ostream_sink(std::cout);
-    _control_source = streams::publishers::empty<nlohmann::json>();
+    job->control_sink = &streams::ostream_sink(std::cout);
+    control_source = streams::publishers::empty<nlohmann::json>();
   }
+  // every bot gets all control messages and picks the ones sent to its id
+  std::vector<streams::publisher<nlohmann::json>> control_sources =
+      streams::broadcast(std::move(control_source), bots_count);
 
   _finished = false;
-  _multiframes_counter = 0;
-
-  _source = std::move(_source) >> streams::signal_breaker({SIGINT, SIGTERM, SIGQUIT})
-            >> streams::map([& multiframes_counter = _multiframes_counter](
-                                std::queue<owned_image_packet>&& pkt) mutable {
-                multiframes_counter++;
-                constexpr int period = 100;
-                if ((multiframes_counter % period) == 0) {
-                  LOG(INFO) << "Processed " << multiframes_counter << " multiframes";
-                }
-                return pkt;
-              })
-            >> streams::do_finally([this]() {
-                _finished = true;
-
-                _io_service.post([this]() {
-                  LOG(INFO) << "stopping bot metrics";
-                  stop_metrics();
-                });
-
-                if (!_pool_mode && _rtm_client) {
-                  _io_service.post([rtm_client = _rtm_client]() {
-                    LOG(INFO) << "stopping rtm client";
-                    if (auto ec = rtm_client->stop()) {
-                      LOG(ERROR) << "error stopping rtm client: " << ec.message();
-                    } else {
-                      LOG(INFO) << "rtm client was stopped";
-                    }
-                  });
-                }
-              });
+  job->running_pipelines = bots_count;
+  job->running_outputs = bots_count;
+  _jobs.push_back(job);
+
+  if (!_pool_mode) {
+    // one handler stops all bots of the job, in pool mode the job controller handles signals
+    signal::register_handler({SIGINT, SIGTERM, SIGQUIT}, [job](int signal) {
+      LOG(INFO) << "Got signal #" << signal << ", stopping the bot";
+      job->stop();
+    });
+  }
+
+  // the video source starts once the last bot subscribes
+  for (size_t i = 0; i < bots_count; i++) {
+    if (encoded) {
+      start_job_bot(job, i, config, std::move(encoded_sources[i]),
+                    std::move(control_sources[i]));
+    } else {
+      start_job_bot(job, i, config, std::move(decoded_sources[i]),
+                    std::move(control_sources[i]));
+    }
+  }
+}
+
+template <typename Packet>
+void bot_environment::start_job_bot(const std::shared_ptr<bot_job>& job, size_t index,
+                                    const bot_configuration& config,
+                                    streams::publisher<Packet>&& frames,
+                                    streams::publisher<nlohmann::json>&& control) {
+  job_bot& bot = job->bots[index];
+  streams::publisher<bot_input> source =
+      queued_frames(std::move(frames) >> streams::manual_breaker(bot.frames_breaker), config);
+
+  source = std::move(source)
+           >> streams::map([job](bot_input&& pkt) {
+               const uint64_t counter = ++job->multiframes_counter;
+               constexpr int period = 100;
+               if ((counter % period) == 0) {
+                 LOG(INFO) << "Processed " << counter << " multiframes";
+               }
+               return std::move(pkt);
+             })
+           >> streams::do_finally([this, job]() {
+               if (--job->running_pipelines > 0) {
+                 return;
+               }
+
+               if (_pool_mode) {
+                 _io_service.post([this, job]() {
+                   LOG(INFO) << "job finished: " << job->job;
+                   _jobs.remove(job);
+                 });
+                 return;
+               }
+
+               _finished = true;
+
+               _io_service.post([this]() {
+                 LOG(INFO) << "stopping bot metrics";
+                 stop_metrics();
+               });
+
+               if (_rtm_client) {
+                 _io_service.post([rtm_client = _rtm_client]() {
+                   LOG(INFO) << "stopping rtm client";
+                   if (auto ec = rtm_client->stop()) {
+                     LOG(ERROR) << "error stopping rtm client: " << ec.message();
+                   } else {
+                     LOG(INFO) << "rtm client was stopped";
+                   }
+                 });
+               }
+             });
 
   auto bot_input_stream = streams::publishers::merge<bot_input>(
-      std::move(_control_source)
+      std::move(control) >> streams::manual_breaker(bot.control_breaker)
           >> streams::map([](nlohmann::json&& t) { return bot_input{t}; }),
-      std::move(_source) >> streams::map([](std::queue<owned_image_packet>&& p) {
-        return bot_input{p};
-      }));
+      std::move(source));
+
+  auto bot_output_stream = std::move(bot_input_stream) >> bot.instance->run_bot();
+
+  auto when_done = bot_output_stream->process([job](bot_output&& o) {
+    std::lock_guard<std::mutex> guard(job->sinks_mutex);
+    boost::apply_visitor(*job, o);
+  });
+  // messages of the bots, including shutdown responses, are already passed to sinks
+  when_done.on([this, job](std::error_condition /*ec*/) {
+    _io_service.post([this, job]() {
+      if (--job->running_outputs > 0) {
+        return;
+      }
+      if (job->on_stopped) {
+        job->on_stopped(job->job, job->shutdown_state());
+        job->on_stopped = nullptr;
+      }
+      if (_pool_mode) {
+        // rtm sinks wait for their publishes to be acknowledged on the io thread,
+        // outside of pool mode the process exits along with the job
+        std::thread([job]() {
+          threadutils::set_current_thread_name("job_sinks");
+          job->analysis_sink->on_complete();
+          job->debug_sink->on_complete();
+          job->control_sink->on_complete();
+        }).detach();
+      }
+    });
+  });
+}
 
-  auto bot_output_stream = std::move(bot_input_stream) >> _bot_instance->run_bot();
+void bot_environment::add_job(const nlohmann::json& job_with_state) {
+  // state is not a part of the job, the pool identifies jobs without it
+  CHECK(job_with_state.is_object()) << "job is not an object: " << job_with_state;
+  nlohmann::json job = job_with_state;
+  nlohmann::json state;
+  auto state_it = job.find("state");
+  if (state_it != job.end()) {
+    state = std::move(*state_it);
+    job.erase(state_it);
+  }
 
-  bot_output_stream->process([this](bot_output&& o) { boost::apply_visitor(*this, o); });
+  for (const auto& j : _jobs) {
+    if (j->job == job) {
+      LOG(WARNING) << "Job is already running: " << job;
+      return;
+    }
+  }
+  if (_jobs.size() >= _pool_capacity) {
+    LOG(ERROR) << "Can't start job, capacity of " << _pool_capacity
+               << " jobs is reached: " << job;
+    return;
+  }
+  if (resource_governor::current_level() >= resource_governor::level::REFUSE_JOBS) {
+    LOG(ERROR) << "Can't start job, resource budget is exceeded: " << job;
+    resource_governor::record_refused_job();
+    return;
+  }
+  start_bot(bot_configuration{job}, job, state);
 }
 
-void bot_environment::add_job(const nlohmann::json& job) {
-  CHECK(_job.is_null()) << "Can't subscribe to more than one channel";
-  _job = job;
-  start_bot(bot_configuration{_job});
+void bot_environment::remove_job(const nlohmann::json& job,
+                                 job_stopped_callback&& on_stopped) {
+  auto it = std::find_if(_jobs.begin(), _jobs.end(),
+                         [&job](const std::shared_ptr<bot_job>& j) { return j->job == job; });
+  if (it == _jobs.end()) {
+    LOG(WARNING) << "Requested remove for unknown job: " << job;
+    return;
+  }
+
+  LOG(INFO) << "Removing job: " << job;
+  std::shared_ptr<bot_job> removed = *it;
+  _jobs.erase(it);
+  removed->on_stopped = std::move(on_stopped);
+  removed->stop();
 }
 
-void bot_environment::remove_job(const nlohmann::json& job) {
-  LOG(ERROR) << "Requested remove for the following job: " << job;
-  ABORT() << "Removing jobs is not supported";
+void bot_environment::stop_all_jobs() {
+  LOG(INFO) << "Stopping " << _jobs.size() << " jobs";
+  std::list<std::shared_ptr<bot_job>> jobs;
+  jobs.swap(_jobs);
+  for (const auto& job : jobs) {
+    job->stop();
+  }
 }
 
 nlohmann::json bot_environment::list_jobs() const {
   nlohmann::json jobs = nlohmann::json::array();
-  if (!_job.is_null()) {
-    jobs.emplace_back(_job);
+  for (const auto& j : _jobs) {
+    if (!j->job.is_null()) {
+      jobs.emplace_back(j->job);
+    }
   }
   return jobs;
 }
 
+nlohmann::json bot_environment::jobs_load() {
+  nlohmann::json result = nlohmann::json::array();
+  for (const auto& j : _jobs) {
+    if (!j->job.is_null()) {
+      nlohmann::json load = j->take_load();
+      load["job"] = j->job;
+      result.emplace_back(std::move(load));
+    }
+  }
+  return result;
+}
+
 void bot_environment::on_error(std::error_condition ec) {
   ABORT() << "rtm error: " << ec.message();
 }
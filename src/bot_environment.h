@@ -1,14 +1,17 @@
 #pragma once
 
+#include <atomic>
 #include <json.hpp>
 #include <list>
 #include <memory>
+#include <vector>
 
 #include "cli_streams.h"
 #include "data.h"
 #include "metrics.h"
 #include "pool_controller.h"
 #include "rtm_client.h"
+#include "satorivideo/encoded/bot.h"
 #include "satorivideo/multiframe/bot.h"
 #include "video_streams.h"
 
@@ -38,49 +41,52 @@ struct bot_configuration {
   const boost::optional<size_t> max_queued_frames;
 };
 
-class bot_environment : public job_controller,
-                        private rtm::error_callbacks,
-                        boost::static_visitor<void> {
+// State of a single job, jobs of the same process share rtm client and io_service
+struct bot_job;
+
+class bot_environment : public job_controller, private rtm::error_callbacks {
  public:
   static bot_environment& instance();
 
+  // Bots registered in the same process share decoded frames of every job
   void register_bot(const multiframe_bot_descriptor& bot);
+  // Encoded bots get frames without decoding, they can't run along with image bots
+  void register_encoded_bot(const encoded_bot_descriptor& bot);
   int main(int argc, char* argv[]);
 
   rtm::publisher& publisher() { return *_rtm_client; }
 
-  void operator()(const owned_image_metadata& metadata);
-  void operator()(const owned_image_frame& frame);
-  void operator()(struct bot_message& msg);
-
   void add_job(const nlohmann::json& job) override;
-  void remove_job(const nlohmann::json& job) override;
+  void remove_job(const nlohmann::json& job, job_stopped_callback&& on_stopped) override;
   nlohmann::json list_jobs() const override;
+  nlohmann::json jobs_load() override;
 
  private:
-  void start_bot(const bot_configuration& config);
+  // state is passed to the bot if the job was stopped in another process
+  void start_bot(const bot_configuration& config, const nlohmann::json& job,
+                 const nlohmann::json& state = nullptr);
+  // runs one of the registered bots on the frames and control messages of the job,
+  // frames are either shared decoded packets or encoded packets
+  template <typename Packet>
+  void start_job_bot(const std::shared_ptr<bot_job>& job, size_t index,
+                     const bot_configuration& config, streams::publisher<Packet>&& frames,
+                     streams::publisher<nlohmann::json>&& control);
+  void add_bot_descriptor(const multiframe_bot_descriptor& bot);
+  void stop_all_jobs();
   void on_error(std::error_condition ec) override;
 
-  bool _finished;
-  uint64_t _multiframes_counter{0};
-  nlohmann::json _job;
+  std::atomic<bool> _finished{false};
   metrics_config _metrics_config;
   boost::asio::io_service _io_service;
-  multiframe_bot_descriptor _bot_descriptor;
-  std::unique_ptr<bot_instance> _bot_instance;
+  std::vector<multiframe_bot_descriptor> _bot_descriptors;
+  // frame callbacks of encoded bots, in the same order as descriptors
+  std::vector<encoded_bot_frame_callback_t> _encoded_callbacks;
   std::shared_ptr<rtm::client> _rtm_client;
   bool _pool_mode{false};
-
-  streams::observer<nlohmann::json>* _analysis_sink;
-  streams::observer<nlohmann::json>* _debug_sink;
-  streams::observer<nlohmann::json>* _control_sink;
-
-  std::unique_ptr<std::ofstream> _analysis_file;
-  std::unique_ptr<std::ofstream> _debug_file;
-
-  // TODO: maybe make them local variables?
-  streams::publisher<std::queue<owned_image_packet>> _source;
-  streams::publisher<nlohmann::json> _control_source;
+  // max number of jobs in pool mode
+  size_t _pool_capacity{1};
+  // accessed from io_service thread only
+  std::list<std::shared_ptr<bot_job>> _jobs;
 };
 
 }  // namespace video
@@ -1,9 +1,13 @@
 #include "bot_instance.h"
 
+#include <algorithm>
 #include <gsl/gsl>
 
+#include "avutils.h"
 #include "metrics.h"
+#include "profiling.h"
 #include "stopwatch.h"
+#include "tracing.h"
 
 namespace satori {
 namespace video {
@@ -28,15 +32,65 @@ auto& frame_batch_processed_total = prometheus::BuildCounter()
                                         .Name("frame_batch_processed_total")
                                         .Register(metrics_registry())
                                         .Add({});
+auto& frame_stage_latency_micros_family = prometheus::BuildHistogram()
+                                              .Name("frame_stage_latency_micros")
+                                              .Register(metrics_registry());
+
+// Stages a frame passes in order, the histogram for a transition between
+// two consecutive stages is labelled "<previous>_to_<next>"
+constexpr std::array<const char*, 7> frame_stages = {
+    "arrival", "reassembly", "decode", "conversion", "dequeue", "callback_start",
+    "callback_end"};
+
+bool is_set(const std::chrono::system_clock::time_point& t) {
+  return t.time_since_epoch().count() != 0;
+}
+
+// Decoder settings, like pyramid levels or region of interest, can change the levels
+// without changing the size of the frame itself
+bool same_geometry(const image_metadata& metadata, const owned_image_frame& frame) {
+  const size_t levels_count = frame.levels ? frame.levels->size() : 0;
+  if (metadata.width != frame.width || metadata.height != frame.height
+      || metadata.levels_count != levels_count
+      || !std::equal(frame.plane_strides, frame.plane_strides + max_image_planes,
+                     metadata.plane_strides)) {
+    return false;
+  }
+  for (size_t l = 0; l < levels_count; l++) {
+    const owned_image_level& level = (*frame.levels)[l];
+    const image_level_metadata& level_metadata = metadata.levels[l];
+    if (level_metadata.width != level.width || level_metadata.height != level.height
+        || !std::equal(level.plane_strides, level.plane_strides + max_image_planes,
+                       level_metadata.plane_strides)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Batch processing times kept for the load percentile, the newest ones replace older
+constexpr size_t max_load_samples = 1024;
+
 auto& messages_sent =
     prometheus::BuildCounter().Name("messages_sent").Register(metrics_registry());
 auto& messages_received =
     prometheus::BuildCounter().Name("messages_received").Register(metrics_registry());
 
-nlohmann::json build_configure_command(const nlohmann::json& config) {
+nlohmann::json build_configure_command(const nlohmann::json& config,
+                                       const nlohmann::json& state) {
   nlohmann::json cmd = nlohmann::json::object();
   cmd["action"] = "configure";
   cmd["body"] = config;
+  if (!state.is_null()) {
+    cmd["state"] = state;
+  }
+  return cmd;
+}
+
+nlohmann::json build_image_metadata_command(const image_metadata& metadata) {
+  nlohmann::json cmd = nlohmann::json::object();
+  cmd["action"] = "image_metadata";
+  cmd["body"] = {{"width", metadata.width}, {"height", metadata.height}};
   return cmd;
 }
 
@@ -45,13 +99,26 @@ nlohmann::json build_shutdown_command() {
   return cmd;
 }
 
+// by default a message is bound to the frame that is being processed
+frame_id effective_frame_id(const frame_id& id, const frame_id& current_frame_id) {
+  return (id.i1 == 0 && id.i2 == 0 && current_frame_id.i1 != 0
+          && current_frame_id.i2 != 0)
+             ? current_frame_id
+             : id;
+}
+
 }  // namespace
 
 bot_instance::bot_instance(const std::string& bot_id, const execution_mode execmode,
-                           const multiframe_bot_descriptor& descriptor)
+                           const multiframe_bot_descriptor& descriptor,
+                           std::shared_ptr<decoder_settings> decoder_settings,
+                           const std::string& channel,
+                           encoded_bot_frame_callback_t encoded_callback)
     : _bot_id(bot_id),
       _descriptor(descriptor),
-      bot_context{nullptr,
+      _decoder_settings(std::move(decoder_settings)),
+      _encoded_callback(std::move(encoded_callback)),
+      bot_callback_context{bot_context{nullptr,
                   &_image_metadata,
                   execmode,
                   {
@@ -59,19 +126,29 @@ bot_instance::bot_instance(const std::string& bot_id, const execution_mode execm
                       prometheus::BuildCounter()
                           .Name("frames_processed_total")
                           .Register(satori::video::metrics_registry())
-                          .Add({{"id", bot_id}}),
+                          .Add({{"channel", channel}, {"id", bot_id}}),
                       prometheus::BuildCounter()
                           .Name("frames_dropped_total")
                           .Register(satori::video::metrics_registry())
-                          .Add({{"id", bot_id}}),
+                          .Add({{"channel", channel}, {"id", bot_id}}),
                       prometheus::BuildHistogram()
                           .Name("frame_processing_times_millis")
                           .Register(satori::video::metrics_registry())
-                          .Add({{"id", bot_id}},
-                               std::vector<double>{0,  1,   2,   5,   10,  15,  20,
-                                                   25, 30,  40,  50,  60,  70,  80,
-                                                   90, 100, 200, 300, 400, 500, 750}),
-                  }} {}
+                          .Add({{"channel", channel}, {"id", bot_id}},
+                               std::vector<double>{0,   0.1, 0.2, 0.5, 1,   2,   5,
+                                                   10,  15,  20,  25,  30,  40,  50,
+                                                   60,  70,  80,  90,  100, 200, 300,
+                                                   400, 500, 750}),
+                  }}} {
+  // from 10us to 10s
+  const std::vector<double> buckets = log_linear_buckets(10, 10000000, 4);
+  for (size_t i = 0; i < _stage_latency_micros.size(); i++) {
+    const std::string stage =
+        std::string{frame_stages[i]} + "_to_" + frame_stages[i + 1];
+    _stage_latency_micros[i] = &frame_stage_latency_micros_family.Add(
+        {{"channel", channel}, {"id", bot_id}, {"stage", stage}}, buckets);
+  }
+}
 
 streams::op<bot_input, bot_output> bot_instance::run_bot() {
   return [this](streams::publisher<bot_input>&& src) {
@@ -85,10 +162,19 @@ streams::op<bot_input, bot_output> bot_instance::run_bot() {
         [this]() {
           LOG(INFO) << "shutting down bot";
           if (_descriptor.ctrl_callback) {
+            // lanes release their instance_data, the job state is the response of the bot
+            for (auto& worker : _workers) {
+              _descriptor.ctrl_callback(*worker, build_shutdown_command());
+              for (auto& msg : worker->take_messages()) {
+                queue_message(msg.kind, std::move(msg.data), msg.id);
+              }
+            }
+
             nlohmann::json cmd = build_shutdown_command();
             nlohmann::json response = _descriptor.ctrl_callback(*this, std::move(cmd));
             if (!response.is_null()) {
               LOG(INFO) << "got shutdown response: " << response;
+              _shutdown_response = response;
               queue_message(bot_message_kind::DEBUG, std::move(response), frame_id{0, 0});
             } else {
               LOG(INFO) << "shutdown response is null";
@@ -121,43 +207,69 @@ void bot_instance::queue_message(const bot_message_kind kind, nlohmann::json&& m
                                  const frame_id& id) {
   CHECK(message.is_object()) << "message is not an object: " << message;
 
-  frame_id effective_frame_id =
-      (id.i1 == 0 && id.i2 == 0 && _current_frame_id.i1 != 0 && _current_frame_id.i2 != 0)
-          ? _current_frame_id
-          : id;
-
   struct bot_message newmsg {
-    std::move(message), kind, effective_frame_id
+    std::move(message), kind, effective_frame_id(id, _current_frame_id)
   };
   _message_buffer.push_back(std::move(newmsg));
 }
 
 void bot_instance::set_current_frame_id(const frame_id& id) { _current_frame_id = id; }
 
+void bot_instance::set_region_of_interest(const image_region& region) {
+  if (!_decoder_settings) {
+    LOG(WARNING) << "region of interest can't be changed: the video source has no decoder "
+                    "or the decoder is shared with other bots";
+    return;
+  }
+  LOG(INFO) << "new region of interest: " << region.x << ", " << region.y << ", "
+            << region.width << "x" << region.height;
+  _decoder_settings->set_region_of_interest(region);
+}
+
 std::vector<image_frame> bot_instance::extract_frames(
-    const std::list<bot_output>& packets) {
+    const std::vector<shared_image_packet>& packets) {
   std::vector<image_frame> result;
 
   for (const auto& p : packets) {
-    auto* frame = boost::get<owned_image_frame>(&p);
+    auto* frame = boost::get<owned_image_frame>(p.get());
 
     if (frame == nullptr) {
       continue;
     }
 
-    if (frame->width != _image_metadata.width
-        || frame->height != _image_metadata.height) {
-      CHECK(_image_metadata.width == 0)
-          << "frame resolution has been changed: " << _image_metadata.width << "x"
-          << _image_metadata.height << " -> " << frame->width << "x" << frame->height;
+    if (!same_geometry(_image_metadata, *frame)) {
+      // resolution, region of interest and pyramid can be changed at runtime
+      const bool changed = _image_metadata.width != 0;
+      LOG(INFO) << "frame resolution: " << _image_metadata.width << "x"
+                << _image_metadata.height << " -> " << frame->width << "x"
+                << frame->height << ", levels: " << (int)_image_metadata.levels_count
+                << " -> " << (frame->levels ? frame->levels->size() : 0);
       _image_metadata.width = frame->width;
       _image_metadata.height = frame->height;
       std::copy(frame->plane_strides, frame->plane_strides + max_image_planes,
                 _image_metadata.plane_strides);
+
+      _image_metadata.levels_count = 0;
+      if (frame->levels) {
+        for (const owned_image_level& level : *frame->levels) {
+          image_level_metadata& level_metadata =
+              _image_metadata.levels[_image_metadata.levels_count++];
+          level_metadata.width = level.width;
+          level_metadata.height = level.height;
+          std::copy(level.plane_strides, level.plane_strides + max_image_planes,
+                    level_metadata.plane_strides);
+        }
+      }
+
+      if (changed) {
+        notify_image_metadata_changed();
+      }
     }
 
     image_frame bframe;
     bframe.id = frame->id;
+    bframe.arrival_time = frame->arrival_time;
+    bframe.capture_time = frame->timestamp;
     for (int i = 0; i < max_image_planes; ++i) {
       if (frame->plane_data[i].empty()) {
         bframe.plane_data[i] = nullptr;
@@ -165,29 +277,148 @@ std::vector<image_frame> bot_instance::extract_frames(
         bframe.plane_data[i] = (const uint8_t*)frame->plane_data[i].data();
       }
     }
+    for (int l = 0; l < max_image_levels; ++l) {
+      for (int i = 0; i < max_image_planes; ++i) {
+        const bool has_plane = frame->levels && static_cast<size_t>(l) < frame->levels->size()
+                               && !(*frame->levels)[l].plane_data[i].empty();
+        bframe.levels[l].plane_data[i] =
+            has_plane ? (const uint8_t*)(*frame->levels)[l].plane_data[i].data()
+                      : nullptr;
+      }
+    }
     result.push_back(std::move(bframe));
   }
   return result;
 }
 
-std::list<bot_output> bot_instance::operator()(std::queue<owned_image_packet>& pp) {
+void bot_instance::observe_frame_stages(
+    const std::vector<shared_image_packet>& packets,
+    const std::chrono::system_clock::time_point dequeue_time,
+    const std::chrono::system_clock::time_point callback_start_time,
+    const std::chrono::system_clock::time_point callback_end_time) {
+  for (const auto& p : packets) {
+    auto* frame = boost::get<owned_image_frame>(p.get());
+    if (frame == nullptr) {
+      continue;
+    }
+
+    const std::array<std::chrono::system_clock::time_point, frame_stages.size()> times =
+        {frame->arrival_time,    frame->reassembly_time, frame->decode_time,
+         frame->conversion_time, dequeue_time,           callback_start_time,
+         callback_end_time};
+    for (size_t i = 0; i < _stage_latency_micros.size(); i++) {
+      // sources without some stages leave their times empty
+      if (is_set(times[i]) && is_set(times[i + 1])) {
+        _stage_latency_micros[i]->Observe(
+            std::chrono::duration<double, std::micro>(times[i + 1] - times[i]).count());
+      }
+    }
+  }
+}
+
+std::list<bot_output> bot_instance::operator()(owned_image_packets& pp) {
+  shared_image_packets shared;
+  while (!pp.empty()) {
+    shared.push(std::make_shared<const owned_image_packet>(std::move(pp.front())));
+    pp.pop();
+  }
+  return this->operator()(shared);
+}
+
+// Frames are not copied, other bots may be reading the same packets
+std::list<bot_output> bot_instance::operator()(shared_image_packets& pp) {
   stopwatch<> s;
+  const auto dequeue_time = std::chrono::system_clock::now();
   std::list<bot_output> result;
 
-  frame_size.Observe(pp.size());
+  const size_t queue_depth = pp.size();
+  frame_size.Observe(queue_depth);
 
+  uint64_t queue_bytes = 0;
+  std::vector<shared_image_packet> packets;
+  packets.reserve(queue_depth);
   while (!pp.empty()) {
-    result.emplace_back(pp.front());
+    queue_bytes += resource_governor::byte_size<owned_image_packet>{}(*pp.front());
+    packets.push_back(std::move(pp.front()));
     pp.pop();
   }
 
-  std::vector<image_frame> bframes = extract_frames(result);
+  std::vector<image_frame> bframes = extract_frames(packets);
 
+  std::chrono::steady_clock::duration busy{0};
   if (!bframes.empty()) {
     LOG(1) << "process " << bframes.size() << " frames " << _image_metadata.width << "x"
            << _image_metadata.height;
 
-    _descriptor.img_callback(*this, gsl::span<image_frame>(bframes));
+    const auto callback_start_time = std::chrono::system_clock::now();
+    stopwatch<> callback_stopwatch;
+    {
+      tracing::scope callback_scope("bot_callback");
+      _descriptor.img_callback(*this, gsl::span<image_frame>(bframes));
+    }
+    busy = std::chrono::nanoseconds(callback_stopwatch.nanos());
+    observe_frame_stages(packets, dequeue_time, callback_start_time,
+                         std::chrono::system_clock::now());
+    frame_batch_processed_total.Increment();
+
+    prepare_message_buffer_for_downstream();
+
+    std::copy(_message_buffer.begin(), _message_buffer.end(), std::back_inserter(result));
+    _message_buffer.clear();
+  }
+
+  const double batch_millis = s.micros() / 1000.0;
+  processing_times_millis.Observe(batch_millis);
+  observe_load(queue_depth, queue_bytes, bframes.size(), busy, batch_millis);
+  return result;
+}
+
+// Encoded bots get every frame in order, metadata only updates codec parameters
+std::list<bot_output> bot_instance::operator()(encoded_packets& pp) {
+  CHECK(_encoded_callback) << "encoded frames are delivered to image bot " << _bot_id;
+  stopwatch<> s;
+  std::list<bot_output> result;
+
+  const size_t queue_depth = pp.size();
+  frame_size.Observe(queue_depth);
+
+  uint64_t queue_bytes = 0;
+  size_t frames = 0;
+  std::chrono::steady_clock::duration busy{0};
+  for (; !pp.empty(); pp.pop()) {
+    const encoded_packet& packet = pp.front();
+    queue_bytes += resource_governor::byte_size<encoded_packet>{}(packet);
+
+    if (const auto* metadata = boost::get<encoded_metadata>(&packet)) {
+      LOG(INFO) << "codec: " << metadata->codec_name;
+      _encoded_metadata.codec_name = metadata->codec_name;
+      _encoded_metadata.codec_data = metadata->codec_data;
+      continue;
+    }
+
+    const encoded_frame& frame = boost::get<encoded_frame>(packet);
+    encoded_frame_view view;
+    view.id = frame.id;
+    view.data = (const uint8_t*)frame.data.data();
+    view.size = frame.data.size();
+    view.key_frame = frame.key_frame;
+    view.arrival_time = frame.creation_time;
+    view.capture_time = frame.timestamp;
+
+    set_current_frame_id(frame.id);
+    stopwatch<> callback_stopwatch;
+    {
+      tracing::scope callback_scope("bot_callback");
+      _encoded_callback(*this, _encoded_metadata, view);
+    }
+    busy += std::chrono::nanoseconds(callback_stopwatch.nanos());
+    metrics.frame_processing_time_ms.Observe(callback_stopwatch.micros() / 1000.0);
+    metrics.frames_processed_total.Increment();
+    set_current_frame_id({0, 0});
+    frames++;
+  }
+
+  if (frames > 0) {
     frame_batch_processed_total.Increment();
 
     prepare_message_buffer_for_downstream();
@@ -196,12 +427,66 @@ std::list<bot_output> bot_instance::operator()(std::queue<owned_image_packet>& p
     _message_buffer.clear();
   }
 
-  processing_times_millis.Observe(s.millis());
+  const double batch_millis = s.micros() / 1000.0;
+  processing_times_millis.Observe(batch_millis);
+  observe_load(queue_depth, queue_bytes, frames, busy, batch_millis);
   return result;
 }
 
+void bot_instance::observe_load(size_t queue_depth, uint64_t queue_bytes, size_t frames,
+                                std::chrono::steady_clock::duration busy,
+                                double batch_millis) {
+  std::lock_guard<std::mutex> guard(_load_mutex);
+  _load_frames += frames;
+  _load_max_queue_depth = std::max(_load_max_queue_depth, queue_depth);
+  _load_max_queue_bytes = std::max(_load_max_queue_bytes, queue_bytes);
+  _load_busy += busy;
+  if (_load_batch_millis.size() < max_load_samples) {
+    _load_batch_millis.push_back(batch_millis);
+  } else {
+    _load_batch_millis[_load_batches % max_load_samples] = batch_millis;
+  }
+  _load_batches++;
+}
+
+nlohmann::json bot_instance::take_load() {
+  std::lock_guard<std::mutex> guard(_load_mutex);
+  const auto now = std::chrono::steady_clock::now();
+  const double seconds = std::chrono::duration<double>(now - _load_start).count();
+  const double dropped = metrics.frames_dropped_total.Value();
+
+  double p95 = 0;
+  if (!_load_batch_millis.empty()) {
+    const size_t idx = _load_batch_millis.size() * 95 / 100;
+    std::nth_element(_load_batch_millis.begin(), _load_batch_millis.begin() + idx,
+                     _load_batch_millis.end());
+    p95 = _load_batch_millis[idx];
+  }
+
+  nlohmann::json load = nlohmann::json::object();
+  load["decode_fps"] = seconds > 0 ? _load_frames / seconds : 0;
+  load["dropped_fps"] = seconds > 0 ? (dropped - _load_dropped_base) / seconds : 0;
+  load["busy_percent"] =
+      seconds > 0 ? std::chrono::duration<double>(_load_busy).count() / seconds * 100 : 0;
+  load["processing_p95_ms"] = p95;
+  load["queue_depth"] = _load_max_queue_depth;
+  load["queue_bytes"] = _load_max_queue_bytes;
+
+  _load_start = now;
+  _load_dropped_base = dropped;
+  _load_frames = 0;
+  _load_max_queue_depth = 0;
+  _load_max_queue_bytes = 0;
+  _load_busy = std::chrono::steady_clock::duration{0};
+  _load_batches = 0;
+  _load_batch_millis.clear();
+  return load;
+}
+
 std::list<bot_output> bot_instance::operator()(nlohmann::json& msg) {
-  messages_received.Add({{"message_type", "control"}}).Increment();
+  static auto& control_messages_received =
+      messages_received.Add({{"message_type", "control"}});
+  control_messages_received.Increment();
   if (msg.is_array()) {
     std::list<bot_output> aggregated;
     for (auto& el : msg) {
@@ -220,7 +505,25 @@ std::list<bot_output> bot_instance::operator()(nlohmann::json& msg) {
     return std::list<bot_output>{};
   }
 
-  nlohmann::json response = _descriptor.ctrl_callback(*this, msg);
+  if (msg.find("action") != msg.end() && msg["action"] == "tune") {
+    tune(msg.find("body") != msg.end() ? msg["body"] : nlohmann::json::object());
+  }
+
+  if (msg.find("action") != msg.end() && msg["action"] == "trace") {
+    trace(msg.find("body") != msg.end() ? msg["body"] : nlohmann::json::object());
+  }
+
+  if (msg.find("action") != msg.end()
+      && (msg["action"] == "start_profiling" || msg["action"] == "stop_profiling")) {
+    nlohmann::json reply = profile(msg);
+    if (msg.find("request_id") != msg.end()) {
+      reply["request_id"] = msg["request_id"];
+    }
+    queue_message(bot_message_kind::CONTROL, std::move(reply), frame_id{0, 0});
+  }
+
+  nlohmann::json response =
+      _descriptor.ctrl_callback ? _descriptor.ctrl_callback(*this, msg) : nullptr;
 
   if (!response.is_null()) {
     CHECK(response.is_object()) << "bot response is not an object: " << response;
@@ -240,17 +543,26 @@ std::list<bot_output> bot_instance::operator()(nlohmann::json& msg) {
 }
 
 void bot_instance::prepare_message_buffer_for_downstream() {
+  // counters are resolved on first use, Family::Add() is too slow for every message
   for (auto&& msg : _message_buffer) {
     switch (msg.kind) {
-      case bot_message_kind::ANALYSIS:
-        messages_sent.Add({{"message_type", "analysis"}}).Increment();
+      case bot_message_kind::ANALYSIS: {
+        static auto& analysis_messages_sent =
+            messages_sent.Add({{"message_type", "analysis"}});
+        analysis_messages_sent.Increment();
         break;
-      case bot_message_kind::DEBUG:
-        messages_sent.Add({{"message_type", "debug"}}).Increment();
+      }
+      case bot_message_kind::DEBUG: {
+        static auto& debug_messages_sent = messages_sent.Add({{"message_type", "debug"}});
+        debug_messages_sent.Increment();
         break;
-      case bot_message_kind::CONTROL:
-        messages_sent.Add({{"message_type", "control"}}).Increment();
+      }
+      case bot_message_kind::CONTROL: {
+        static auto& control_messages_sent =
+            messages_sent.Add({{"message_type", "control"}});
+        control_messages_sent.Increment();
         break;
+      }
     }
 
     CHECK(msg.data.is_object()) << "data is not an object: " << msg.data;
@@ -265,7 +577,118 @@ void bot_instance::prepare_message_buffer_for_downstream() {
   }
 }
 
-void bot_instance::configure(const nlohmann::json& config) {
+// Drop strategy is applied by the single frame API, see video_bot.cpp
+void bot_instance::tune(const nlohmann::json& body) {
+  LOG(INFO) << "tuning bot: " << body;
+  if (!_decoder_settings) {
+    LOG(WARNING) << "decoder can't be tuned: the video source has no decoder "
+                    "or the decoder is shared with other bots";
+    return;
+  }
+
+  if (!body.is_object()) {
+    LOG(ERROR) << "tune body is not an object: " << body;
+    return;
+  }
+
+  if (body.find("resolution") != body.end()) {
+    if (!body["resolution"].is_string()) {
+      LOG(ERROR) << "resolution is not a string: " << body["resolution"];
+    } else {
+      const std::string resolution = body["resolution"];
+      if (resolution == "original") {
+        _decoder_settings->set_bounding_size(
+            {avutils::original_image_width, avutils::original_image_height});
+      } else {
+        auto size = avutils::parse_image_size(resolution);
+        if (size.ok()) {
+          _decoder_settings->set_bounding_size(size.get());
+        } else {
+          LOG(ERROR) << "bad resolution: " << resolution;
+        }
+      }
+    }
+  }
+
+  if (body.find("max_fps") != body.end()) {
+    if (!body["max_fps"].is_number()) {
+      LOG(ERROR) << "max_fps is not a number: " << body["max_fps"];
+    } else {
+      _decoder_settings->set_max_fps(body["max_fps"].get<double>());
+    }
+  }
+}
+
+void bot_instance::trace(const nlohmann::json& body) {
+  std::chrono::milliseconds duration = tracing::default_duration;
+  if (body.find("duration_ms") != body.end() && body["duration_ms"].is_number()) {
+    duration = std::chrono::milliseconds(body["duration_ms"].get<int64_t>());
+  }
+  if (duration.count() <= 0) {
+    LOG(ERROR) << "bad trace duration: " << body;
+    return;
+  }
+  tracing::start(duration);
+}
+
+nlohmann::json bot_instance::profile(const nlohmann::json& msg) {
+  const std::string action = msg["action"];
+  nlohmann::json reply = {{"action", action}};
+  if (!profiling::is_available()) {
+    reply["error"] = "profiling is not available, built without gperftools";
+    return reply;
+  }
+
+  if (action == "stop_profiling") {
+    profiling::stop();
+    return reply;
+  }
+
+  const nlohmann::json body =
+      msg.find("body") != msg.end() ? msg["body"] : nlohmann::json::object();
+  if (!body.is_object()) {
+    reply["error"] = "body is not an object";
+    return reply;
+  }
+  if ((body.find("cpu") != body.end() && !body["cpu"].is_boolean())
+      || (body.find("heap") != body.end() && !body["heap"].is_boolean())) {
+    reply["error"] = "cpu and heap should be booleans";
+    return reply;
+  }
+  const bool cpu = body.find("cpu") != body.end() ? body["cpu"].get<bool>() : true;
+  const bool heap = body.find("heap") != body.end() ? body["heap"].get<bool>() : false;
+  std::chrono::milliseconds duration = profiling::default_duration;
+  if (body.find("duration_ms") != body.end() && body["duration_ms"].is_number()) {
+    duration = std::chrono::milliseconds(body["duration_ms"].get<int64_t>());
+  }
+  if (duration.count() <= 0) {
+    reply["error"] = "bad duration";
+    return reply;
+  }
+
+  const std::vector<std::string> files = profiling::start(cpu, heap, duration);
+  if (files.empty()) {
+    reply["error"] = "profiling can't be started, see bot logs";
+    return reply;
+  }
+  reply["files"] = files;
+  reply["duration_ms"] = duration.count();
+  return reply;
+}
+
+void bot_instance::notify_image_metadata_changed() {
+  if (!_descriptor.ctrl_callback) {
+    return;
+  }
+
+  nlohmann::json response =
+      _descriptor.ctrl_callback(*this, build_image_metadata_command(_image_metadata));
+  if (!response.is_null()) {
+    queue_message(bot_message_kind::DEBUG, std::move(response), frame_id{0, 0});
+  }
+}
+
+void bot_instance::configure(const nlohmann::json& config, const nlohmann::json& state) {
   if (!_descriptor.ctrl_callback) {
     if (config.is_null()) {
       return;
@@ -274,14 +697,64 @@ void bot_instance::configure(const nlohmann::json& config) {
   }
 
   nlohmann::json cmd =
-      build_configure_command(!config.is_null() ? config : nlohmann::json::object());
+      build_configure_command(!config.is_null() ? config : nlohmann::json::object(), state);
 
   LOG(INFO) << "configuring bot: " << cmd;
+  _configure_command = cmd;
   nlohmann::json response = _descriptor.ctrl_callback(*this, std::move(cmd));
   if (!response.is_null()) {
     queue_message(bot_message_kind::DEBUG, std::move(response), frame_id{0, 0});
   }
 }
 
+const std::vector<std::unique_ptr<bot_worker_context>>& bot_instance::worker_contexts(
+    uint8_t count) {
+  if (!_workers.empty()) {
+    return _workers;
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    _workers.push_back(std::make_unique<bot_worker_context>(*this));
+    bot_worker_context& worker = *_workers.back();
+    if (_descriptor.ctrl_callback && !_configure_command.is_null()) {
+      // responses and messages were already published when the bot was configured
+      _descriptor.ctrl_callback(worker, _configure_command);
+      worker.take_messages();
+    }
+  }
+  return _workers;
+}
+
+bot_instance::~bot_instance() = default;
+
+bot_worker_context::bot_worker_context(bot_instance& parent)
+    : bot_callback_context(parent), _parent(parent) {
+  instance_data = nullptr;
+}
+
+void bot_worker_context::queue_message(const bot_message_kind kind,
+                                       nlohmann::json&& message, const frame_id& id) {
+  CHECK(message.is_object()) << "message is not an object: " << message;
+
+  struct bot_message newmsg {
+    std::move(message), kind, effective_frame_id(id, _current_frame_id)
+  };
+  _messages.push_back(std::move(newmsg));
+}
+
+void bot_worker_context::set_current_frame_id(const frame_id& id) {
+  _current_frame_id = id;
+}
+
+void bot_worker_context::set_region_of_interest(const image_region& region) {
+  _parent.set_region_of_interest(region);
+}
+
+std::list<struct bot_message> bot_worker_context::take_messages() {
+  std::list<struct bot_message> result;
+  result.swap(_messages);
+  return result;
+}
+
 }  // namespace video
 }  // namespace satori
@@ -1,51 +1,155 @@
 #pragma once
 
+#include <array>
+#include <chrono>
 #include <json.hpp>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <queue>
+#include <vector>
 
 #include "bot_environment.h"
 #include "data.h"
+#include "satorivideo/encoded/bot.h"
 #include "satorivideo/multiframe/bot.h"
 #include "satorivideo/video_bot.h"
 #include "streams/streams.h"
 #include "variant_utils.h"
+#include "video_streams.h"
 
 namespace satori {
 namespace video {
 
 // Packets are stored in std::queue, the first one is the oldest one
 using owned_image_packets = std::queue<owned_image_packet>;
-using bot_input = boost::variant<owned_image_packets, nlohmann::json>;
+// Packets of a decoder shared by several bots
+using shared_image_packets = std::queue<shared_image_packet>;
+// Packets of encoded bots, they are not decoded
+using encoded_packets = std::queue<encoded_packet>;
+using bot_input = boost::variant<owned_image_packets, shared_image_packets, encoded_packets,
+                                 nlohmann::json>;
 using bot_output =
     variantutils::extend_variant<owned_image_packet, struct bot_message>::type;
 
-class bot_instance : public bot_context, boost::static_visitor<std::list<bot_output>> {
+// bot_context handed to bot callbacks, SDK functions like bot_message() cast
+// bot_context back to it
+class bot_callback_context : public bot_context {
+ public:
+  explicit bot_callback_context(const bot_context& context) : bot_context(context) {}
+  virtual ~bot_callback_context() = default;
+
+  virtual void queue_message(bot_message_kind kind, nlohmann::json&& message,
+                             const frame_id& id) = 0;
+  virtual void set_current_frame_id(const frame_id& id) = 0;
+  virtual void set_region_of_interest(const image_region& region) = 0;
+  virtual image_pixel_format pixel_format() const = 0;
+};
+
+class bot_worker_context;
+
+class bot_instance : public bot_callback_context,
+                     boost::static_visitor<std::list<bot_output>> {
  public:
   bot_instance(const std::string& bot_id, execution_mode execmode,
-               const multiframe_bot_descriptor& descriptor);
-  ~bot_instance() = default;
+               const multiframe_bot_descriptor& descriptor,
+               std::shared_ptr<decoder_settings> decoder_settings = nullptr,
+               const std::string& channel = "",
+               encoded_bot_frame_callback_t encoded_callback = nullptr);
+  ~bot_instance() override;
 
-  void configure(const nlohmann::json& config);
+  // state is what the bot returned on shutdown of the same job elsewhere
+  void configure(const nlohmann::json& config, const nlohmann::json& state = nullptr);
 
   streams::op<bot_input, bot_output> run_bot();
 
-  void queue_message(bot_message_kind kind, nlohmann::json&& message, const frame_id& id);
-  void set_current_frame_id(const frame_id& id);
+  void queue_message(bot_message_kind kind, nlohmann::json&& message,
+                     const frame_id& id) override;
+  void set_current_frame_id(const frame_id& id) override;
+  void set_region_of_interest(const image_region& region) override;
+  image_pixel_format pixel_format() const override { return _descriptor.pixel_format; }
 
-  std::list<bot_output> operator()(std::queue<owned_image_packet>& pp);
+  std::list<bot_output> operator()(owned_image_packets& pp);
+  std::list<bot_output> operator()(shared_image_packets& pp);
+  std::list<bot_output> operator()(encoded_packets& pp);
   std::list<bot_output> operator()(nlohmann::json& msg);
 
+  // Load since the previous call: frame rates, share of time spent in the bot
+  // callback, p95 of batch processing time and the deepest input queue.
+  // Can be called from any thread.
+  nlohmann::json take_load();
+
+  // Response of the bot to the shutdown command, null until the bot stream is drained
+  const nlohmann::json& shutdown_response() const { return _shutdown_response; }
+
+  // Contexts of the lanes of a bot with concurrency > 1, created on the first call.
+  // Every lane gets the configure and shutdown commands, so that it can keep
+  // its own instance_data.
+  const std::vector<std::unique_ptr<bot_worker_context>>& worker_contexts(uint8_t count);
+
  private:
   void prepare_message_buffer_for_downstream();
-  std::vector<image_frame> extract_frames(const std::list<bot_output>& packets);
+  void tune(const nlohmann::json& body);
+  void trace(const nlohmann::json& body);
+  nlohmann::json profile(const nlohmann::json& msg);
+  void notify_image_metadata_changed();
+  std::vector<image_frame> extract_frames(const std::vector<shared_image_packet>& packets);
+  void observe_frame_stages(const std::vector<shared_image_packet>& packets,
+                            std::chrono::system_clock::time_point dequeue_time,
+                            std::chrono::system_clock::time_point callback_start_time,
+                            std::chrono::system_clock::time_point callback_end_time);
+  void observe_load(size_t queue_depth, uint64_t queue_bytes, size_t frames,
+                    std::chrono::steady_clock::duration busy, double batch_millis);
 
   const std::string _bot_id;
   const multiframe_bot_descriptor _descriptor;
+  const std::shared_ptr<decoder_settings> _decoder_settings;
+  // set for encoded bots, they get frames without decoding
+  const encoded_bot_frame_callback_t _encoded_callback;
+  encoded_stream_metadata _encoded_metadata;
 
   std::list<struct bot_message> _message_buffer;
   image_metadata _image_metadata{0, 0};
   frame_id _current_frame_id;
+  nlohmann::json _configure_command;
+  nlohmann::json _shutdown_response;
+  std::vector<std::unique_ptr<bot_worker_context>> _workers;
+
+  // time between consecutive frame stages, from network arrival to the end of
+  // the image callback, see frame_stages in bot_instance.cpp
+  std::array<prometheus::Histogram*, 6> _stage_latency_micros;
+
+  // load since the previous take_load(), see observe_load()
+  std::mutex _load_mutex;
+  std::chrono::steady_clock::time_point _load_start{std::chrono::steady_clock::now()};
+  double _load_dropped_base{0};
+  uint64_t _load_frames{0};
+  size_t _load_max_queue_depth{0};
+  uint64_t _load_max_queue_bytes{0};
+  std::chrono::steady_clock::duration _load_busy{0};
+  uint64_t _load_batches{0};
+  std::vector<double> _load_batch_millis;
+};
+
+// Context of one lane of a bot with concurrency > 1, see bot_descriptor::concurrency.
+// Lanes run on different threads, so every lane has its own instance_data,
+// messages are buffered until the parent takes them in frame order.
+class bot_worker_context : public bot_callback_context {
+ public:
+  explicit bot_worker_context(bot_instance& parent);
+
+  void queue_message(bot_message_kind kind, nlohmann::json&& message,
+                     const frame_id& id) override;
+  void set_current_frame_id(const frame_id& id) override;
+  void set_region_of_interest(const image_region& region) override;
+  image_pixel_format pixel_format() const override { return _parent.pixel_format(); }
+
+  std::list<struct bot_message> take_messages();
+
+ private:
+  bot_instance& _parent;
+  std::list<struct bot_message> _messages;
+  frame_id _current_frame_id{0, 0};
 };
 
 }  // namespace video
@@ -15,14 +15,37 @@ bot_instance_builder &bot_instance_builder::set_config(const nlohmann::json &con
   return *this;
 }
 
+bot_instance_builder &bot_instance_builder::set_state(const nlohmann::json &state) {
+  _state = state;
+  return *this;
+}
+
 bot_instance_builder &bot_instance_builder::set_bot_id(std::string id) {
   _id = std::move(id);
   return *this;
 }
 
+bot_instance_builder &bot_instance_builder::set_channel(std::string channel) {
+  _channel = std::move(channel);
+  return *this;
+}
+
+bot_instance_builder &bot_instance_builder::set_decoder_settings(
+    std::shared_ptr<decoder_settings> settings) {
+  _decoder_settings = std::move(settings);
+  return *this;
+}
+
+bot_instance_builder &bot_instance_builder::set_encoded_callback(
+    encoded_bot_frame_callback_t callback) {
+  _encoded_callback = std::move(callback);
+  return *this;
+}
+
 std::unique_ptr<bot_instance> bot_instance_builder::build() {
-  auto instance = std::make_unique<bot_instance>(_id, _mode, _descriptor);
-  instance->configure(_config);
+  auto instance = std::make_unique<bot_instance>(_id, _mode, _descriptor, _decoder_settings,
+                                                 _channel, _encoded_callback);
+  instance->configure(_config, _state);
   return instance;
 }
 
@@ -12,14 +12,24 @@ struct bot_instance_builder {
 
   bot_instance_builder &set_execution_mode(execution_mode mode);
   bot_instance_builder &set_config(const nlohmann::json &config);
+  // State a stopped job left, passed to the bot with the configure command
+  bot_instance_builder &set_state(const nlohmann::json &state);
   bot_instance_builder &set_bot_id(std::string id);
+  bot_instance_builder &set_channel(std::string channel);
+  bot_instance_builder &set_decoder_settings(std::shared_ptr<decoder_settings> settings);
+  // Makes an encoded bot, it gets frames without decoding
+  bot_instance_builder &set_encoded_callback(encoded_bot_frame_callback_t callback);
   std::unique_ptr<bot_instance> build();
 
  private:
   multiframe_bot_descriptor _descriptor;
   execution_mode _mode;
   std::string _id;
+  std::string _channel;
   nlohmann::json _config;
+  nlohmann::json _state;
+  std::shared_ptr<decoder_settings> _decoder_settings;
+  encoded_bot_frame_callback_t _encoded_callback;
 };
 }  // namespace video
 }  // namespace satori
@@ -82,6 +82,7 @@ class camera_source_impl {
     frame.id = {_last_pos, _av_packet.pos};
     auto ts = 1000 * _av_packet.pts * _stream->time_base.num / _stream->time_base.den;
     frame.timestamp = _start + std::chrono::milliseconds(ts);
+    frame.arrival_time = std::chrono::system_clock::now();
 
     observer.on_next(std::move(frame));
     _last_pos = _av_packet.pos + 1 /* because our intervals are [i1, i2] */;
@@ -47,6 +47,16 @@ po::options_description camera_input_options() {
   return camera_options;
 }
 
+po::options_description shm_input_options() {
+  po::options_description shm_options("Shared memory options");
+  shm_options.add_options()(
+      "input-shm", po::value<std::string>(),
+      "name of the decoded frames ring written by satori_video_decoder_host on this node, "
+      "frames are taken from the ring instead of --input-channel");
+
+  return shm_options;
+}
+
 po::options_description generic_input_options() {
   po::options_description options("Generic input options");
   options.add_options()("time-limit", po::value<int>(),
@@ -60,6 +70,12 @@ po::options_description generic_input_options() {
   options.add_options()("keep-proportions", po::value<bool>()->default_value(true),
                         "(bool) tells if original video stream resolution's proportion "
                         "should remain unchanged");
+  options.add_options()("target-fps", po::value<double>(),
+                        "(number) if specified, decoded frames are evenly subsampled "
+                        "to given frame rate before scaling");
+  options.add_options()("keyframes-only",
+                        "if specified, only key frames are decoded, other frames are "
+                        "dropped before decoding");
 
   return options;
 }
@@ -76,6 +92,196 @@ po::options_description generic_output_options() {
   return options;
 }
 
+po::options_description encoder_options() {
+  po::options_description options("Encoder options");
+  options.add_options()("encoder", po::value<std::string>()->default_value("vp9"),
+                        "(vp9|h264) encoder for camera input and transcoding");
+  options.add_options()("vp9-preset", po::value<std::string>(),
+                        "(default|realtime|archive) base encoder profile, "
+                        "options below override its values");
+  options.add_options()("vp9-deadline", po::value<std::string>(),
+                        "(realtime|good|best) encoder deadline");
+  options.add_options()("vp9-cpu-used", po::value<int>(),
+                        "(number) speed/quality trade-off, higher is faster");
+  options.add_options()("vp9-row-mt", po::value<bool>(),
+                        "(bool) row based multithreading");
+  options.add_options()("vp9-threads", po::value<int>(), "(number) encoder threads");
+  options.add_options()("vp9-tile-columns", po::value<int>(),
+                        "(number) log2 of the number of tile columns");
+  options.add_options()("vp9-lag-in-frames", po::value<int>(),
+                        "(number) frames encoder can look ahead, adds latency");
+  options.add_options()("vp9-bitrate", po::value<int64_t>(),
+                        "(bits per second) target bitrate, 0 with --vp9-crf "
+                        "means constant quality");
+  options.add_options()("vp9-crf", po::value<int>(), "(0-63) constant quality level");
+  options.add_options()("vp9-keyframe-interval", po::value<int>(),
+                        "(frames) max distance between key frames");
+  options.add_options()("h264-preset", po::value<std::string>(),
+                        "(ultrafast..veryslow) x264 preset");
+  options.add_options()("h264-tune", po::value<std::string>(), "x264 tune");
+  options.add_options()("h264-crf", po::value<int>(),
+                        "(0-51) constant rate factor, used without --h264-bitrate");
+  options.add_options()("h264-bitrate", po::value<int64_t>(),
+                        "(bits per second) target bitrate");
+  options.add_options()("h264-keyframe-interval", po::value<int>(),
+                        "(frames) max distance between key frames");
+  options.add_options()("h264-threads", po::value<int>(),
+                        "(number) encoder threads, 0 lets x264 choose");
+
+  return options;
+}
+
+h264_encoder_profile h264_profile(const po::variables_map &vm) {
+  h264_encoder_profile profile;
+  if (vm.count("h264-preset") > 0) {
+    profile.preset = vm["h264-preset"].as<std::string>();
+  }
+  if (vm.count("h264-tune") > 0) {
+    profile.tune = vm["h264-tune"].as<std::string>();
+  }
+  if (vm.count("h264-crf") > 0) {
+    profile.crf = vm["h264-crf"].as<int>();
+  }
+  if (vm.count("h264-bitrate") > 0) {
+    profile.bitrate = vm["h264-bitrate"].as<int64_t>();
+  }
+  if (vm.count("h264-keyframe-interval") > 0) {
+    profile.keyframe_interval = vm["h264-keyframe-interval"].as<int>();
+  }
+  if (vm.count("h264-threads") > 0) {
+    profile.threads = vm["h264-threads"].as<int>();
+  }
+  return profile;
+}
+
+/**
+ * Expecting optional "h264" object of the following format
+ * {
+ *   "preset": <string>,
+ *   "tune": <string>,
+ *   "crf": <number>,
+ *   "bitrate": <number>,
+ *   "keyframe_interval": <number>,
+ *   "threads": <number>
+ * }
+ */
+h264_encoder_profile h264_profile(const nlohmann::json &config) {
+  h264_encoder_profile profile;
+  if (config.find("h264") == config.end()) {
+    return profile;
+  }
+
+  const nlohmann::json &h264 = config["h264"];
+  if (h264.find("preset") != h264.end()) {
+    profile.preset = h264["preset"].get<std::string>();
+  }
+  if (h264.find("tune") != h264.end()) {
+    profile.tune = h264["tune"].get<std::string>();
+  }
+  if (h264.find("crf") != h264.end()) {
+    profile.crf = h264["crf"].get<int>();
+  }
+  if (h264.find("bitrate") != h264.end()) {
+    profile.bitrate = h264["bitrate"].get<int64_t>();
+  }
+  if (h264.find("keyframe_interval") != h264.end()) {
+    profile.keyframe_interval = h264["keyframe_interval"].get<int>();
+  }
+  if (h264.find("threads") != h264.end()) {
+    profile.threads = h264["threads"].get<int>();
+  }
+  return profile;
+}
+
+vp9_encoder_profile vp9_profile(const po::variables_map &vm) {
+  vp9_encoder_profile profile =
+      vp9_preset(vm.count("vp9-preset") > 0 ? vm["vp9-preset"].as<std::string>()
+                                            : "default");
+  if (vm.count("vp9-deadline") > 0) {
+    profile.deadline = vm["vp9-deadline"].as<std::string>();
+  }
+  if (vm.count("vp9-cpu-used") > 0) {
+    profile.cpu_used = vm["vp9-cpu-used"].as<int>();
+  }
+  if (vm.count("vp9-row-mt") > 0) {
+    profile.row_mt = vm["vp9-row-mt"].as<bool>();
+  }
+  if (vm.count("vp9-threads") > 0) {
+    profile.threads = vm["vp9-threads"].as<int>();
+  }
+  if (vm.count("vp9-tile-columns") > 0) {
+    profile.tile_columns = vm["vp9-tile-columns"].as<int>();
+  }
+  if (vm.count("vp9-lag-in-frames") > 0) {
+    profile.lag_in_frames = static_cast<uint8_t>(vm["vp9-lag-in-frames"].as<int>());
+    profile.auto_alt_ref = profile.auto_alt_ref && profile.lag_in_frames > 0;
+  }
+  if (vm.count("vp9-bitrate") > 0) {
+    profile.bitrate = vm["vp9-bitrate"].as<int64_t>();
+  }
+  if (vm.count("vp9-crf") > 0) {
+    profile.crf = vm["vp9-crf"].as<int>();
+  }
+  if (vm.count("vp9-keyframe-interval") > 0) {
+    profile.keyframe_interval = vm["vp9-keyframe-interval"].as<int>();
+  }
+  return profile;
+}
+
+/**
+ * Expecting optional "vp9" object of the following format
+ * {
+ *   "preset": <string>,
+ *   "deadline": <string>,
+ *   "cpu_used": <number>,
+ *   "row_mt": <bool>,
+ *   "threads": <number>,
+ *   "tile_columns": <number>,
+ *   "lag_in_frames": <number>,
+ *   "bitrate": <number>,
+ *   "crf": <number>,
+ *   "keyframe_interval": <number>
+ * }
+ */
+vp9_encoder_profile vp9_profile(const nlohmann::json &config) {
+  if (config.find("vp9") == config.end()) {
+    return vp9_encoder_profile{};
+  }
+
+  const nlohmann::json &vp9 = config["vp9"];
+  vp9_encoder_profile profile = vp9_preset(
+      vp9.find("preset") != vp9.end() ? vp9["preset"].get<std::string>() : "default");
+  if (vp9.find("deadline") != vp9.end()) {
+    profile.deadline = vp9["deadline"].get<std::string>();
+  }
+  if (vp9.find("cpu_used") != vp9.end()) {
+    profile.cpu_used = vp9["cpu_used"].get<int>();
+  }
+  if (vp9.find("row_mt") != vp9.end()) {
+    profile.row_mt = vp9["row_mt"].get<bool>();
+  }
+  if (vp9.find("threads") != vp9.end()) {
+    profile.threads = vp9["threads"].get<int>();
+  }
+  if (vp9.find("tile_columns") != vp9.end()) {
+    profile.tile_columns = vp9["tile_columns"].get<int>();
+  }
+  if (vp9.find("lag_in_frames") != vp9.end()) {
+    profile.lag_in_frames = vp9["lag_in_frames"].get<uint8_t>();
+    profile.auto_alt_ref = profile.auto_alt_ref && profile.lag_in_frames > 0;
+  }
+  if (vp9.find("bitrate") != vp9.end()) {
+    profile.bitrate = vp9["bitrate"].get<int64_t>();
+  }
+  if (vp9.find("crf") != vp9.end()) {
+    profile.crf = vp9["crf"].get<int>();
+  }
+  if (vp9.find("keyframe_interval") != vp9.end()) {
+    profile.keyframe_interval = vp9["keyframe_interval"].get<int>();
+  }
+  return profile;
+}
+
 po::options_description url_input_options() {
   po::options_description url_options("URL options");
   url_options.add_options()("input-url", po::value<std::string>(), "Input video URL");
@@ -111,6 +317,18 @@ po::options_description pool_mode_options() {
       "on RTM channel and waits for job assignments from pool manager");
   pool_mode_options.add_options()("pool-job-type", po::value<std::string>(),
                                   "Pool job type supported by program");
+  pool_mode_options.add_options()(
+      "pool-cpu-percent", po::value<double>()->default_value(0),
+      "cpu time jobs can use, 100 is a single core, 0 means no limit");
+  pool_mode_options.add_options()("pool-memory-mb",
+                                  po::value<size_t>()->default_value(0),
+                                  "resident memory jobs can use, 0 means no limit");
+  pool_mode_options.add_options()(
+      "pool-job-cpu-percent", po::value<double>()->default_value(0),
+      "expected cpu usage of a job until running jobs are measured");
+  pool_mode_options.add_options()(
+      "pool-job-memory-mb", po::value<size_t>()->default_value(0),
+      "expected memory usage of a job until running jobs are measured");
 
   return pool_mode_options;
 }
@@ -132,6 +350,10 @@ bool check_url_input_args_provided(const po::variables_map &vm) {
   return vm.count("input-url") > 0;
 }
 
+bool check_shm_input_args_provided(const po::variables_map &vm) {
+  return vm.count("input-shm") > 0;
+}
+
 bool check_file_output_args_provided(const po::variables_map &vm) {
   return vm.count("output-video-file") > 0;
 }
@@ -191,6 +413,9 @@ po::options_description to_boost(const cli_options &opts) {
   if (opts.enable_url_input) {
     options.add(url_input_options());
   }
+  if (opts.enable_shm_input) {
+    options.add(shm_input_options());
+  }
   if (opts.enable_generic_input_options) {
     options.add(generic_input_options());
   }
@@ -208,6 +433,9 @@ po::options_description to_boost(const cli_options &opts) {
   if (opts.enable_pool_mode) {
     options.add(pool_mode_options());
   }
+  if (opts.enable_camera_input || opts.enable_generic_output_options) {
+    options.add(encoder_options());
+  }
 
   return options;
 }
@@ -217,6 +445,8 @@ po::options_description to_boost(const cli_options &opts) {
 streams::publisher<encoded_packet> encoded_publisher(
     boost::asio::io_service &io, const std::shared_ptr<rtm::client> &client,
     const input_video_config &video_cfg) {
+  CHECK(!video_cfg.input_shm) << "shared memory input has decoded frames only";
+
   if (video_cfg.input_channel) {
     return rtm_source(client, video_cfg.input_channel.get())
            >> report_video_metrics(video_cfg.input_channel.get())
@@ -245,10 +475,9 @@ streams::publisher<encoded_packet> encoded_publisher(
   }
 
   if (video_cfg.input_camera) {
-    const uint8_t fps = 25;                // FIXME: hardcoded value
-    const uint8_t vp9_lag_in_frames = 25;  // FIXME: hardcoded value
+    const uint8_t fps = 25;  // FIXME: hardcoded value
 
-    return camera_source(io, video_cfg.resolution, fps) >> encode_vp9(vp9_lag_in_frames);
+    return camera_source(io, video_cfg.resolution, fps) >> video_cfg.encoder.op();
   }
 
   if (video_cfg.input_url) {
@@ -262,16 +491,37 @@ streams::publisher<encoded_packet> encoded_publisher(
 
 streams::publisher<owned_image_packet> decoded_publisher(
     boost::asio::io_service &io, const std::shared_ptr<rtm::client> &client,
-    const input_video_config &video_cfg, image_pixel_format pixel_format) {
+    const input_video_config &video_cfg, image_pixel_format pixel_format,
+    uint8_t pyramid_levels, std::shared_ptr<decoder_settings> settings) {
   const auto resolution =
       (video_cfg.resolution == "original")
           ? image_size{avutils::original_image_width, avutils::original_image_height}
           : avutils::parse_image_size(video_cfg.resolution);
   CHECK(resolution.ok()) << "bad resolution: " << video_cfg.resolution;
 
-  streams::publisher<owned_image_packet> source =
-      encoded_publisher(io, client, video_cfg)
-      >> decode_image_frames(resolution.get(), pixel_format, video_cfg.keep_aspect_ratio);
+  if (video_cfg.target_fps) {
+    CHECK_GT(*video_cfg.target_fps, 0) << "bad target fps";
+    if (!settings) {
+      settings = std::make_shared<decoder_settings>();
+    }
+    settings->set_max_fps(*video_cfg.target_fps);
+  }
+
+  streams::publisher<owned_image_packet> source;
+  if (video_cfg.input_shm) {
+    // frames are decoded and scaled by the decoder host
+    source = shm_source(*video_cfg.input_shm, pixel_format, pyramid_levels);
+  } else {
+    streams::publisher<encoded_packet> encoded = encoded_publisher(io, client, video_cfg);
+    if (video_cfg.keyframes_only) {
+      encoded = std::move(encoded) >> keyframes_only();
+    }
+
+    source = std::move(encoded)
+             >> decode_image_frames(resolution.get(), pixel_format,
+                                    video_cfg.keep_aspect_ratio, pyramid_levels,
+                                    std::move(settings));
+  }
 
   if (video_cfg.time_limit) {
     source = std::move(source) >> streams::asio::timer_breaker<owned_image_packet>(
@@ -342,9 +592,13 @@ bool configuration::validate() const {
       _cli_options.enable_file_input && check_file_input_args_provided(_vm);
   const bool has_input_camera_args =
       _cli_options.enable_camera_input && check_camera_input_args_provided(_vm);
+  // with RTM, input channel still names channels of bot messages
+  const bool has_input_shm_args =
+      _cli_options.enable_shm_input && check_shm_input_args_provided(_vm);
 
   if (((int)has_input_rtm_args + (int)has_input_file_args + (int)has_input_camera_args)
-      > 1) {
+          > 1
+      || (has_input_shm_args && (has_input_file_args || has_input_camera_args))) {
     std::cerr << "Only one video source should be specified\n";
     return false;
   }
@@ -352,7 +606,7 @@ bool configuration::validate() const {
   if (_cli_options.enable_rtm_input || _cli_options.enable_file_input
       || _cli_options.enable_camera_input || _cli_options.enable_url_input) {
     if (!has_input_rtm_args && !has_input_file_args && !has_input_camera_args
-        && !_cli_options.enable_url_input) {
+        && !has_input_shm_args && !_cli_options.enable_url_input) {
       std::cerr << "Video source should be specified\n";
       return false;
     }
@@ -462,6 +716,27 @@ streams::subscriber<encoded_packet> &configuration::encoded_subscriber(
   return cli_streams::encoded_subscriber(io, client, output_video_config{_vm});
 }
 
+encoder_config::encoder_config(const po::variables_map &vm)
+    : codec(vm.count("encoder") > 0 ? vm["encoder"].as<std::string>() : "vp9"),
+      vp9_profile(cli_streams::vp9_profile(vm)),
+      h264_profile(cli_streams::h264_profile(vm)) {}
+
+encoder_config::encoder_config(const nlohmann::json &config)
+    : codec(config.find("encoder") != config.end() ? config["encoder"].get<std::string>()
+                                                   : "vp9"),
+      vp9_profile(cli_streams::vp9_profile(config)),
+      h264_profile(cli_streams::h264_profile(config)) {}
+
+streams::op<owned_image_packet, encoded_packet> encoder_config::op() const {
+  if (codec == "vp9") {
+    return encode_vp9(vp9_profile);
+  }
+  if (codec == "h264") {
+    return encode_h264(h264_profile);
+  }
+  ABORT() << "unsupported encoder: " << codec;
+}
+
 input_video_config::input_video_config(const po::variables_map &vm)
     : input_channel(vm.count("input-channel") > 0 ? vm["input-channel"].as<std::string>()
                                                   : boost::optional<std::string>{}),
@@ -483,12 +758,18 @@ input_video_config::input_video_config(const po::variables_map &vm)
       input_url_parameters{vm.count("input-url-parameters") > 0
                                ? vm["input-url-parameters"].as<std::string>()
                                : boost::optional<std::string>{}},
+      input_shm(vm.count("input-shm") > 0 ? vm["input-shm"].as<std::string>()
+                                          : boost::optional<std::string>{}),
       input_camera(vm.count("input-camera") > 0),
       loop(vm.count("loop") > 0),
       time_limit(vm.count("time-limit") > 0 ? vm["time-limit"].as<int>()
                                             : boost::optional<int>{}),
       frames_limit(vm.count("frames-limit") > 0 ? vm["frames-limit"].as<int>()
-                                                : boost::optional<int>{}) {}
+                                                : boost::optional<int>{}),
+      target_fps(vm.count("target-fps") > 0 ? vm["target-fps"].as<double>()
+                                            : boost::optional<double>{}),
+      keyframes_only(vm.count("keyframes-only") > 0),
+      encoder(vm) {}
 
 input_video_config::input_video_config(const nlohmann::json &config)
     : input_channel(config.find("channel") != config.end()
@@ -511,6 +792,9 @@ input_video_config::input_video_config(const nlohmann::json &config)
       input_url_parameters{config.find("input_url_parameters") != config.end()
                                ? config["input_url_parameters"].get<std::string>()
                                : boost::optional<std::string>{}},
+      input_shm(config.find("input_shm") != config.end()
+                    ? config["input_shm"].get<std::string>()
+                    : boost::optional<std::string>{}),
       input_camera(config.find("input_camera") != config.end()),
       loop(config.find("loop") != config.end()),
       time_limit(config.find("time_limit") != config.end()
@@ -518,7 +802,13 @@ input_video_config::input_video_config(const nlohmann::json &config)
                      : boost::optional<long>{}),
       frames_limit(config.find("frames_limit") != config.end()
                        ? config["frames_limit"].get<long>()
-                       : boost::optional<long>{}) {}
+                       : boost::optional<long>{}),
+      target_fps(config.find("target_fps") != config.end()
+                     ? config["target_fps"].get<double>()
+                     : boost::optional<double>{}),
+      keyframes_only(config.find("keyframes_only") != config.end()
+                     && config["keyframes_only"].get<bool>()),
+      encoder(config) {}
 
 output_video_config::output_video_config(const po::variables_map &vm)
     : output_channel{vm.count("output-channel") > 0
@@ -534,7 +824,8 @@ output_video_config::output_video_config(const po::variables_map &vm)
               : boost::optional<std::chrono::system_clock::duration>{}},
       reserved_index_space{vm.count("reserved-index-space") > 0
                                ? vm["reserved-index-space"].as<int>()
-                               : boost::optional<int>{}} {}
+                               : boost::optional<int>{}},
+      encoder{vm} {}
 
 output_video_config::output_video_config(const nlohmann::json &config)
     : output_channel{config.find("output-channel") != config.end()
@@ -550,7 +841,8 @@ output_video_config::output_video_config(const nlohmann::json &config)
               : boost::optional<std::chrono::system_clock::duration>{}},
       reserved_index_space{config.find("reserved-index-space") != config.end()
                                ? config["reserved-index-space"].get<int>()
-                               : boost::optional<int>{}} {}
+                               : boost::optional<int>{}},
+      encoder{config} {}
 }  // namespace cli_streams
 }  // namespace video
 }  // namespace satori
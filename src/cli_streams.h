@@ -11,11 +11,17 @@
 
 #include "data.h"
 #include "metrics.h"
+#include "pool_controller.h"
 #include "rtm_client.h"
+#include "h264_encoder.h"
 #include "streams/streams.h"
+#include "vp9_encoder.h"
 
 namespace satori {
 namespace video {
+
+class decoder_settings;
+
 namespace cli_streams {
 
 namespace po = boost::program_options;
@@ -31,6 +37,20 @@ struct cli_options {
   bool enable_file_batch_mode{false};
   bool enable_url_input{false};
   bool enable_pool_mode{false};
+  bool enable_shm_input{false};
+};
+
+// Encoder used when video has to be encoded or transcoded
+struct encoder_config {
+  explicit encoder_config(const po::variables_map &vm);
+  explicit encoder_config(const nlohmann::json &config);
+
+  streams::op<owned_image_packet, encoded_packet> op() const;
+
+  // "vp9" or "h264"
+  const std::string codec;
+  const vp9_encoder_profile vp9_profile;
+  const h264_encoder_profile h264_profile;
 };
 
 struct input_video_config {
@@ -45,10 +65,17 @@ struct input_video_config {
   const boost::optional<std::string> input_url;
   const boost::optional<std::string> input_url_parameters;
   const boost::optional<std::string> input_channel;
+  // decoded frames ring written by a decoder host, see shm_frames.h
+  const boost::optional<std::string> input_shm;
   const bool input_camera;
   const bool loop;
   const boost::optional<int> time_limit;
   const boost::optional<int> frames_limit;
+  const boost::optional<double> target_fps;
+  // drop all but key frames before decoding, e.g. for snapshots
+  const bool keyframes_only;
+  // used to encode camera input
+  const encoder_config encoder;
 };
 
 struct output_video_config {
@@ -59,6 +86,8 @@ struct output_video_config {
   const boost::optional<boost::filesystem::path> output_path;
   const boost::optional<std::chrono::system_clock::duration> segment_duration;
   const boost::optional<int> reserved_index_space;
+  // used when output is transcoded
+  const encoder_config encoder;
 };
 
 streams::publisher<encoded_packet> encoded_publisher(
@@ -67,7 +96,8 @@ streams::publisher<encoded_packet> encoded_publisher(
 
 streams::publisher<owned_image_packet> decoded_publisher(
     boost::asio::io_service &io, const std::shared_ptr<rtm::client> &client,
-    const input_video_config &video_cfg, image_pixel_format pixel_format);
+    const input_video_config &video_cfg, image_pixel_format pixel_format,
+    uint8_t pyramid_levels = 0, std::shared_ptr<decoder_settings> settings = nullptr);
 
 streams::subscriber<encoded_packet> &encoded_subscriber(
     boost::asio::io_service &io, const std::shared_ptr<rtm::client> &client,
@@ -101,6 +131,10 @@ struct configuration {
 
   metrics_config metrics() const { return metrics_config{_vm}; }
 
+  pool_resource_model pool_resources(size_t max_jobs) const {
+    return pool_resource_model{_vm, max_jobs};
+  }
+
  protected:
   po::variables_map _vm;
   cli_options _cli_options;
@@ -0,0 +1,146 @@
+// Decodes a stream once per node and writes frames to a shared memory ring,
+// bots on the same node read them with --input-shm.
+#include <boost/program_options.hpp>
+#include <iostream>
+
+#include "cli_streams.h"
+#include "logging_impl.h"
+#include "metrics.h"
+#include "rtm_client.h"
+#include "streams/signal_breaker.h"
+#include "tcmalloc.h"
+#include "video_streams.h"
+
+using namespace satori::video;
+
+namespace {
+
+struct rtm_error_handler : rtm::error_callbacks {
+  void on_error(std::error_condition ec) override { LOG(ERROR) << ec.message(); }
+};
+
+namespace po = boost::program_options;
+
+cli_streams::cli_options cli_configuration() {
+  cli_streams::cli_options result;
+  result.enable_rtm_input = true;
+  result.enable_file_input = true;
+  result.enable_url_input = true;
+  result.enable_generic_input_options = true;
+
+  return result;
+}
+
+po::options_description cli_options() {
+  po::options_description cli_generic("Generic options");
+  cli_generic.add_options()("help", "produce help message");
+  cli_generic.add_options()(
+      ",v", po::value<std::string>(),
+      "log verbosity level (INFO, WARNING, ERROR, FATAL, OFF, 1-9)");
+
+  po::options_description host_options("Decoder host options");
+  host_options.add_options()("output-shm", po::value<std::string>(),
+                             "name of the decoded frames ring, bots attach to it "
+                             "with --input-shm");
+  host_options.add_options()("shm-slots", po::value<size_t>()->default_value(8),
+                             "frames the ring holds, readers that fall behind more "
+                             "skip frames");
+  host_options.add_options()("pixel-format", po::value<std::string>()->default_value("bgr"),
+                             "(rgb0|bgr|gray8|yuv420p|nv12) pixel format of bots");
+  host_options.add_options()("pyramid-levels", po::value<int>()->default_value(0),
+                             "downscaled copies of every frame, at least as many as "
+                             "bots ask for");
+
+  return host_options.add(cli_generic).add(metrics_options());
+}
+
+image_pixel_format parse_pixel_format(const std::string &name) {
+  if (name == "rgb0") {
+    return image_pixel_format::RGB0;
+  }
+  if (name == "bgr") {
+    return image_pixel_format::BGR;
+  }
+  if (name == "gray8") {
+    return image_pixel_format::GRAY8;
+  }
+  if (name == "yuv420p") {
+    return image_pixel_format::YUV420P;
+  }
+  if (name == "nv12") {
+    return image_pixel_format::NV12;
+  }
+  ABORT() << "unsupported pixel format: " << name;
+  return image_pixel_format::BGR;
+}
+
+struct decoder_host_configuration : cli_streams::configuration {
+  decoder_host_configuration(int argc, char *argv[])
+      : configuration(argc, argv, cli_configuration(), cli_options()) {
+    if (_vm.count("output-shm") == 0) {
+      std::cerr << "Missing --output-shm argument\n";
+      exit(1);
+    }
+  }
+
+  std::string shm_name() const { return _vm["output-shm"].as<std::string>(); }
+
+  size_t shm_slots() const { return _vm["shm-slots"].as<size_t>(); }
+
+  streams::publisher<owned_image_packet> decoded_publisher(
+      boost::asio::io_service &io, const std::shared_ptr<rtm::client> &client) const {
+    const int levels = _vm["pyramid-levels"].as<int>();
+    CHECK(levels >= 0 && levels <= max_image_levels) << "bad pyramid levels: " << levels;
+
+    return cli_streams::decoded_publisher(
+        io, client, cli_streams::input_video_config{_vm},
+        parse_pixel_format(_vm["pixel-format"].as<std::string>()),
+        static_cast<uint8_t>(levels));
+  }
+};
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  init_tcmalloc();
+  init_logging(argc, argv);
+  decoder_host_configuration config{argc, argv};
+
+  boost::asio::io_service io_service;
+  boost::asio::ssl::context ssl_context{boost::asio::ssl::context::sslv23};
+  rtm_error_handler error_handler;
+
+  init_metrics(config.metrics(), io_service);
+
+  std::shared_ptr<rtm::client> rtm_client = config.rtm_client(
+      io_service, std::this_thread::get_id(), ssl_context, error_handler);
+
+  if (rtm_client) {
+    if (auto ec = rtm_client->start()) {
+      ABORT() << "error starting rtm client: " << ec.message();
+    }
+    expose_metrics(rtm_client.get());
+  }
+
+  // the ring is removed when the stream completes, including on signals
+  streams::publisher<owned_image_packet> source =
+      config.decoded_publisher(io_service, rtm_client)
+      >> streams::signal_breaker({SIGINT, SIGTERM, SIGQUIT})
+      >> streams::do_finally([&io_service, &rtm_client]() {
+          io_service.post([&rtm_client]() {
+            stop_metrics();
+            if (!rtm_client) {
+              return;
+            }
+            if (auto ec = rtm_client->stop()) {
+              LOG(ERROR) << "error stopping rtm client: " << ec.message();
+            } else {
+              LOG(INFO) << "rtm client was stopped";
+            }
+          });
+        });
+
+  source->subscribe(shm_sink(config.shm_name(), config.shm_slots()));
+
+  io_service.run();
+}
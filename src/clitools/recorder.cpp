@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <atomic>
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/filesystem.hpp>
@@ -13,6 +15,7 @@
 #include "logging_impl.h"
 #include "pool_controller.h"
 #include "rtm_client.h"
+#include "streams/manual_breaker.h"
 #include "streams/signal_breaker.h"
 #include "streams/threaded_worker.h"
 #include "tcmalloc.h"
@@ -114,6 +117,19 @@ class video_stream : private streams::subscriber<encoded_packet> {
 
   const nlohmann::json &job() const { return _job; }
 
+  // True once the stream has completed or failed and the sink is closed
+  bool finished() const { return _finished; }
+
+  // Stops reading the input, frames already queued are still recorded, then the
+  // current segment is closed and the done callback is invoked
+  void drain() {
+    LOG(INFO) << "draining video stream for " << _input_config.input_channel.get();
+    _input_breaker->trigger();
+  }
+
+  // Set while the stream drains, accessed from io thread only
+  job_stopped_callback on_stopped;
+
   void stop() {
     LOG(INFO) << "stopping video stream for " << _input_config.input_channel.get();
 
@@ -134,15 +150,19 @@ class video_stream : private streams::subscriber<encoded_packet> {
   streams::publisher<encoded_packet> original_encoded_stream(const std::string &channel) {
     LOG(INFO) << "using original encoded stream";
     return cli_streams::encoded_publisher(_io, _client, _input_config)
+           >> streams::manual_breaker(_input_breaker)
            >> streams::threaded_worker("in_" + channel) >> streams::flatten();
   }
 
+  // Frames stay in YUV420P from decoder to encoder, so the only conversion is scaling
   streams::publisher<encoded_packet> transcoded_stream(const std::string &channel) {
     LOG(INFO) << "using transcoded stream";
     return cli_streams::decoded_publisher(_io, _client, _input_config,
-                                          image_pixel_format::RGB0)
+                                          image_pixel_format::YUV420P)
+           >> streams::manual_breaker(_input_breaker)
            >> streams::threaded_worker("in_" + channel) >> streams::flatten()
-           >> encode_vp9(25) >> streams::threaded_worker("vp9_" + channel)
+           >> _output_config.encoder.op()
+           >> streams::threaded_worker(_output_config.encoder.codec + "_" + channel)
            >> streams::flatten();
   }
 
@@ -171,18 +191,25 @@ class video_stream : private streams::subscriber<encoded_packet> {
 
   void on_error(std::error_condition ec) override {  // TODO: add metric
     LOG(INFO) << "stream failed, stopping " << _input_config.input_channel.get();
-    CHECK(_subscription.is_initialized());
-    CHECK(_sink.is_initialized());
-    stop();
-    _done_callback(ec);
+    finish(ec);
   }
 
   void on_complete() override {  // TODO: add metric
-    LOG(INFO) << "stream is complete, reconnecting " << _input_config.input_channel.get();
+    LOG(INFO) << "stream is complete " << _input_config.input_channel.get();
+    finish({});
+  }
+
+  // The stream is over, so there is nothing to cancel. The callback may destroy
+  // this object, so it is invoked last and not through the member
+  void finish(std::error_condition ec) {
     CHECK(_subscription.is_initialized());
     CHECK(_sink.is_initialized());
-    stop();
-    _done_callback({});
+    _subscription.reset();
+    _sink->on_complete();
+    _sink.reset();
+    _finished = true;
+    const stream_done_callback_t done_callback = _done_callback;
+    done_callback(ec);
   }
 
   void on_subscribe(streams::subscription &s) override {
@@ -200,6 +227,10 @@ class video_stream : private streams::subscriber<encoded_packet> {
   const cli_streams::output_video_config _output_config;
   const nlohmann::json _job{nullptr};
   const stream_done_callback_t _done_callback;
+  // cuts the input before the processing queues, so that queued frames are recorded
+  const std::shared_ptr<streams::breaker_handle> _input_breaker{
+      std::make_shared<streams::breaker_handle>()};
+  std::atomic<bool> _finished{false};
   boost::optional<streams::subscription &> _subscription;
   boost::optional<streams::subscriber<encoded_packet> &> _sink;
 };
@@ -217,7 +248,10 @@ class recorder_job_controller : public job_controller {
    *   "channel": <string>,
    *   "segment-duration": <number> [OPTIONAL],
    *   "resolution": <string> [OPTIONAL],
-   *   "reserved-index-space": <number> [OPTIONAL]
+   *   "reserved-index-space": <number> [OPTIONAL],
+   *   "encoder": <string> [OPTIONAL], "vp9" or "h264",
+   *   "vp9": <object> [OPTIONAL], see cli_streams::vp9_profile(),
+   *   "h264": <object> [OPTIONAL], see cli_streams::h264_profile()
    * }
    */
   void add_job(const nlohmann::json &job) override {
@@ -236,12 +270,48 @@ class recorder_job_controller : public job_controller {
     job_copy["output-video-file"] = output_path.string();
     cli_streams::output_video_config output_config{job_copy};
 
+    // streams finish on their worker threads
     _streams.emplace_back(_io, _client, std::move(input_config), std::move(output_config),
-                          job, [](std::error_condition) {});
+                          job, [this, job](std::error_condition /*ec*/) {
+                            _io.post([this, job]() { on_stream_finished(job); });
+                          });
+  }
+
+  // The stream drains its queues and closes the current segment of the recording,
+  // the job is reported as stopped after that
+  void remove_job(const nlohmann::json &job, job_stopped_callback &&on_stopped) override {
+    auto it = find_stream(job);
+    if (it == _streams.end()) {
+      LOG(WARNING) << "Requested remove for unknown job: " << job;
+      return;
+    }
+
+    LOG(INFO) << "Removing job: " << job;
+    if (it->finished()) {
+      _streams.erase(it);
+      on_stopped(job, nullptr);
+      return;
+    }
+    it->on_stopped = std::move(on_stopped);
+    it->drain();
+  }
+
+  void on_stream_finished(const nlohmann::json &job) {
+    auto it = find_stream(job);
+    if (it == _streams.end() || !it->on_stopped) {
+      LOG(INFO) << "Stream of the job has finished: " << job;
+      return;
+    }
+
+    LOG(INFO) << "Job is stopped: " << job;
+    job_stopped_callback on_stopped = std::move(it->on_stopped);
+    _streams.erase(it);
+    on_stopped(job, nullptr);
   }
 
-  void remove_job(const nlohmann::json &job) override {
-    ABORT() << "job removal is not supported: " << job;
+  std::list<video_stream>::iterator find_stream(const nlohmann::json &job) {
+    return std::find_if(_streams.begin(), _streams.end(),
+                        [&job](const video_stream &s) { return s.job() == job; });
   }
 
   nlohmann::json list_jobs() const override {
@@ -306,9 +376,12 @@ void run_standalone(asio::io_service &io, std::shared_ptr<rtm::client> &client,
 void run_pool(asio::io_service &io, std::shared_ptr<rtm::client> &client,
               const recorder_configuration &config) {
   recorder_job_controller recorder_controller{io, client, config};
-  pool_job_controller job_controller{
-      io,     config.pool().get(), config.pool_job_type(), max_streams_capacity,
-      client, recorder_controller};
+  pool_job_controller job_controller{io,
+                                     config.pool().get(),
+                                     config.pool_job_type(),
+                                     config.pool_resources(max_streams_capacity),
+                                     client,
+                                     recorder_controller};
 
   // Kubernetes sends SIGTERM, and then SIGKILL after 30 seconds
   // https://kubernetes.io/docs/concepts/workloads/pods/pod/#termination-of-pods
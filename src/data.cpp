@@ -168,6 +168,38 @@ network_frame parse_network_frame(const nlohmann::json &item) {
   return frame;
 }
 
+shared_image_packet share_image_packet(owned_image_packet &&packet) {
+  const int64_t bytes = resource_governor::byte_size<owned_image_packet>{}(packet);
+  resource_governor::add_bytes(resource_governor::buffer::SHARED_FRAMES, bytes);
+  return shared_image_packet(new owned_image_packet(std::move(packet)),
+                             [bytes](const owned_image_packet *p) {
+                               resource_governor::add_bytes(
+                                   resource_governor::buffer::SHARED_FRAMES, -bytes);
+                               delete p;
+                             });
+}
+
+namespace resource_governor {
+
+size_t byte_size<encoded_packet>::operator()(const encoded_packet &packet) const {
+  if (const encoded_frame *f = boost::get<encoded_frame>(&packet)) {
+    return sizeof(encoded_packet) + f->data.size();
+  }
+  return sizeof(encoded_packet);
+}
+
+size_t byte_size<owned_image_packet>::operator()(const owned_image_packet &packet) const {
+  size_t result = sizeof(owned_image_packet);
+  if (const owned_image_frame *f = boost::get<owned_image_frame>(&packet)) {
+    for (const std::string &plane : f->plane_data) {
+      result += plane.size();
+    }
+  }
+  return result;
+}
+
+}  // namespace resource_governor
+
 }  // namespace video
 }  // namespace satori
 
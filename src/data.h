@@ -4,10 +4,12 @@
 #include <boost/variant.hpp>
 #include <chrono>
 #include <json.hpp>
+#include <memory>
 #include <ostream>
 #include <string>
 #include <vector>
 
+#include "resource_governor.h"
 #include "satori_video.h"
 #include "satorivideo/video_bot.h"
 
@@ -89,6 +91,10 @@ struct encoded_frame {
   // time when frame was generated by source (for example, network, encoder or file)
   std::chrono::system_clock::time_point creation_time;
 
+  // time when all chunks of the frame were received, for sources that don't split
+  // frames it is the same as creation_time
+  std::chrono::system_clock::time_point reassembly_time;
+
   std::vector<network_frame> to_network() const;
 };
 
@@ -98,6 +104,15 @@ using encoded_packet = boost::variant<encoded_metadata, encoded_frame>;
 // TODO: may contain some data like FPS, etc.
 struct owned_image_metadata {};
 
+// Downscaled copy of an image frame, has the same pixel format as the frame.
+struct owned_image_level {
+  uint16_t width;
+  uint16_t height;
+
+  std::string plane_data[max_image_planes];
+  uint32_t plane_strides[max_image_planes];
+};
+
 // If an image uses packed pixel format like packed RGB or packed YUV,
 // then it has only a single plane, e.g. all it's data is within plane_data[0].
 // If an image uses planar pixel format like planar YUV or HSV,
@@ -114,13 +129,57 @@ struct owned_image_frame {
   // image capture time
   std::chrono::system_clock::time_point timestamp;
 
+  // time when encoded frame came from source, see encoded_frame::creation_time
+  std::chrono::system_clock::time_point arrival_time;
+
+  // times when the frame passed decoder stages, left empty by sources
+  // without the corresponding stage
+  std::chrono::system_clock::time_point reassembly_time;
+  std::chrono::system_clock::time_point decode_time;
+  std::chrono::system_clock::time_point conversion_time;
+
   std::string plane_data[max_image_planes];
   uint32_t plane_strides[max_image_planes];
+
+  // Image pyramid, every level is two times smaller than the previous one.
+  // Levels are shared between copies of the frame.
+  std::shared_ptr<const std::vector<owned_image_level>> levels;
 };
 
 // algebraic type to support flow of image data using streams API
 using owned_image_packet = boost::variant<owned_image_metadata, owned_image_frame>;
 
+// packet delivered read-only to several bots of the same process
+using shared_image_packet = std::shared_ptr<const owned_image_packet>;
+
+namespace resource_governor {
+
+template <>
+struct byte_size<encoded_packet> {
+  size_t operator()(const encoded_packet &packet) const;
+};
+
+// Pyramid levels are shared between copies and are not counted
+template <>
+struct byte_size<owned_image_packet> {
+  size_t operator()(const owned_image_packet &packet) const;
+};
+
+// Shared packets are counted once by share_image_packet(), so that a packet
+// held by the queues of several bots doesn't count several times
+template <>
+struct byte_size<shared_image_packet> {
+  size_t operator()(const shared_image_packet & /*packet*/) const {
+    return sizeof(shared_image_packet);
+  }
+};
+
+}  // namespace resource_governor
+
+// Makes a shared packet that is reported to the resource governor
+// until the last reference is dropped
+shared_image_packet share_image_packet(owned_image_packet &&packet);
+
 }  // namespace video
 }  // namespace satori
 
@@ -1,11 +1,15 @@
 #include "video_streams.h"
 
+#include <algorithm>
+#include <cmath>
 #include <sstream>
 
 #include "av_filter.h"
 #include "avutils.h"
 #include "metrics.h"
+#include "resource_governor.h"
 #include "stopwatch.h"
+#include "tracing.h"
 #include "video_error.h"
 
 namespace satori {
@@ -17,6 +21,18 @@ auto &frames_received = prometheus::BuildCounter()
                             .Name("decoder_frames_received_total")
                             .Register(metrics_registry())
                             .Add({});
+auto &passthrough_frames = prometheus::BuildCounter()
+                              .Name("decoder_passthrough_frames_total")
+                              .Register(metrics_registry())
+                              .Add({});
+auto &filter_rebuilds = prometheus::BuildCounter()
+                           .Name("decoder_filter_rebuilds_total")
+                           .Register(metrics_registry())
+                           .Add({});
+auto &frames_skipped = prometheus::BuildCounter()
+                          .Name("decoder_frames_skipped_total")
+                          .Register(metrics_registry())
+                          .Add({});
 auto &messages_received = prometheus::BuildCounter()
                               .Name("decoder_messages_received_total")
                               .Register(metrics_registry())
@@ -30,29 +46,69 @@ auto &bytes_received = prometheus::BuildCounter()
                            .Register(metrics_registry())
                            .Add({});
 
-auto &send_packet_millis =
-    prometheus::BuildHistogram()
-        .Name("decoder_send_packet_millis")
-        .Register(metrics_registry())
-        .Add({}, std::vector<double>{0, 0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9, 1, 2,
-                                     5, 10, 20, 50, 100});
-auto &receive_frame_millis =
-    prometheus::BuildHistogram()
-        .Name("decoder_receive_frame_millis")
-        .Register(metrics_registry())
-        .Add({}, std::vector<double>{0, 0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9, 1, 2,
-                                     5, 10, 20, 50, 100});
+// from 1us to 1s
+const std::vector<double> micros_buckets = log_linear_buckets(1, 1000000, 9);
+
+auto &send_packet_micros = prometheus::BuildHistogram()
+                               .Name("decoder_send_packet_micros")
+                               .Register(metrics_registry())
+                               .Add({}, micros_buckets);
+auto &receive_frame_micros = prometheus::BuildHistogram()
+                                 .Name("decoder_receive_frame_micros")
+                                 .Register(metrics_registry())
+                                 .Add({}, micros_buckets);
+
+auto &filter_micros = prometheus::BuildHistogram()
+                          .Name("decoder_filter_micros")
+                          .Register(metrics_registry())
+                          .Add({}, micros_buckets);
+
+auto &pyramid_micros = prometheus::BuildHistogram()
+                           .Name("decoder_pyramid_micros")
+                           .Register(metrics_registry())
+                           .Add({}, micros_buckets);
 
 auto &decoder_errors =
     prometheus::BuildCounter().Name("decoder_errors_total").Register(metrics_registry());
 
+bool is_whole_frame(const image_region &region) {
+  return region.x <= 0 && region.y <= 0 && region.width >= 1 && region.height >= 1;
+}
+
+image_region clamp_region(const image_region &region) {
+  image_region result;
+  result.x = std::min(std::max(region.x, 0.0), 1.0);
+  result.y = std::min(std::max(region.y, 0.0), 1.0);
+  result.width = std::min(std::max(region.width, 0.0), 1.0 - result.x);
+  result.height = std::min(std::max(region.height, 0.0), 1.0 - result.y);
+  return result;
+}
+
+// Regions that are empty after clamping would produce a crop filter FFmpeg rejects
+bool is_valid_region(const image_region &region) {
+  if (!std::isfinite(region.x) || !std::isfinite(region.y) || !std::isfinite(region.width)
+      || !std::isfinite(region.height)) {
+    return false;
+  }
+  const image_region clamped = clamp_region(region);
+  return clamped.width > 0 && clamped.height > 0;
+}
+
+std::ostream &operator<<(std::ostream &out, const image_region &region) {
+  return out << region.x << ", " << region.y << ", " << region.width << "x"
+             << region.height;
+}
+
 class image_decoder_op {
  public:
   image_decoder_op(const image_size &bounding_size, image_pixel_format pixel_format,
-                   bool keep_aspect_ratio)
+                   bool keep_aspect_ratio, uint8_t pyramid_levels,
+                   std::shared_ptr<decoder_settings> settings)
       : _bounding_size{bounding_size},
         _pixel_format{pixel_format},
-        _keep_aspect_ratio{keep_aspect_ratio} {}
+        _keep_aspect_ratio{keep_aspect_ratio},
+        _pyramid_levels{pyramid_levels},
+        _settings{std::move(settings)} {}
 
   template <typename T>
   class instance : public streams::subscriber<encoded_packet>,
@@ -73,7 +129,9 @@ class image_decoder_op {
         : streams::impl::drain_source_impl<owned_image_packet>(sink),
           _bounding_size{op._bounding_size},
           _pixel_format{op._pixel_format},
-          _keep_aspect_ratio{op._keep_aspect_ratio} {}
+          _keep_aspect_ratio{op._keep_aspect_ratio},
+          _pyramid_levels{op._pyramid_levels},
+          _settings{op._settings} {}
 
     ~instance() override {
       if (_source) {
@@ -151,10 +209,20 @@ class image_decoder_op {
         return;
       }
 
+      if (skip_for_overload(f)) {
+        resource_governor::record_shed(resource_governor::level::KEYFRAMES_ONLY, 1);
+        // the next delivered frame stands for it, like for frames skipped by max fps
+        if (_skipped_since < 0) {
+          _skipped_since = f.id.i1;
+        }
+        return;
+      }
+
       {
         stopwatch<> s;
+        tracing::scope decode_scope("decode");
         av_init_packet(_packet.get());
-        _ids.push(f.id);
+        _pending.push({f.id, f.creation_time, f.reassembly_time});
         _packet->flags |= f.key_frame ? AV_PKT_FLAG_KEY : 0;
         _packet->data = (uint8_t *)f.data.data();
         _packet->size = static_cast<int>(f.data.size());
@@ -180,11 +248,28 @@ class image_decoder_op {
               .Increment();
           return;
         }
-        send_packet_millis.Observe(s.millis());
+        send_packet_micros.Observe(s.micros());
       }
     }
 
    private:
+    // Skipped frames are references of the following ones, so once a frame is
+    // skipped, decoding resumes only from a key frame. Streams that don't mark
+    // key frames are never skipped.
+    bool skip_for_overload(const encoded_frame &f) {
+      if (f.key_frame) {
+        _key_frames_seen = true;
+        _waiting_for_key_frame = false;
+        return false;
+      }
+      if (_key_frames_seen
+          && resource_governor::current_level()
+                 >= resource_governor::level::KEYFRAMES_ONLY) {
+        _waiting_for_key_frame = true;
+      }
+      return _waiting_for_key_frame;
+    }
+
     bool drain_impl() override {
       LOG(4) << this << " drain_impl needs=" << needs();
       if (!_context) {
@@ -211,7 +296,11 @@ class image_decoder_op {
       LOG(4) << this << " receive_frame";
 
       stopwatch<> s;
-      int err = avcodec_receive_frame(_context.get(), _frame.get());
+      int err;
+      {
+        tracing::scope decode_scope("decode");
+        err = avcodec_receive_frame(_context.get(), _frame.get());
+      }
       if (err < 0) {
         switch (err) {
           case AVERROR(EAGAIN):
@@ -230,43 +319,202 @@ class image_decoder_op {
             return video_error::FRAME_GENERATION_ERROR;
         }
       }
-      receive_frame_millis.Observe(s.millis());
+      receive_frame_micros.Observe(s.micros());
+      _decode_time = std::chrono::system_clock::now();
       deliver_frame();
       return {};
     }
 
     void deliver_frame() {
-      if (!_filter) {
+      if (_settings && _settings->version() != _settings_version
+          && (_filter || _passthrough)) {
+        LOG(INFO) << "decoder settings have changed, rebuilding filter";
+        filter_rebuilds.Increment();
+        reset_filter();
+      }
+
+      if (!_filter && !_passthrough) {
         init_filter();
       }
 
-      _filter->feed(*_frame);
       frames_received.Increment();
 
-      while (_filter->try_retrieve(*_filtered_frame)) {
-        owned_image_frame frame = avutils::to_image_frame(*_filtered_frame);
-
-        if (!_ids.empty()) {
-          frame.id = _ids.front();
-          _ids.pop();
-        } else {
-          LOG(ERROR) << this << "id queue is empty";
-          frame.id = {_filtered_frame->pkt_pos,
-                      _filtered_frame->pkt_pos + _filtered_frame->pkt_duration};
+      if (skip_frame()) {
+        frames_skipped.Increment();
+        if (!_pending.empty()) {
+          if (_skipped_since < 0) {
+            _skipped_since = _pending.front().id.i1;
+          }
+          _pending.pop();
         }
+        return;
+      }
 
-        while (_filtered_frame->key_frame != 0 && _filtered_frame->pkt_pos != frame.id.i1
-               && !_ids.empty()) {
-          frame.id = _ids.front();
-          _ids.pop();
-        }
+      if (_passthrough) {
+        passthrough_frames.Increment();
+        const int err = av_frame_ref(_filtered_frame.get(), _frame.get());
+        CHECK_GE(err, 0) << "av_frame_ref error: " << avutils::error_msg(err);
+        deliver_filtered_frame();
+        return;
+      }
 
-        av_frame_unref(_filtered_frame.get());
-        deliver_on_next(owned_image_packet{std::move(frame)});
+      bool retrieved;
+      {
+        tracing::scope filter_scope("filter");
+        stopwatch<> s;
+        _filter->feed(*_frame);
+        retrieved = _filter->try_retrieve(*_filtered_frame);
+        filter_micros.Observe(s.micros());
+      }
+      while (retrieved) {
+        deliver_filtered_frame();
+        retrieved = _filter->try_retrieve(*_filtered_frame);
       }
     }
 
+    void deliver_filtered_frame() {
+      owned_image_frame frame = avutils::to_image_frame(*_filtered_frame);
+      frame.decode_time = _decode_time;
+      frame.conversion_time = std::chrono::system_clock::now();
+      if (_pyramid_levels > 0) {
+        frame.levels = build_pyramid();
+      }
+
+      if (!_pending.empty()) {
+        frame.id = _pending.front().id;
+        frame.arrival_time = _pending.front().arrival_time;
+        frame.reassembly_time = _pending.front().reassembly_time;
+        _pending.pop();
+      } else {
+        LOG(ERROR) << this << "id queue is empty";
+        frame.arrival_time = std::chrono::system_clock::now();
+        frame.id = {_filtered_frame->pkt_pos,
+                    _filtered_frame->pkt_pos + _filtered_frame->pkt_duration};
+      }
+
+      while (_filtered_frame->key_frame != 0 && _filtered_frame->pkt_pos != frame.id.i1
+             && !_pending.empty()) {
+        frame.id = _pending.front().id;
+        frame.arrival_time = _pending.front().arrival_time;
+        frame.reassembly_time = _pending.front().reassembly_time;
+        _pending.pop();
+      }
+
+      // Delivered frame stands for the frames skipped right before it,
+      // so analysis results still cover the whole stream
+      if (_skipped_since >= 0) {
+        frame.id.i1 = std::min(frame.id.i1, _skipped_since);
+        _skipped_since = -1;
+      }
+
+      av_frame_unref(_filtered_frame.get());
+      deliver_on_next(owned_image_packet{std::move(frame)});
+    }
+
+    // Decoded planes can be handed to the bot as is if they already have
+    // the requested size and pixel format.
+    bool can_pass_through(bool has_filters) const {
+      if (has_filters
+          || _frame->format != avutils::to_av_pixel_format(_pixel_format)) {
+        return false;
+      }
+
+      const bool original_size = _bounding_size.width == avutils::original_image_width
+                                 && _bounding_size.height
+                                        == avutils::original_image_height;
+      return original_size
+             || (_bounding_size.width == _frame->width
+                 && _bounding_size.height == _frame->height);
+    }
+
+    // Every level is scaled down from the previous one, so the work per level
+    // decreases geometrically.
+    std::shared_ptr<const std::vector<owned_image_level>> build_pyramid() {
+      if (_level_frames.empty()) {
+        init_pyramid();
+      }
+
+      stopwatch<> s;
+      auto levels = std::make_shared<std::vector<owned_image_level>>();
+      levels->reserve(_level_frames.size());
+
+      std::shared_ptr<const AVFrame> previous = _filtered_frame;
+      for (size_t i = 0; i < _level_frames.size(); i++) {
+        avutils::sws_scale(_level_sws_contexts[i], previous, _level_frames[i]);
+        levels->push_back(avutils::to_image_level(*_level_frames[i]));
+        previous = _level_frames[i];
+      }
+
+      pyramid_micros.Observe(s.micros());
+      return levels;
+    }
+
+    void init_pyramid() {
+      const auto av_pixel_format = static_cast<AVPixelFormat>(_filtered_frame->format);
+      int width = _filtered_frame->width;
+      int height = _filtered_frame->height;
+
+      for (uint8_t i = 0; i < _pyramid_levels; i++) {
+        const int level_width = std::max(1, width / 2);
+        const int level_height = std::max(1, height / 2);
+        LOG(INFO) << "pyramid level " << (i + 1) << ": " << level_width << "x"
+                  << level_height;
+
+        auto level_frame =
+            avutils::av_frame(level_width, level_height, 1, av_pixel_format);
+        auto sws_context = avutils::sws_context(width, height, av_pixel_format,
+                                                level_width, level_height,
+                                                av_pixel_format);
+        CHECK(level_frame && sws_context) << "can't initialize pyramid level " << (i + 1);
+
+        _level_frames.push_back(std::move(level_frame));
+        _level_sws_contexts.push_back(std::move(sws_context));
+        width = level_width;
+        height = level_height;
+      }
+    }
+
+    // Selects frames evenly by PTS so that their rate doesn't exceed max fps,
+    // skipped frames don't go through the filter at all
+    bool skip_frame() {
+      if (_max_fps <= 0 || _frame->pts == AV_NOPTS_VALUE) {
+        return false;
+      }
+
+      // PTS is in milliseconds, see operator()(const encoded_frame &)
+      const double interval = 1000.0 / _max_fps;
+      const auto pts = static_cast<double>(_frame->pts);
+      if (_next_pts >= 0 && pts < _next_pts) {
+        return true;
+      }
+
+      // resynchronize after gaps and seeks instead of bursting
+      _next_pts = (_next_pts < 0 || pts - _next_pts > interval) ? pts + interval
+                                                                : _next_pts + interval;
+      return false;
+    }
+
+    // Filter and pyramid are built lazily from the next decoded frame
+    void reset_filter() {
+      _filter.reset();
+      _passthrough = false;
+      _level_frames.clear();
+      _level_sws_contexts.clear();
+    }
+
     void init_filter() {
+      if (_settings) {
+        _settings_version = _settings->version();
+        _region_of_interest = _settings->region_of_interest();
+        if (auto bounding_size = _settings->bounding_size()) {
+          _bounding_size = *bounding_size;
+        }
+        if (_max_fps != _settings->max_fps()) {
+          _max_fps = _settings->max_fps();
+          _next_pts = -1;
+        }
+      }
+
       std::ostringstream filter_buffer;
 
       const auto &additional = _metadata.additional_data;
@@ -287,6 +535,23 @@ class image_decoder_op {
         }
       }
 
+      // Cropping goes before scaling, so the scaler works only on the region of interest
+      if (!is_whole_frame(_region_of_interest)) {
+        if (filter_buffer.tellp() > 0) {
+          filter_buffer << ",";
+        }
+        filter_buffer << "crop=w=iw*" << _region_of_interest.width
+                      << ":h=ih*" << _region_of_interest.height
+                      << ":x=iw*" << _region_of_interest.x
+                      << ":y=ih*" << _region_of_interest.y;
+      }
+
+      if (can_pass_through(filter_buffer.tellp() > 0)) {
+        LOG(INFO) << "decoded frames are passed through without conversion";
+        _passthrough = true;
+        return;
+      }
+
       if (filter_buffer.tellp() > 0) {
         filter_buffer << ",";
       }
@@ -304,9 +569,18 @@ class image_decoder_op {
                                             _pixel_format);
     }
 
-    const image_size _bounding_size;
+    image_size _bounding_size;
     const image_pixel_format _pixel_format;
     const bool _keep_aspect_ratio;
+    const uint8_t _pyramid_levels;
+    const std::shared_ptr<decoder_settings> _settings;
+    uint64_t _settings_version{0};
+    bool _key_frames_seen{false};
+    bool _waiting_for_key_frame{false};
+    image_region _region_of_interest{0, 0, 1, 1};
+    double _max_fps{0};
+    double _next_pts{-1};
+    int64_t _skipped_since{-1};
     streams::subscription *_source{nullptr};
     uint64_t _current_metadata_frames_counter{0};
     encoded_metadata _metadata;
@@ -315,26 +589,84 @@ class image_decoder_op {
     std::shared_ptr<AVFrame> _frame;
     std::shared_ptr<AVFrame> _filtered_frame;
     std::unique_ptr<av_filter> _filter;
-    std::queue<frame_id> _ids;
+    bool _passthrough{false};
+    std::vector<std::shared_ptr<AVFrame>> _level_frames;
+    std::vector<std::shared_ptr<SwsContext>> _level_sws_contexts;
+    // encoded frames sent to the decoder, but not delivered yet
+    struct pending_frame {
+      frame_id id;
+      std::chrono::system_clock::time_point arrival_time;
+      std::chrono::system_clock::time_point reassembly_time;
+    };
+    std::queue<pending_frame> _pending;
+    std::chrono::system_clock::time_point _decode_time;
   };
 
  private:
   const image_size _bounding_size;
   const image_pixel_format _pixel_format;
   const bool _keep_aspect_ratio;
+  const uint8_t _pyramid_levels;
+  std::shared_ptr<decoder_settings> _settings;
 };
 
 }  // namespace
 
+decoder_settings::decoder_settings(const image_region &region_of_interest)
+    : _region_of_interest{clamp_region(region_of_interest)} {
+  CHECK(is_valid_region(region_of_interest))
+      << "region of interest has no area: " << region_of_interest;
+}
+
+void decoder_settings::set_region_of_interest(const image_region &region) {
+  if (!is_valid_region(region)) {
+    LOG(ERROR) << "ignoring region of interest without area: " << region;
+    return;
+  }
+  std::lock_guard<std::mutex> guard(_mutex);
+  _region_of_interest = clamp_region(region);
+  _version++;
+}
+
+image_region decoder_settings::region_of_interest() const {
+  std::lock_guard<std::mutex> guard(_mutex);
+  return _region_of_interest;
+}
+
+void decoder_settings::set_bounding_size(const image_size &size) {
+  std::lock_guard<std::mutex> guard(_mutex);
+  _bounding_size = size;
+  _version++;
+}
+
+boost::optional<image_size> decoder_settings::bounding_size() const {
+  std::lock_guard<std::mutex> guard(_mutex);
+  return _bounding_size;
+}
+
+void decoder_settings::set_max_fps(double fps) {
+  std::lock_guard<std::mutex> guard(_mutex);
+  _max_fps = std::max(fps, 0.0);
+  _version++;
+}
+
+double decoder_settings::max_fps() const {
+  std::lock_guard<std::mutex> guard(_mutex);
+  return _max_fps;
+}
+
 streams::op<encoded_packet, owned_image_packet> decode_image_frames(
     const image_size &bounding_size, image_pixel_format pixel_format,
-    bool keep_aspect_ratio) {
+    bool keep_aspect_ratio, uint8_t pyramid_levels,
+    std::shared_ptr<decoder_settings> settings) {
   avutils::init();
+  CHECK_LE(pyramid_levels, max_image_levels) << "too many pyramid levels";
 
-  return [bounding_size, pixel_format,
-          keep_aspect_ratio](streams::publisher<encoded_packet> &&src) {
+  return [bounding_size, pixel_format, keep_aspect_ratio, pyramid_levels,
+          settings](streams::publisher<encoded_packet> &&src) {
     return std::move(src)
-           >> image_decoder_op(bounding_size, pixel_format, keep_aspect_ratio);
+           >> image_decoder_op(bounding_size, pixel_format, keep_aspect_ratio,
+                               pyramid_levels, settings);
   };
 }
 
@@ -118,6 +118,7 @@ class file_source_impl {
       auto ts = 1000 * _pkt.pts * _stream->time_base.num / _stream->time_base.den;
       frame.timestamp = _start + std::chrono::milliseconds(ts);
       frame.creation_time = std::chrono::system_clock::now();
+      frame.reassembly_time = frame.creation_time;
       frame.key_frame = static_cast<bool>(_pkt.flags & AV_PKT_FLAG_KEY);
       observer.on_next(frame);
     }
@@ -0,0 +1,177 @@
+#include "frame_encoder.h"
+
+#include <algorithm>
+
+#include "stopwatch.h"
+#include "video_error.h"
+
+namespace satori {
+namespace video {
+
+namespace {
+
+auto &encode_frame_micros = prometheus::BuildHistogram()
+                                .Name("encoder_encode_frame_micros")
+                                .Register(metrics_registry());
+
+auto &encoded_frame_bytes = prometheus::BuildHistogram()
+                                .Name("encoder_encoded_frame_bytes")
+                                .Register(metrics_registry());
+
+auto &encoded_bytes = prometheus::BuildCounter()
+                          .Name("encoder_encoded_bytes_total")
+                          .Register(metrics_registry());
+
+const std::vector<double> micros_buckets = log_linear_buckets(1, 1000000, 9);
+
+const std::vector<double> bytes_buckets = {100,    500,    1000,   2000,   5000,   10000,
+                                           20000,  50000,  100000, 200000, 500000, 1000000};
+
+}  // namespace
+
+frame_encoder::frame_encoder(const std::string &codec_name)
+    : _codec_name(codec_name),
+      _encode_frame_micros(encode_frame_micros.Add({{"codec", codec_name}}, micros_buckets)),
+      _encoded_frame_bytes(encoded_frame_bytes.Add({{"codec", codec_name}}, bytes_buckets)),
+      _encoded_bytes(encoded_bytes.Add({{"codec", codec_name}})) {}
+
+streams::publisher<encoded_packet> frame_encoder::on_image_frame(
+    const owned_image_frame &f) {
+  if (skip_frame(f)) {
+    return streams::publishers::empty<encoded_packet>();
+  }
+
+  const bool resized =
+      _encoder_context && (f.width != _frame->width || f.height != _frame->height);
+  if (!_encoder_context || (resized && restart_on_resize())) {
+    auto metadata = init(f);
+    if (!_encoder_context) {
+      return metadata;
+    }
+    auto frames = encode_frame(f);
+    return streams::publishers::concat(std::move(metadata), std::move(frames));
+  }
+
+  return encode_frame(f);
+}
+
+streams::publisher<encoded_packet> frame_encoder::init(const owned_image_frame &f) {
+  LOG(INFO) << "Initializing " << _codec_name << " encoder for " << f.width << "x"
+            << f.height;
+
+  avutils::init();
+  _encoder_context.reset();
+  _tmp_frame.reset();
+  _sws_context.reset();
+
+  auto context = open_context(f);
+  if (!context) {
+    return streams::publishers::error<encoded_packet>(
+        video_error::STREAM_INITIALIZATION_ERROR);
+  }
+
+  const AVPixelFormat av_pixel_format = avutils::to_av_pixel_format(f.pixel_format);
+  if (av_pixel_format == context->pix_fmt) {
+    // Image planes are handed to the encoder without conversion. The frame is not
+    // reference counted, so avcodec_send_frame still makes one copy of the planes
+    LOG(INFO) << "Encoding frames in native pixel format";
+    _frame = avutils::av_frame();
+    _frame->width = f.width;
+    _frame->height = f.height;
+    _frame->format = av_pixel_format;
+  } else {
+    // TODO: make align parameterizable
+    _tmp_frame = avutils::av_frame(f.width, f.height, 1, av_pixel_format);
+    _frame = avutils::av_frame(f.width, f.height, 1, context->pix_fmt);
+    _sws_context = avutils::sws_context(_tmp_frame, _frame);
+    if (!_sws_context) {
+      return streams::publishers::error<encoded_packet>(
+          video_error::STREAM_INITIALIZATION_ERROR);
+    }
+  }
+
+  const AVCodecDescriptor *descriptor = avcodec_descriptor_get(context->codec_id);
+  _intra_only = descriptor != nullptr && (descriptor->props & AV_CODEC_PROP_INTRA_ONLY);
+  _encoder_context = context;
+
+  encoded_metadata m;
+  m.codec_name = _codec_name;
+  m.codec_data.assign(_encoder_context->extradata,
+                      _encoder_context->extradata + _encoder_context->extradata_size);
+
+  return streams::publishers::of({encoded_packet{m}});
+}
+
+streams::publisher<encoded_packet> frame_encoder::encode_frame(
+    const owned_image_frame &f) {
+  stopwatch<> s;
+  if (_sws_context) {
+    avutils::copy_image_to_av_frame(f, _tmp_frame);
+    avutils::sws_scale(_sws_context, _tmp_frame, _frame);
+  } else {
+    // Planes only need to live during avcodec_send_frame, which copies them
+    CHECK_EQ(f.width, _frame->width) << "Frame size has changed";
+    CHECK_EQ(f.height, _frame->height) << "Frame size has changed";
+    for (int i = 0; i < max_image_planes; i++) {
+      _frame->data[i] = (uint8_t *)f.plane_data[i].data();
+      _frame->linesize[i] = static_cast<int>(f.plane_strides[i]);
+    }
+  }
+
+  // Encoders require strictly increasing timestamps, time base is 1 millisecond
+  const int64_t pts = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          f.timestamp.time_since_epoch())
+                          .count();
+  _frame->pts = std::max(pts, _last_pts + 1);
+  _last_pts = _frame->pts;
+  prepare_frame(*_frame);
+
+  int err = avcodec_send_frame(_encoder_context.get(), _frame.get());
+  if (err < 0) {
+    LOG(ERROR) << "avcodec_send_frame error: " << avutils::error_msg(err);
+    return streams::publishers::error<encoded_packet>(
+        video_error::FRAME_GENERATION_ERROR);
+  }
+
+  std::vector<encoded_packet> packets;
+  while (true) {
+    AVPacket packet;
+    av_init_packet(&packet);
+    packet.data = nullptr;
+    packet.size = 0;
+    int ret = avcodec_receive_packet(_encoder_context.get(), &packet);
+    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+      break;
+    }
+
+    if (ret < 0) {
+      return streams::publishers::error<encoded_packet>(
+          video_error::FRAME_GENERATION_ERROR);
+    }
+
+    _encoded_frame_bytes.Observe(packet.size);
+    _encoded_bytes.Increment(packet.size);
+
+    encoded_frame frame;
+    frame.data.assign(packet.data, packet.data + packet.size);
+    frame.id = f.id;
+    frame.timestamp = f.timestamp;
+    frame.creation_time = std::chrono::system_clock::now();
+    frame.key_frame = _intra_only || static_cast<bool>(packet.flags & AV_PKT_FLAG_KEY);
+    packets.emplace_back(std::move(frame));
+
+    av_packet_unref(&packet);
+  }
+
+  _encode_frame_micros.Observe(s.micros());
+  _counter++;
+  if (_counter % 100 == 0) {
+    LOG(INFO) << "Encoded " << _counter << " " << _codec_name << " frames";
+  }
+  LOG(2) << "Encoded " << _counter << " " << _codec_name << " frames";
+
+  return streams::publishers::of(std::move(packets));
+}
+
+}  // namespace video
+}  // namespace satori
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "avutils.h"
+#include "data.h"
+#include "logging.h"
+#include "metrics.h"
+#include "streams/streams.h"
+
+namespace satori {
+namespace video {
+
+// Common part of FFmpeg image encoders: pixel format conversion, encoding loop
+// and metrics. Encoders only create the codec context with their options.
+class frame_encoder {
+ public:
+  virtual ~frame_encoder() = default;
+
+  streams::publisher<encoded_packet> on_image_frame(const owned_image_frame &f);
+
+ protected:
+  // codec_name goes to encoded_metadata and labels encoder metrics
+  explicit frame_encoder(const std::string &codec_name);
+
+  // Creates and opens codec context for the given first frame, nullptr on error
+  virtual std::shared_ptr<AVCodecContext> open_context(const owned_image_frame &f) = 0;
+
+  // Frames for which it returns true are dropped before encoding
+  virtual bool skip_frame(const owned_image_frame & /*f*/) { return false; }
+
+  // Invoked for every frame right before it is sent to the encoder
+  virtual void prepare_frame(AVFrame & /*frame*/) {}
+
+  // Encoders of independent images restart on frame size change instead of failing
+  virtual bool restart_on_resize() const { return false; }
+
+ private:
+  streams::publisher<encoded_packet> init(const owned_image_frame &f);
+  streams::publisher<encoded_packet> encode_frame(const owned_image_frame &f);
+
+  const std::string _codec_name;
+  prometheus::Histogram &_encode_frame_micros;
+  prometheus::Histogram &_encoded_frame_bytes;
+  prometheus::Counter &_encoded_bytes;
+
+  std::shared_ptr<AVCodecContext> _encoder_context{nullptr};
+  bool _intra_only{false};
+  std::shared_ptr<AVFrame> _tmp_frame{nullptr};  // for pixel format conversion
+  std::shared_ptr<AVFrame> _frame{nullptr};
+  std::shared_ptr<SwsContext> _sws_context{nullptr};
+  int64_t _last_pts{-1};
+  int64_t _counter{0};
+};
+
+// Encodes image frames of a stream with Encoder constructed from options,
+// the encoder lives until the stream ends.
+template <typename Encoder, typename Options>
+streams::op<owned_image_packet, encoded_packet> encode_frames(const Options &options) {
+  return [options](streams::publisher<owned_image_packet> &&src) {
+    auto encoder = new Encoder(options);
+
+    return std::move(src) >> streams::flat_map([encoder](owned_image_packet &&packet) {
+             if (const owned_image_frame *frame =
+                     boost::get<owned_image_frame>(&packet)) {
+               return encoder->on_image_frame(*frame);
+             }
+             return streams::publishers::empty<encoded_packet>();
+           })
+           >> streams::do_finally([encoder]() {
+               LOG(INFO) << "Deleting encoder";
+               delete encoder;
+             });
+  };
+}
+
+}  // namespace video
+}  // namespace satori
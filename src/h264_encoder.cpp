@@ -0,0 +1,68 @@
+#include "h264_encoder.h"
+
+#include "frame_encoder.h"
+
+namespace satori {
+namespace video {
+
+namespace {
+
+constexpr const char *encoder_name = "libx264";
+
+class h264_encoder : public frame_encoder {
+ public:
+  explicit h264_encoder(const h264_encoder_profile &profile)
+      : frame_encoder("h264"), _profile(profile) {}
+
+ private:
+  std::shared_ptr<AVCodecContext> open_context(const owned_image_frame &f) override {
+    const AVCodec *encoder = avcodec_find_encoder_by_name(encoder_name);
+    if (encoder == nullptr) {
+      LOG(ERROR) << "Encoder '" << encoder_name << "' was not found";
+      return nullptr;
+    }
+
+    auto context = avutils::encoder_context(encoder);
+    if (!context) {
+      return nullptr;
+    }
+    context->width = f.width;
+    context->height = f.height;
+    context->gop_size = _profile.keyframe_interval;
+    context->bit_rate = _profile.bitrate;
+    context->thread_count = _profile.threads;
+    // SPS and PPS go to extradata instead of every key frame
+    context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    AVDictionary *codec_options = nullptr;
+    av_dict_set(&codec_options, "preset", _profile.preset.c_str(), 0);
+    av_dict_set(&codec_options, "tune", _profile.tune.c_str(), 0);
+    if (_profile.bitrate == 0) {
+      av_dict_set_int(&codec_options, "crf", _profile.crf, 0);
+    }
+    LOG(INFO) << "h264 profile: preset=" << _profile.preset << " tune=" << _profile.tune
+              << " crf=" << _profile.crf << " bitrate=" << _profile.bitrate
+              << " keyint=" << _profile.keyframe_interval
+              << " threads=" << _profile.threads;
+
+    int ret = avcodec_open2(context.get(), encoder, &codec_options);
+    av_dict_free(&codec_options);
+    if (ret < 0) {
+      LOG(ERROR) << "avcodec_open2 error: " << avutils::error_msg(ret);
+      return nullptr;
+    }
+    return context;
+  }
+
+  const h264_encoder_profile _profile;
+};
+
+}  // namespace
+
+streams::op<owned_image_packet, encoded_packet> encode_h264(
+    const h264_encoder_profile &profile) {
+  return encode_frames<h264_encoder>(profile);
+}
+
+}  // namespace video
+}  // namespace satori
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+#include "data.h"
+#include "streams/streams.h"
+
+namespace satori {
+namespace video {
+
+// libx264 encoder parameters, see http://www.chaneru.com/Roku/HLS/X264_Settings.htm
+// Defaults are tuned for low latency transcoding.
+struct h264_encoder_profile {
+  // x264 preset, from "ultrafast" to "veryslow"
+  std::string preset{"ultrafast"};
+  // x264 tune, "zerolatency" disables frame lookahead and B-frames
+  std::string tune{"zerolatency"};
+  // Constant rate factor 0-51, used when bitrate is zero
+  int crf{23};
+  // Target bitrate in bits per second
+  int64_t bitrate{0};
+  // Max distance between key frames, in frames
+  int keyframe_interval{25};
+  // Zero lets x264 choose
+  int threads{0};
+};
+
+// Encoded packets are in Annex B format, codec_data contains SPS and PPS.
+streams::op<owned_image_packet, encoded_packet> encode_h264(
+    const h264_encoder_profile &profile = h264_encoder_profile{});
+}  // namespace video
+}  // namespace satori
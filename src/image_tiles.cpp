@@ -0,0 +1,119 @@
+#include "image_tiles.h"
+
+#include <algorithm>
+
+#include "bot_instance.h"
+#include "logging.h"
+#include "threadutils.h"
+
+namespace satori {
+namespace video {
+
+namespace {
+
+int align_down(int value, int alignment) { return value - value % alignment; }
+
+}  // namespace
+
+std::vector<tile_rect> split_into_tiles(int width, int height, const image_tiling &tiling,
+                                        int alignment) {
+  CHECK_GT(tiling.columns, 0) << "bad number of tile columns";
+  CHECK_GT(tiling.rows, 0) << "bad number of tile rows";
+  CHECK_GT(alignment, 0);
+
+  std::vector<tile_rect> result;
+  for (int r = 0; r < tiling.rows; r++) {
+    const int top = align_down(height * r / tiling.rows, alignment);
+    const int bottom =
+        r == tiling.rows - 1 ? height : align_down(height * (r + 1) / tiling.rows, alignment);
+
+    for (int c = 0; c < tiling.columns; c++) {
+      const int left = align_down(width * c / tiling.columns, alignment);
+      const int right = c == tiling.columns - 1
+                            ? width
+                            : align_down(width * (c + 1) / tiling.columns, alignment);
+
+      tile_rect rect;
+      rect.x = align_down(std::max(0, left - tiling.overlap), alignment);
+      rect.y = align_down(std::max(0, top - tiling.overlap), alignment);
+      rect.width = std::min(width, right + tiling.overlap) - rect.x;
+      rect.height = std::min(height, bottom + tiling.overlap) - rect.y;
+      result.push_back(rect);
+    }
+  }
+  return result;
+}
+
+int tile_alignment(image_pixel_format pixel_format) {
+  switch (pixel_format) {
+    case image_pixel_format::YUV420P:
+    case image_pixel_format::NV12:
+      return 2;
+    default:
+      return 1;
+  }
+}
+
+image_tile make_tile(const image_frame &frame, const image_metadata &metadata,
+                     image_pixel_format pixel_format, const tile_rect &rect, int index) {
+  image_tile tile;
+  tile.index = index;
+  tile.x = static_cast<uint16_t>(rect.x);
+  tile.y = static_cast<uint16_t>(rect.y);
+  tile.width = static_cast<uint16_t>(rect.width);
+  tile.height = static_cast<uint16_t>(rect.height);
+  std::fill(tile.plane_data, tile.plane_data + max_image_planes, nullptr);
+
+  auto offset = [&frame, &metadata](int plane, int x_bytes, int row) {
+    return frame.plane_data[plane] + static_cast<size_t>(row) * metadata.plane_strides[plane]
+           + x_bytes;
+  };
+
+  switch (pixel_format) {
+    case image_pixel_format::RGB0:
+      tile.plane_data[0] = offset(0, rect.x * 4, rect.y);
+      break;
+    case image_pixel_format::BGR:
+      tile.plane_data[0] = offset(0, rect.x * 3, rect.y);
+      break;
+    case image_pixel_format::GRAY8:
+      tile.plane_data[0] = offset(0, rect.x, rect.y);
+      break;
+    case image_pixel_format::YUV420P:
+      tile.plane_data[0] = offset(0, rect.x, rect.y);
+      tile.plane_data[1] = offset(1, rect.x / 2, rect.y / 2);
+      tile.plane_data[2] = offset(2, rect.x / 2, rect.y / 2);
+      break;
+    case image_pixel_format::NV12:
+      tile.plane_data[0] = offset(0, rect.x, rect.y);
+      // interleaved U and V, two bytes for every two pixels
+      tile.plane_data[1] = offset(1, rect.x, rect.y / 2);
+      break;
+  }
+  return tile;
+}
+
+void process_tiles(const image_frame &frame, const image_metadata &metadata,
+                   image_pixel_format pixel_format, const image_tiling &tiling,
+                   const bot_tile_callback_t &callback) {
+  const std::vector<tile_rect> rects = split_into_tiles(
+      metadata.width, metadata.height, tiling, tile_alignment(pixel_format));
+
+  std::vector<std::function<void()>> tasks;
+  for (size_t i = 0; i < rects.size(); i++) {
+    tasks.emplace_back([&frame, &metadata, pixel_format, &rects, &callback, i]() {
+      callback(make_tile(frame, metadata, pixel_format, rects[i], static_cast<int>(i)));
+    });
+  }
+  threadutils::shared_thread_pool().run(std::move(tasks));
+}
+
+void bot_process_tiles(bot_context &context, const image_frame &frame,
+                       const image_tiling &tiling, const bot_tile_callback_t &callback) {
+  process_tiles(frame, *context.frame_metadata,
+                static_cast<bot_callback_context &>(context).pixel_format(), tiling,
+                callback);
+}
+
+}  // namespace video
+}  // namespace satori
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+
+#include "satorivideo/video_bot.h"
+
+namespace satori {
+namespace video {
+
+struct tile_rect {
+  int x;
+  int y;
+  int width;
+  int height;
+};
+
+// Splits width x height area into tiling.columns x tiling.rows tiles, row by row.
+// Tile edges are aligned to alignment pixels.
+std::vector<tile_rect> split_into_tiles(int width, int height, const image_tiling &tiling,
+                                        int alignment = 1);
+
+// Pixel alignment that keeps subsampled planes of the format in sync with the first one
+int tile_alignment(image_pixel_format pixel_format);
+
+// Points tile planes to the given part of the frame
+image_tile make_tile(const image_frame &frame, const image_metadata &metadata,
+                     image_pixel_format pixel_format, const tile_rect &rect, int index);
+
+void process_tiles(const image_frame &frame, const image_metadata &metadata,
+                   image_pixel_format pixel_format, const image_tiling &tiling,
+                   const bot_tile_callback_t &callback);
+
+}  // namespace video
+}  // namespace satori
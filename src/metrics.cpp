@@ -3,14 +3,17 @@
 #include <prometheus/exposer.h>
 #include <prometheus/text_serializer.h>
 #include <boost/timer/timer.hpp>
+#include <algorithm>
 #include <chrono>
 #include <json.hpp>
+#include <unordered_map>
 
 #ifdef HAS_GPERFTOOLS
 #include <gperftools/malloc_extension.h>
 #endif
 
 #include "logging.h"
+#include "threadutils.h"
 
 namespace po = boost::program_options;
 
@@ -52,6 +55,18 @@ auto& process_start_time = prometheus::BuildGauge()
                                .Register(metrics_registry())
                                .Add({});
 
+auto& thread_cpu_user_time_sec_family = prometheus::BuildCounter()
+                                            .Name("thread_cpu_user_time_sec")
+                                            .Register(metrics_registry());
+
+auto& thread_cpu_system_time_sec_family = prometheus::BuildCounter()
+                                              .Name("thread_cpu_system_time_sec")
+                                              .Register(metrics_registry());
+
+auto& thread_context_switches_total_family = prometheus::BuildCounter()
+                                                 .Name("thread_context_switches_total")
+                                                 .Register(metrics_registry());
+
 #ifdef HAS_GPERFTOOLS
 void report_tcmalloc_metrics() {
   MallocExtension* extension = MallocExtension::instance();
@@ -85,8 +100,45 @@ void report_tcmalloc_metrics() {
 void report_tcmalloc_metrics() {}
 #endif
 
+// Threads with the same name, like pool workers after a restart, are summed up.
+// Counters are advanced by per-thread deltas, so they don't go back when a thread exits.
+void report_thread_metrics() {
+  static metric_cache<prometheus::Counter> user_time{thread_cpu_user_time_sec_family,
+                                                     "thread"};
+  static metric_cache<prometheus::Counter> system_time{thread_cpu_system_time_sec_family,
+                                                       "thread"};
+  static metric_cache<prometheus::Counter> voluntary_switches{
+      thread_context_switches_total_family, "thread", {{"kind", "voluntary"}}};
+  static metric_cache<prometheus::Counter> involuntary_switches{
+      thread_context_switches_total_family, "thread", {{"kind", "involuntary"}}};
+  static std::unordered_map<int, threadutils::thread_cpu_usage> previous;
+
+  std::unordered_map<int, threadutils::thread_cpu_usage> current;
+  for (threadutils::thread_cpu_usage& usage : threadutils::get_threads_cpu_usage()) {
+    threadutils::thread_cpu_usage last{usage.tid, usage.name, 0, 0, 0, 0};
+    auto it = previous.find(usage.tid);
+    if (it != previous.end()) {
+      last = it->second;
+    }
+
+    user_time.get(usage.name).Increment(
+        std::max(0.0, usage.user_time_sec - last.user_time_sec));
+    system_time.get(usage.name).Increment(
+        std::max(0.0, usage.system_time_sec - last.system_time_sec));
+    voluntary_switches.get(usage.name).Increment(
+        usage.voluntary_context_switches - last.voluntary_context_switches);
+    involuntary_switches.get(usage.name).Increment(
+        usage.involuntary_context_switches - last.involuntary_context_switches);
+
+    const int tid = usage.tid;
+    current.emplace(tid, std::move(usage));
+  }
+  previous = std::move(current);
+}
+
 void report_process_metrics() {
   report_tcmalloc_metrics();
+  report_thread_metrics();
   static boost::timer::cpu_timer cpu_timer;
 
   // scrape cpu timer
@@ -219,6 +271,25 @@ metrics& global_metrics() {
 
 }  // namespace
 
+std::vector<double> log_linear_buckets(double lowest, double highest, int sub_buckets) {
+  CHECK_GT(lowest, 0) << "bad lowest bucket";
+  CHECK_GT(highest, lowest) << "bad highest bucket";
+  CHECK_GT(sub_buckets, 0) << "bad number of sub-buckets";
+
+  std::vector<double> buckets{0};
+  for (double decade = lowest; decade < highest; decade *= 10) {
+    for (int i = 0; i < sub_buckets; i++) {
+      const double bucket = decade + decade * 9 * i / sub_buckets;
+      if (bucket >= highest) {
+        break;
+      }
+      buckets.push_back(bucket);
+    }
+  }
+  buckets.push_back(highest);
+  return buckets;
+}
+
 prometheus::Registry& metrics_registry() { return global_metrics().registry(); }
 
 po::options_description metrics_options(bool allow_push) {
@@ -8,6 +8,10 @@
 #include <boost/asio.hpp>
 #include <boost/program_options.hpp>
 #include <boost/program_options/options_description.hpp>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include "rtm_client.h"
 
 namespace satori {
@@ -25,6 +29,46 @@ struct metrics_config {
 
 prometheus::Registry& metrics_registry();
 
+// Log-linear bucket boundaries, like in HDR histograms: every decade starting
+// from lowest is split into sub_buckets equal parts, so relative precision is
+// the same for small and large values. lowest should be a power of 10,
+// e.g. log_linear_buckets(1, 1000, 9) is {0, 1, 2, ..., 9, 10, 20, ..., 90, 100, ..., 1000}.
+std::vector<double> log_linear_buckets(double lowest, double highest, int sub_buckets);
+
+// Family::Add() takes the family lock and hashes all labels on every call.
+// metric_cache resolves every value of a single label once, after that
+// a lookup is a hash of the value and the update is the metric's own atomic.
+// Not thread-safe, a cache belongs to a single thread or object.
+template <typename T>
+class metric_cache {
+ public:
+  metric_cache(prometheus::Family<T>& family, std::string label_name,
+               std::map<std::string, std::string> const_labels = {})
+      : _family(family),
+        _label_name(std::move(label_name)),
+        _const_labels(std::move(const_labels)) {}
+
+  // Extra arguments, like histogram buckets, are used when the metric is created
+  template <typename... Args>
+  T& get(const std::string& label_value, Args&&... args) {
+    auto it = _metrics.find(label_value);
+    if (it != _metrics.end()) {
+      return *it->second;
+    }
+    std::map<std::string, std::string> labels = _const_labels;
+    labels[_label_name] = label_value;
+    T& metric = _family.Add(labels, std::forward<Args>(args)...);
+    _metrics.emplace(label_value, &metric);
+    return metric;
+  }
+
+ private:
+  prometheus::Family<T>& _family;
+  const std::string _label_name;
+  const std::map<std::string, std::string> _const_labels;
+  std::unordered_map<std::string, T*> _metrics;
+};
+
 boost::program_options::options_description metrics_options(bool allow_push = false);
 
 void init_metrics(const metrics_config& config, boost::asio::io_service& io_service);
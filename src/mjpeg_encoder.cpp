@@ -0,0 +1,82 @@
+#include "frame_encoder.h"
+#include "video_streams.h"
+
+namespace satori {
+namespace video {
+
+namespace {
+
+auto &frames_skipped = prometheus::BuildCounter()
+                           .Name("mjpeg_frames_skipped_total")
+                           .Register(metrics_registry())
+                           .Add({});
+
+class mjpeg_encoder : public frame_encoder {
+ public:
+  explicit mjpeg_encoder(const mjpeg_encoder_options &options)
+      : frame_encoder("mjpeg"), _options(options) {
+    CHECK_GE(_options.quality, 2) << "bad mjpeg quality";
+    CHECK_LE(_options.quality, 31) << "bad mjpeg quality";
+    CHECK_GE(_options.max_fps, 0) << "bad mjpeg max fps";
+  }
+
+ private:
+  bool skip_frame(const owned_image_frame &f) override {
+    if (_options.max_fps == 0) {
+      return false;
+    }
+
+    const auto min_interval = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::duration<double>(1.0 / _options.max_fps));
+    if (_last_timestamp && f.timestamp < *_last_timestamp + min_interval) {
+      frames_skipped.Increment();
+      return true;
+    }
+    _last_timestamp = f.timestamp;
+    return false;
+  }
+
+  // Snapshots are independent images, so size change just restarts the encoder
+  bool restart_on_resize() const override { return true; }
+
+  void prepare_frame(AVFrame &frame) override {
+    frame.quality = FF_QP2LAMBDA * _options.quality;
+  }
+
+  // mjpeg works in full range YUV, so even YUV420P frames are converted
+  std::shared_ptr<AVCodecContext> open_context(const owned_image_frame &f) override {
+    LOG(INFO) << "mjpeg options: quality=" << _options.quality
+              << " max_fps=" << _options.max_fps;
+
+    auto context = avutils::encoder_context(AV_CODEC_ID_MJPEG);
+    if (!context) {
+      return nullptr;
+    }
+    context->width = f.width;
+    context->height = f.height;
+    // Fixed quantizer instead of bitrate control
+    context->flags |= AV_CODEC_FLAG_QSCALE;
+    context->global_quality = FF_QP2LAMBDA * _options.quality;
+    context->qmin = context->qmax = _options.quality;
+
+    int ret = avcodec_open2(context.get(), nullptr, nullptr);
+    if (ret < 0) {
+      LOG(ERROR) << "avcodec_open2 error: " << avutils::error_msg(ret);
+      return nullptr;
+    }
+    return context;
+  }
+
+  const mjpeg_encoder_options _options;
+  boost::optional<std::chrono::system_clock::time_point> _last_timestamp;
+};
+
+}  // namespace
+
+streams::op<owned_image_packet, encoded_packet> encode_as_mjpeg(
+    const mjpeg_encoder_options &options) {
+  return encode_frames<mjpeg_encoder>(options);
+}
+
+}  // namespace video
+}  // namespace satori
@@ -6,25 +6,40 @@ namespace satori {
 namespace video {
 
 namespace {
-cv::Mat get_image(const bot_context &context, const image_frame &frame) {
+int to_cv_type(image_pixel_format pixel_format) {
+  switch (pixel_format) {
+    case image_pixel_format::BGR:
+      return CV_8UC3;
+    case image_pixel_format::GRAY8:
+    case image_pixel_format::YUV420P:
+    case image_pixel_format::NV12:
+      return CV_8UC1;
+    default:
+      ABORT() << "unsupported pixel format for opencv bot: " << (int)pixel_format;
+  }
+}
+
+cv::Mat get_image(const bot_context &context, const image_frame &frame, int cv_type) {
   CHECK(context.frame_metadata->width != 0);
   const uint8_t *buffer = frame.plane_data[0];
   auto line_size = context.frame_metadata->plane_strides[0];
-  return cv::Mat(context.frame_metadata->height, context.frame_metadata->width, CV_8UC3,
+  return cv::Mat(context.frame_metadata->height, context.frame_metadata->width, cv_type,
                  (void *)buffer, line_size);
 }
 
-bot_img_callback_t to_bot_img_callback(const opencv_bot_img_callback_t &callback) {
-  return [callback](bot_context &context, const image_frame &frame) {
-    return callback(context, get_image(context, frame));
+bot_img_callback_t to_bot_img_callback(const opencv_bot_img_callback_t &callback,
+                                       image_pixel_format pixel_format) {
+  const int cv_type = to_cv_type(pixel_format);
+  return [callback, cv_type](bot_context &context, const image_frame &frame) {
+    return callback(context, get_image(context, frame, cv_type));
   };
 }
 
 }  // namespace
 
 void opencv_bot_register(const opencv_bot_descriptor &bot) {
-  bot_register({image_pixel_format::BGR, to_bot_img_callback(bot.img_callback),
-                bot.ctrl_callback});
+  bot_register({bot.pixel_format, to_bot_img_callback(bot.img_callback, bot.pixel_format),
+                bot.ctrl_callback, 0, bot.region_of_interest, bot.concurrency, bot.name});
 }
 
 int opencv_bot_main(int argc, char **argv) { return bot_main(argc, argv); }
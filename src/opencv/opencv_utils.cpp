@@ -1,5 +1,7 @@
 #include "satorivideo/opencv/opencv_utils.h"
+#include "../image_tiles.h"
 #include "../logging.h"
+#include "../threadutils.h"
 
 namespace satori {
 namespace video {
@@ -15,6 +17,20 @@ void log_image(const cv::Mat &image) {
   }
 }
 
+void process_tiles(const cv::Mat &image, const image_tiling &tiling,
+                   const tile_callback_t &callback) {
+  const std::vector<tile_rect> rects = split_into_tiles(image.cols, image.rows, tiling);
+
+  std::vector<std::function<void()>> tasks;
+  for (size_t i = 0; i < rects.size(); i++) {
+    tasks.emplace_back([&image, &rects, &callback, i]() {
+      const cv::Rect rect{rects[i].x, rects[i].y, rects[i].width, rects[i].height};
+      callback(image(rect), rect, static_cast<int>(i));
+    });
+  }
+  threadutils::shared_thread_pool().run(std::move(tasks));
+}
+
 nlohmann::json to_json(cv::Point2d p) { return nlohmann::json::array({p.x, p.y}); }
 
 nlohmann::json to_json(cv::Rect2d rect) {
@@ -1,8 +1,14 @@
 #include "pool_controller.h"
+#include <sys/resource.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
 #include <gsl/gsl>
 #include <json.hpp>
 #include <random>
 
+#include "resource_governor.h"
+
 namespace satori {
 namespace video {
 namespace {
@@ -15,16 +21,81 @@ std::string make_node_id() {
   return std::to_string(node_id_gen(rng_engine));
 }
 const std::string node_id = make_node_id();
+
+// Weight of the latest sample in smoothed CPU usage
+constexpr double cpu_smoothing = 0.3;
+constexpr double min_measure_period = 0.1;  // seconds
+
+double process_cpu_seconds() {
+  struct rusage r;
+  if (getrusage(RUSAGE_SELF, &r) != 0) {
+    return 0;
+  }
+  return r.ru_utime.tv_sec + r.ru_utime.tv_usec / 1e6 + r.ru_stime.tv_sec
+         + r.ru_stime.tv_usec / 1e6;
+}
+
+uint64_t process_resident_bytes() {
+#if defined(__linux__)
+  std::ifstream statm("/proc/self/statm");
+  uint64_t size_pages = 0;
+  uint64_t resident_pages = 0;
+  if (statm >> size_pages >> resident_pages) {
+    return resident_pages * sysconf(_SC_PAGESIZE);
+  }
+#endif
+  return 0;
+}
 }  // namespace
 
+pool_resource_model::pool_resource_model(const boost::program_options::variables_map &vm,
+                                         size_t max_jobs)
+    : max_jobs(max_jobs) {
+  if (vm.count("pool-cpu-percent") > 0) {
+    cpu_percent = vm["pool-cpu-percent"].as<double>();
+  }
+  if (vm.count("pool-memory-mb") > 0) {
+    memory_bytes = vm["pool-memory-mb"].as<size_t>() * 1024 * 1024;
+  }
+  if (vm.count("pool-job-cpu-percent") > 0) {
+    job_cpu_percent = vm["pool-job-cpu-percent"].as<double>();
+  }
+  if (vm.count("pool-job-memory-mb") > 0) {
+    job_memory_bytes = vm["pool-job-memory-mb"].as<size_t>() * 1024 * 1024;
+  }
+}
+
+size_t available_capacity(const pool_resource_model &model, size_t jobs,
+                          const node_load &load) {
+  if (jobs >= model.max_jobs) {
+    return 0;
+  }
+  size_t result = model.max_jobs - jobs;
+
+  const auto fit = [&result, jobs](double limit, double used, double expected_cost) {
+    if (limit <= 0) {
+      return;
+    }
+    const double cost = jobs > 0 ? used / jobs : expected_cost;
+    if (cost <= 0) {
+      return;
+    }
+    const double free = std::max(0.0, limit - used);
+    result = std::min(result, static_cast<size_t>(free / cost));
+  };
+  fit(model.cpu_percent, load.cpu_percent, model.job_cpu_percent);
+  fit(model.memory_bytes, load.memory_bytes, model.job_memory_bytes);
+  return result;
+}
+
 pool_job_controller::pool_job_controller(boost::asio::io_service &io,
                                          const std::string &pool,
                                          const std::string &job_type,
-                                         size_t max_streams_capacity,
+                                         const pool_resource_model &resources,
                                          std::shared_ptr<rtm::client> &rtm_client,
                                          job_controller &streams)
     : _io(io),
-      _max_streams_capacity(max_streams_capacity),
+      _resources(resources),
       _pool(pool),
       _job_type(job_type),
       _client(rtm_client),
@@ -35,9 +106,25 @@ void pool_job_controller::start() {
             << " node_id=" << node_id;
   _client->subscribe(_pool, _pool_sub, *this, nullptr);
   _hb_timer = std::make_unique<boost::asio::deadline_timer>(_io);
+  _last_measure_time = std::chrono::steady_clock::now();
+  _last_cpu_seconds = process_cpu_seconds();
   on_heartbeat({});
 }
 
+node_load pool_job_controller::measure_load() {
+  const auto now = std::chrono::steady_clock::now();
+  const double cpu_seconds = process_cpu_seconds();
+  const double wall = std::chrono::duration<double>(now - _last_measure_time).count();
+  // the first heartbeat is sent right after start
+  if (wall >= min_measure_period) {
+    const double sample = (cpu_seconds - _last_cpu_seconds) / wall * 100;
+    _cpu_percent = cpu_smoothing * sample + (1 - cpu_smoothing) * _cpu_percent;
+    _last_measure_time = now;
+    _last_cpu_seconds = cpu_seconds;
+  }
+  return {_cpu_percent, process_resident_bytes()};
+}
+
 void pool_job_controller::on_heartbeat(const boost::system::error_code &ec) {
   if (ec.value() != 0) {
     if (ec == boost::asio::error::operation_aborted) {
@@ -53,13 +140,27 @@ void pool_job_controller::on_heartbeat(const boost::system::error_code &ec) {
   const auto jobs = _streams.list_jobs();
   CHECK(jobs.is_array()) << "not an array: " << jobs;
 
-  nlohmann::json available_capacity = nlohmann::json::object();
-  available_capacity[_job_type] = _max_streams_capacity - jobs.size();
+  const node_load load = measure_load();
+  size_t capacity = available_capacity(_resources, jobs.size(), load);
+  if (resource_governor::current_level() >= resource_governor::level::REFUSE_JOBS) {
+    capacity = 0;
+  }
+
+  nlohmann::json capacity_by_type = nlohmann::json::object();
+  capacity_by_type[_job_type] = capacity;
+
+  nlohmann::json node = nlohmann::json::object();
+  node["cpu_percent"] = load.cpu_percent;
+  node["memory_bytes"] = load.memory_bytes;
+  node["buffered_bytes"] = resource_governor::buffered_bytes();
+  node["resource_level"] = resource_governor::to_string(resource_governor::current_level());
+  node["jobs"] = _streams.jobs_load();
 
   nlohmann::json hb_message = nlohmann::json::object();
   hb_message["from"] = node_id;
   hb_message["active_jobs"] = jobs;
-  hb_message["available_capacity"] = available_capacity;
+  hb_message["available_capacity"] = capacity_by_type;
+  hb_message["load"] = node;
 
   LOG(2) << "sending heartbeat: " << hb_message;
   _client->publish(_pool, std::move(hb_message));
@@ -109,7 +210,20 @@ void pool_job_controller::start_job(const nlohmann::json &job) {
 
 void pool_job_controller::stop_job(const nlohmann::json &job) {
   LOG(INFO) << "stop_job: " << job;
-  _streams.remove_job(job);
+  // the job may finish draining after the controller is shut down
+  _streams.remove_job(job, [client = _client, pool = _pool, job_type = _job_type](
+                               const nlohmann::json &stopped, const nlohmann::json &state) {
+    nlohmann::json note = nlohmann::json::object();
+    note["from"] = node_id;
+    note["job_type"] = job_type;
+    note["job_stopped"] = stopped;
+    if (!state.is_null()) {
+      note["state"] = state;
+    }
+
+    LOG(INFO) << "sending job stopped note " << note;
+    client->publish(pool, std::move(note));
+  });
 }
 
 void pool_job_controller::on_error(std::error_condition ec) {
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <boost/program_options.hpp>
+#include <functional>
 #include <json.hpp>
 #include <list>
 #include <string>
@@ -8,17 +10,54 @@
 namespace satori {
 namespace video {
 
+// Called with the stopped job and the state it can be started from elsewhere,
+// state is null if the job has none
+using job_stopped_callback =
+    std::function<void(const nlohmann::json &job, const nlohmann::json &state)>;
+
 struct job_controller {
   virtual ~job_controller() = default;
   virtual void add_job(const nlohmann::json &job) = 0;
-  virtual void remove_job(const nlohmann::json &job) = 0;
+  // Drains the job stream before stopping it, on_stopped is called after that
+  // on the io thread. Unknown jobs are ignored.
+  virtual void remove_job(const nlohmann::json &job, job_stopped_callback &&on_stopped) = 0;
   virtual nlohmann::json list_jobs() const = 0;
+  // Load of every job since the previous call, objects with a "job" field
+  virtual nlohmann::json jobs_load() { return nlohmann::json::array(); }
+};
+
+// Resources of the node that jobs can use. Capacity reported in heartbeats is
+// the number of jobs like the running ones that still fit, so that jobs with
+// heavy streams take more room than jobs with light ones.
+struct pool_resource_model {
+  pool_resource_model() = default;
+  pool_resource_model(const boost::program_options::variables_map &vm, size_t max_jobs);
+
+  size_t max_jobs{1};
+  // CPU time of the process per second, 100 is a single core, 0 means no limit
+  double cpu_percent{0};
+  // resident memory of the process, 0 means no limit
+  uint64_t memory_bytes{0};
+  // expected cost of a job while there are no running jobs to measure, 0 means unknown
+  double job_cpu_percent{0};
+  uint64_t job_memory_bytes{0};
 };
 
+// Measured load of the whole process
+struct node_load {
+  double cpu_percent;
+  uint64_t memory_bytes;
+};
+
+// Number of jobs that still fit into the model, the cost of a new job is
+// the average cost of running ones
+size_t available_capacity(const pool_resource_model &model, size_t jobs,
+                          const node_load &load);
+
 class pool_job_controller : rtm::subscription_callbacks {
  public:
   pool_job_controller(boost::asio::io_service &io, const std::string &pool,
-                      const std::string &job_type, size_t max_streams_capacity,
+                      const std::string &job_type, const pool_resource_model &resources,
                       std::shared_ptr<rtm::client> &rtm_client, job_controller &streams);
 
   void start();
@@ -26,6 +65,7 @@ class pool_job_controller : rtm::subscription_callbacks {
 
  private:
   void on_heartbeat(const boost::system::error_code &ec);
+  node_load measure_load();
   void on_data(const rtm::subscription & /*subscription*/,
                rtm::channel_data &&data) override;
   void start_job(const nlohmann::json &job);
@@ -33,13 +73,16 @@ class pool_job_controller : rtm::subscription_callbacks {
   void on_error(std::error_condition ec) override;
 
   boost::asio::io_service &_io;
-  const size_t _max_streams_capacity;
+  const pool_resource_model _resources;
   const std::string _pool;
   const std::string _job_type;
   std::shared_ptr<rtm::client> _client;
   const rtm::subscription _pool_sub{};
   std::unique_ptr<boost::asio::deadline_timer> _hb_timer;
   job_controller &_streams;
+  std::chrono::steady_clock::time_point _last_measure_time;
+  double _last_cpu_seconds{0};
+  double _cpu_percent{0};
 };
 }  // namespace video
 }  // namespace satori
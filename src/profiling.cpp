@@ -0,0 +1,209 @@
+#include "profiling.h"
+
+#include <unistd.h>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#ifdef HAS_GPERFTOOLS
+#include <gperftools/heap-profiler.h>
+#include <gperftools/profiler.h>
+#endif
+
+#include "logging.h"
+#include "threadutils.h"
+
+namespace satori {
+namespace video {
+namespace profiling {
+
+namespace {
+
+struct profiler_state {
+  ~profiler_state() {
+    if (timer.joinable()) {
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+        stop_requested = true;
+      }
+      stop_condition.notify_all();
+      timer.join();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable stop_condition;
+  bool stop_requested{false};
+  bool running{false};
+  std::thread timer;
+  std::string output_dir{"."};
+  std::string cpu_file;
+  std::string heap_file;
+};
+
+profiler_state &get_state() {
+  static profiler_state state;
+  return state;
+}
+
+#ifdef HAS_GPERFTOOLS
+bool start_profilers(const std::string &cpu_file, const std::string &heap_file) {
+  if (!cpu_file.empty() && ProfilerStart(cpu_file.c_str()) == 0) {
+    LOG(ERROR) << "can't start cpu profiler, file " << cpu_file;
+    return false;
+  }
+  if (!heap_file.empty()) {
+    if (IsHeapProfilerRunning()) {
+      LOG(ERROR) << "heap profiler is already running";
+      if (!cpu_file.empty()) {
+        ProfilerStop();
+      }
+      return false;
+    }
+    HeapProfilerStart(heap_file.c_str());
+  }
+  return true;
+}
+
+void stop_profilers(const std::string &cpu_file, const std::string &heap_file) {
+  if (!cpu_file.empty()) {
+    ProfilerStop();
+    LOG(INFO) << "wrote cpu profile to " << cpu_file;
+  }
+  if (!heap_file.empty()) {
+    // heap profiler names its own periodic dumps, so the final one is written here
+    char *profile = GetHeapProfile();
+    std::ofstream out(heap_file);
+    if (out && profile != nullptr) {
+      out << profile;
+      LOG(INFO) << "wrote heap profile to " << heap_file;
+    } else {
+      LOG(ERROR) << "can't write heap profile to " << heap_file;
+    }
+    free(profile);
+    HeapProfilerStop();
+  }
+}
+#else
+bool start_profilers(const std::string & /*cpu_file*/, const std::string & /*heap_file*/) {
+  return false;
+}
+
+void stop_profilers(const std::string & /*cpu_file*/, const std::string & /*heap_file*/) {}
+#endif
+
+void finish() {
+  profiler_state &state = get_state();
+  std::string cpu_file;
+  std::string heap_file;
+  {
+    std::lock_guard<std::mutex> guard(state.mutex);
+    cpu_file = state.cpu_file;
+    heap_file = state.heap_file;
+  }
+
+  stop_profilers(cpu_file, heap_file);
+
+  std::lock_guard<std::mutex> guard(state.mutex);
+  state.running = false;
+}
+
+}  // namespace
+
+bool is_available() {
+#ifdef HAS_GPERFTOOLS
+  return true;
+#else
+  return false;
+#endif
+}
+
+void set_output_dir(const std::string &dir) {
+  profiler_state &state = get_state();
+  std::lock_guard<std::mutex> guard(state.mutex);
+  state.output_dir = dir;
+}
+
+std::vector<std::string> start(bool cpu, bool heap, std::chrono::milliseconds duration) {
+  if (!is_available()) {
+    LOG(ERROR) << "built without gperftools, profiling is not available";
+    return {};
+  }
+  if (!cpu && !heap) {
+    LOG(ERROR) << "no profiler is requested";
+    return {};
+  }
+
+  profiler_state &state = get_state();
+  std::thread previous;
+  {
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (state.running) {
+      LOG(WARNING) << "profiling is already on";
+      return {};
+    }
+    previous = std::move(state.timer);
+  }
+  if (previous.joinable()) {
+    previous.join();
+  }
+
+  std::lock_guard<std::mutex> guard(state.mutex);
+  if (state.running || state.timer.joinable()) {
+    LOG(WARNING) << "profiling is already on";
+    return {};
+  }
+
+  const std::string prefix =
+      state.output_dir + "/profile-" + std::to_string(getpid()) + "-"
+      + std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
+                           std::chrono::system_clock::now().time_since_epoch())
+                           .count());
+  state.cpu_file = cpu ? prefix + ".cpu.prof" : "";
+  state.heap_file = heap ? prefix + ".heap" : "";
+  if (!start_profilers(state.cpu_file, state.heap_file)) {
+    return {};
+  }
+
+  LOG(INFO) << "started profiling for " << duration.count() << "ms, files "
+            << state.cpu_file << " " << state.heap_file;
+  state.running = true;
+  state.stop_requested = false;
+  state.timer = std::thread([duration, &state]() {
+    threadutils::set_current_thread_name("profiler");
+    {
+      std::unique_lock<std::mutex> lock(state.mutex);
+      state.stop_condition.wait_for(lock, duration,
+                                    [&state]() { return state.stop_requested; });
+    }
+    finish();
+  });
+
+  std::vector<std::string> files;
+  for (const std::string &f : {state.cpu_file, state.heap_file}) {
+    if (!f.empty()) {
+      files.push_back(f);
+    }
+  }
+  return files;
+}
+
+void stop() {
+  profiler_state &state = get_state();
+  std::thread timer;
+  {
+    std::lock_guard<std::mutex> guard(state.mutex);
+    state.stop_requested = true;
+    timer = std::move(state.timer);
+  }
+  state.stop_condition.notify_all();
+  if (timer.joinable()) {
+    timer.join();
+  }
+}
+
+}  // namespace profiling
+}  // namespace video
+}  // namespace satori
@@ -0,0 +1,32 @@
+// CPU and heap profiling of a running process with gperftools.
+// Profiles can be viewed with pprof, e.g. pprof --web <binary> <file>.
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace satori {
+namespace video {
+namespace profiling {
+
+constexpr std::chrono::milliseconds default_duration{30000};
+
+// False if the binary is built without gperftools
+bool is_available();
+
+// Sets the directory profiles are written to, current directory by default
+void set_output_dir(const std::string &dir);
+
+// Starts requested profilers, after the duration profiles are written and
+// profilers stop. Returns paths of the files profiles will be written to,
+// or nothing if profiling is not available, already on or can't be started.
+std::vector<std::string> start(bool cpu, bool heap, std::chrono::milliseconds duration);
+
+// Writes profiles and stops profilers before the end of the duration,
+// does nothing if profiling is off
+void stop();
+
+}  // namespace profiling
+}  // namespace video
+}  // namespace satori
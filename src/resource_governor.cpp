@@ -0,0 +1,234 @@
+#include "resource_governor.h"
+
+#include <sys/resource.h>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "logging.h"
+#include "metrics.h"
+#include "threadutils.h"
+
+namespace satori {
+namespace video {
+namespace resource_governor {
+
+namespace impl {
+std::atomic<int> current_level{static_cast<int>(level::NORMAL)};
+std::atomic<int64_t> buffered_bytes[buffers_count];
+}  // namespace impl
+
+namespace {
+
+constexpr std::chrono::seconds check_period{1};
+constexpr double relax_ratio = 0.8;
+constexpr int levels_count = static_cast<int>(level::REFUSE_JOBS) + 1;
+
+const std::array<std::string, buffers_count> buffer_names = {
+    {"async_queue", "worker_queue", "network_frame_chunks", "rtm_sink_backlog",
+     "rtm_pending_requests", "shared_frames"}};
+
+auto &level_gauge = prometheus::BuildGauge()
+                        .Name("resource_governor_level")
+                        .Register(metrics_registry())
+                        .Add({});
+
+auto &cpu_percent_gauge = prometheus::BuildGauge()
+                              .Name("resource_governor_cpu_percent")
+                              .Register(metrics_registry())
+                              .Add({});
+
+auto &buffered_bytes_family = prometheus::BuildGauge()
+                                  .Name("resource_governor_buffered_bytes")
+                                  .Register(metrics_registry());
+
+auto &escalations_family = prometheus::BuildCounter()
+                               .Name("resource_governor_escalations_total")
+                               .Register(metrics_registry());
+
+auto &shed_frames_family = prometheus::BuildCounter()
+                               .Name("resource_governor_shed_frames_total")
+                               .Register(metrics_registry());
+
+auto &refused_jobs = prometheus::BuildCounter()
+                         .Name("resource_governor_refused_jobs_total")
+                         .Register(metrics_registry())
+                         .Add({});
+
+// Every level is resolved once, shedding happens on decoder and worker threads
+std::array<prometheus::Counter *, levels_count> make_level_counters(
+    prometheus::Family<prometheus::Counter> &family) {
+  std::array<prometheus::Counter *, levels_count> counters;
+  for (int i = 0; i < levels_count; i++) {
+    counters[i] = &family.Add({{"level", to_string(static_cast<level>(i))}});
+  }
+  return counters;
+}
+
+const std::array<prometheus::Counter *, levels_count> escalations =
+    make_level_counters(escalations_family);
+const std::array<prometheus::Counter *, levels_count> shed_frames =
+    make_level_counters(shed_frames_family);
+
+double process_cpu_seconds() {
+  struct rusage r;
+  if (getrusage(RUSAGE_SELF, &r) != 0) {
+    return 0;
+  }
+  return r.ru_utime.tv_sec + r.ru_utime.tv_usec / 1e6 + r.ru_stime.tv_sec
+         + r.ru_stime.tv_usec / 1e6;
+}
+
+struct governor_state {
+  ~governor_state() {
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      stop_requested = true;
+    }
+    stop_condition.notify_all();
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable stop_condition;
+  bool stop_requested{false};
+  std::thread thread;
+  // accessed by the thread that evaluates usage
+  int calm_periods{0};
+};
+
+governor_state &get_state() {
+  static governor_state state;
+  return state;
+}
+
+bool over_limit(double value, double limit, double ratio) {
+  return limit > 0 && value > limit * ratio;
+}
+
+void run(const budget b) {
+  threadutils::set_current_thread_name("governor");
+  governor_state &state = get_state();
+
+  auto last_time = std::chrono::steady_clock::now();
+  double last_cpu = process_cpu_seconds();
+  std::unique_lock<std::mutex> lock(state.mutex);
+  while (!state.stop_condition.wait_for(lock, check_period,
+                                        [&state]() { return state.stop_requested; })) {
+    const auto now = std::chrono::steady_clock::now();
+    const double cpu = process_cpu_seconds();
+    const double wall = std::chrono::duration<double>(now - last_time).count();
+    const double cpu_percent = wall > 0 ? (cpu - last_cpu) / wall * 100 : 0;
+    last_time = now;
+    last_cpu = cpu;
+
+    evaluate(b, {buffered_bytes(), cpu_percent});
+  }
+}
+
+}  // namespace
+
+std::string to_string(level l) {
+  switch (l) {
+    case level::NORMAL:
+      return "normal";
+    case level::KEYFRAMES_ONLY:
+      return "keyframes_only";
+    case level::DROP_OLDEST:
+      return "drop_oldest";
+    case level::REFUSE_JOBS:
+      return "refuse_jobs";
+  }
+  ABORT() << "unknown level " << static_cast<int>(l);
+  return "";
+}
+
+void start(const budget &b) {
+  if (b.max_bytes == 0 && b.max_cpu_percent <= 0) {
+    return;
+  }
+  LOG(INFO) << "resource budget: " << b.max_bytes << " bytes, " << b.max_cpu_percent
+            << "% cpu";
+
+  governor_state &state = get_state();
+  std::lock_guard<std::mutex> guard(state.mutex);
+  CHECK(!state.thread.joinable()) << "resource governor is already started";
+  state.stop_requested = false;
+  state.thread = std::thread(run, b);
+}
+
+void stop() {
+  governor_state &state = get_state();
+  std::thread thread;
+  {
+    std::lock_guard<std::mutex> guard(state.mutex);
+    state.stop_requested = true;
+    thread = std::move(state.thread);
+  }
+  state.stop_condition.notify_all();
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+level evaluate(const budget &b, const usage &u) {
+  governor_state &state = get_state();
+
+  for (size_t i = 0; i < buffers_count; i++) {
+    buffered_bytes_family.Add({{"buffer", buffer_names[i]}})
+        .Set(impl::buffered_bytes[i].load(std::memory_order_relaxed));
+  }
+  cpu_percent_gauge.Set(u.cpu_percent);
+
+  const bool over = over_limit(u.bytes, b.max_bytes, 1)
+                    || over_limit(u.cpu_percent, b.max_cpu_percent, 1);
+  const bool calm = !over_limit(u.bytes, b.max_bytes, relax_ratio)
+                    && !over_limit(u.cpu_percent, b.max_cpu_percent, relax_ratio);
+
+  int l = impl::current_level.load();
+  if (over) {
+    state.calm_periods = 0;
+    if (l < static_cast<int>(level::REFUSE_JOBS)) {
+      l++;
+      escalations[l]->Increment();
+      LOG(WARNING) << "over resource budget, " << u.bytes << " bytes, " << u.cpu_percent
+                   << "% cpu, escalating to " << to_string(static_cast<level>(l));
+    }
+  } else if (calm && l > static_cast<int>(level::NORMAL)) {
+    state.calm_periods++;
+    if (state.calm_periods >= calm_periods_to_relax) {
+      state.calm_periods = 0;
+      l--;
+      LOG(INFO) << "resource usage is back below budget, relaxing to "
+                << to_string(static_cast<level>(l));
+    }
+  } else {
+    state.calm_periods = 0;
+  }
+
+  impl::current_level = l;
+  level_gauge.Set(l);
+  return static_cast<level>(l);
+}
+
+int64_t buffered_bytes() {
+  int64_t total = 0;
+  for (const auto &b : impl::buffered_bytes) {
+    total += b.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+void record_shed(level l, uint64_t frames) {
+  shed_frames[static_cast<int>(l)]->Increment(frames);
+}
+
+void record_refused_job() { refused_jobs.Increment(); }
+
+}  // namespace resource_governor
+}  // namespace video
+}  // namespace satori
@@ -0,0 +1,96 @@
+// Process-wide memory and CPU budget. Buffers report bytes they hold, and when
+// usage is over the budget the governor sheds load one level at a time.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace satori {
+namespace video {
+namespace resource_governor {
+
+// Every level includes the previous ones
+enum class level : int {
+  NORMAL = 0,
+  // decoders skip frames that are not key frames
+  KEYFRAMES_ONLY = 1,
+  // processing queues keep only the newest frame
+  DROP_OLDEST = 2,
+  // new pool jobs are not accepted
+  REFUSE_JOBS = 3,
+};
+
+std::string to_string(level l);
+
+// Buffers memory budget is checked against
+enum class buffer : int {
+  ASYNC_QUEUE = 0,
+  WORKER_QUEUE = 1,
+  NETWORK_FRAME_CHUNKS = 2,
+  RTM_SINK_BACKLOG = 3,
+  RTM_PENDING_REQUESTS = 4,
+  // decoded frames shared by several bots, counted once while any bot holds them
+  SHARED_FRAMES = 5,
+};
+
+constexpr size_t buffers_count = 6;
+
+struct budget {
+  // bytes held by all buffers, 0 means no limit
+  uint64_t max_bytes{0};
+  // process CPU time per second, 100 is a single core, 0 means no limit
+  double max_cpu_percent{0};
+};
+
+struct usage {
+  int64_t bytes;
+  double cpu_percent;
+};
+
+// Periods usage has to stay below 80% of the budget before the level goes down
+constexpr int calm_periods_to_relax = 5;
+
+// Starts a thread that checks usage every second, does nothing if budget has no limits
+void start(const budget &b);
+
+void stop();
+
+// Moves the level one step up if usage is over the budget, or one step down
+// after calm_periods_to_relax periods well below it. Returns the new level.
+level evaluate(const budget &b, const usage &u);
+
+// Sum of bytes reported by all buffers
+int64_t buffered_bytes();
+
+// Reports frames dropped by a component because of the level
+void record_shed(level l, uint64_t frames);
+
+// Reports a pool job that is not accepted because of the level
+void record_refused_job();
+
+namespace impl {
+extern std::atomic<int> current_level;
+extern std::atomic<int64_t> buffered_bytes[buffers_count];
+}  // namespace impl
+
+inline level current_level() {
+  return static_cast<level>(impl::current_level.load(std::memory_order_relaxed));
+}
+
+// Accounting hook, delta is negative when elements leave the buffer
+inline void add_bytes(buffer b, int64_t delta) {
+  impl::buffered_bytes[static_cast<int>(b)].fetch_add(delta, std::memory_order_relaxed);
+}
+
+// Approximate memory held by a buffered element,
+// specialized next to the types that own large payloads
+template <typename T>
+struct byte_size {
+  size_t operator()(const T & /*t*/) const { return sizeof(T); }
+};
+
+}  // namespace resource_governor
+}  // namespace video
+}  // namespace satori
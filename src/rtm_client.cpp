@@ -18,6 +18,7 @@
 #include "logging.h"
 #include "metrics.h"
 #include "threadutils.h"
+#include "tracing.h"
 
 namespace asio = boost::asio;
 
@@ -513,11 +514,11 @@ class secure_client : public client, public boost::static_visitor<> {
             ABORT() << "unreachable";
           }
         }
-        _sent_request_infos.erase(it);
+        erase_request(it);
       } else {
         if (request_info.type == request_type::PUBLISH) {
-          rtm_messages_sent.Add({{"channel", request_info.channel}}).Increment();
-          rtm_messages_bytes_sent.Add({{"channel", request_info.channel}})
+          _messages_sent.get(request_info.channel).Increment();
+          _messages_bytes_sent.get(request_info.channel)
               .Increment(request_info.buffer_size);
         }
         rtm_bytes_written.Increment(request_info.buffer_size);
@@ -551,6 +552,8 @@ class secure_client : public client, public boost::static_visitor<> {
                           std::chrono::system_clock::now(), buffer.size(), callbacks});
     CHECK(insert_result.second);
     const auto it = insert_result.first;
+    resource_governor::add_bytes(resource_governor::buffer::RTM_PENDING_REQUESTS,
+                                 it->second.buffer_size);
 
     write(std::move(buffer), handle_write(it));
   }
@@ -582,6 +585,8 @@ class secure_client : public client, public boost::static_visitor<> {
                           std::chrono::system_clock::now(), buffer.size(), callbacks});
     CHECK(insert_result.second);
     const auto it = insert_result.first;
+    resource_governor::add_bytes(resource_governor::buffer::RTM_PENDING_REQUESTS,
+                                 it->second.buffer_size);
 
     write(std::move(buffer), handle_write(it));
   }
@@ -609,6 +614,8 @@ class secure_client : public client, public boost::static_visitor<> {
                           std::chrono::system_clock::now(), buffer.size(), callbacks});
     CHECK(insert_result.second);
     const auto it = insert_result.first;
+    resource_governor::add_bytes(resource_governor::buffer::RTM_PENDING_REQUESTS,
+                                 it->second.buffer_size);
 
     write(std::move(buffer), handle_write(it));
   }
@@ -661,6 +668,7 @@ class secure_client : public client, public boost::static_visitor<> {
         return;
       }
 
+      tracing::scope read_scope("rtm_read");
       const std::string buffer = boost::beast::buffers_to_string(_read_buffer.data());
       CHECK_EQ(buffer.size(), _read_buffer.size());
       _read_buffer.consume(_read_buffer.size());
@@ -669,6 +677,7 @@ class secure_client : public client, public boost::static_visitor<> {
       nlohmann::json document;
 
       if (use_cbor) {
+        tracing::scope cbor_scope("cbor_decode");
         auto doc_or_error = cbor_to_json(buffer);
         if (!doc_or_error.ok()) {
           LOG(ERROR) << "CBOR message couldn't be processed: "
@@ -784,7 +793,7 @@ class secure_client : public client, public boost::static_visitor<> {
     CHECK(pdu.is_object()) << "not an object: " << pdu;
     CHECK(pdu.find("action") != pdu.end()) << "no action in pdu: " << pdu;
     const std::string action = pdu["action"];
-    rtm_actions_received.Add({{"action", action}}).Increment();
+    _actions_received.get(action).Increment();
 
     if (action == "rtm/subscription/data") {
       auto result = process_subscription_pdu(pdu);
@@ -795,9 +804,8 @@ class secure_client : public client, public boost::static_visitor<> {
       const auto &messages = body["messages"];
       CHECK(messages.is_array()) << "messages is not an array: " << pdu;
 
-      rtm_messages_received.Add({{"channel", sub_info.channel}}).Increment();
-      rtm_messages_bytes_received.Add({{"channel", sub_info.channel}})
-          .Increment(byte_size);
+      _messages_received.get(sub_info.channel).Increment();
+      _messages_bytes_received.get(sub_info.channel).Increment(byte_size);
       rtm_messages_in_pdu.Observe(messages.size());
 
       for (const auto &m : messages) {
@@ -815,7 +823,7 @@ class secure_client : public client, public boost::static_visitor<> {
       if (it->second.callbacks != nullptr) {
         it->second.callbacks->on_ok();
       }
-      _sent_request_infos.erase(it);
+      erase_request(it);
     } else if (action == "rtm/publish/error") {
       LOG(ERROR) << "got publish error: " << pdu;
       rtm_publish_error_total.Increment();
@@ -823,13 +831,13 @@ class secure_client : public client, public boost::static_visitor<> {
       if (it->second.callbacks != nullptr) {
         it->second.callbacks->on_error(make_error_condition(client_error::PUBLISH_ERROR));
       }
-      _sent_request_infos.erase(it);
+      erase_request(it);
     } else if (action == "rtm/subscribe/ok") {
       auto it = process_request_confirmation(pdu, arrival_time);
       if (it->second.callbacks != nullptr) {
         it->second.callbacks->on_ok();
       }
-      _sent_request_infos.erase(it);
+      erase_request(it);
     } else if (action == "rtm/subscribe/error") {
       LOG(ERROR) << "got subscribe error: " << pdu;
       rtm_subscribe_error_total.Increment();
@@ -838,7 +846,7 @@ class secure_client : public client, public boost::static_visitor<> {
         it->second.callbacks->on_error(
             make_error_condition(client_error::SUBSCRIBE_ERROR));
       }
-      _sent_request_infos.erase(it);
+      erase_request(it);
       CHECK(_channel_subscriptions.delete_by_channel(it->second.channel))
           << "failed to delete: " << pdu;
     } else if (action == "rtm/unsubscribe/ok") {
@@ -846,7 +854,7 @@ class secure_client : public client, public boost::static_visitor<> {
       if (it->second.callbacks != nullptr) {
         it->second.callbacks->on_ok();
       }
-      _sent_request_infos.erase(it);
+      erase_request(it);
       CHECK(_channel_subscriptions.delete_by_channel(it->second.channel))
           << "failed to delete: " << pdu;
     } else if (action == "rtm/unsubscribe/error") {
@@ -857,7 +865,7 @@ class secure_client : public client, public boost::static_visitor<> {
         it->second.callbacks->on_error(
             make_error_condition(client_error::UNSUBSCRIBE_ERROR));
       }
-      _sent_request_infos.erase(it);
+      erase_request(it);
       CHECK(_channel_subscriptions.delete_by_channel(it->second.channel))
           << "failed to delete: " << pdu;
     } else if (action == "/error") {
@@ -867,6 +875,13 @@ class secure_client : public client, public boost::static_visitor<> {
     }
   }
 
+  void erase_request(
+      std::unordered_map<uint64_t, sent_request_info>::const_iterator it) {
+    resource_governor::add_bytes(resource_governor::buffer::RTM_PENDING_REQUESTS,
+                                 -static_cast<int64_t>(it->second.buffer_size));
+    _sent_request_infos.erase(it);
+  }
+
   void write(std::string &&data, request_done_cb &&done_cb) {
     LOG(4) << "write " << data.size();
     _pending_requests.push(write_request{std::move(data), std::move(done_cb)});
@@ -947,6 +962,15 @@ class secure_client : public client, public boost::static_visitor<> {
   std::unordered_map<uint64_t, sent_request_info> _sent_request_infos;
   std::queue<io_request> _pending_requests;
   bool _request_in_flight{false};
+
+  // updated on io thread only
+  metric_cache<prometheus::Counter> _actions_received{rtm_actions_received, "action"};
+  metric_cache<prometheus::Counter> _messages_received{rtm_messages_received, "channel"};
+  metric_cache<prometheus::Counter> _messages_bytes_received{rtm_messages_bytes_received,
+                                                             "channel"};
+  metric_cache<prometheus::Counter> _messages_sent{rtm_messages_sent, "channel"};
+  metric_cache<prometheus::Counter> _messages_bytes_sent{rtm_messages_bytes_sent,
+                                                         "channel"};
 };
 
 }  // namespace
@@ -1118,5 +1142,22 @@ std::error_condition thread_checking_client::stop() {
 }
 
 }  // namespace rtm
+
+namespace resource_governor {
+
+size_t byte_size<rtm::channel_data>::operator()(const rtm::channel_data &data) const {
+  size_t result = sizeof(rtm::channel_data);
+  if (data.payload.is_object()) {
+    for (const auto &value : data.payload) {
+      if (value.is_string()) {
+        result += value.get_ref<const std::string &>().size();
+      }
+    }
+  }
+  return result;
+}
+
+}  // namespace resource_governor
+
 }  // namespace video
 }  // namespace satori
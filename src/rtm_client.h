@@ -14,6 +14,7 @@
 #include <vector>
 
 #include "logging.h"
+#include "resource_governor.h"
 
 namespace satori {
 
@@ -65,6 +66,20 @@ struct channel_data {
   std::chrono::system_clock::time_point arrival_time;
 };
 
+}  // namespace rtm
+
+namespace resource_governor {
+
+// Counts top-level strings only, like base64 data of network frames
+template <>
+struct byte_size<rtm::channel_data> {
+  size_t operator()(const rtm::channel_data &data) const;
+};
+
+}  // namespace resource_governor
+
+namespace rtm {
+
 struct subscription_callbacks : error_callbacks {
   virtual void on_data(const subscription & /*subscription*/,
                        channel_data && /*unused*/) {}
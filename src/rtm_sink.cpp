@@ -6,6 +6,7 @@
 
 #include "data.h"
 #include "metrics.h"
+#include "resource_governor.h"
 #include "satori_video.h"
 #include "streams/streams.h"
 
@@ -38,9 +39,12 @@ class rtm_sink_impl : public streams::subscriber<encoded_packet>,
 
   void operator()(const encoded_metadata &m) {
     nlohmann::json packet = m.to_network().to_json();
+    const int64_t bytes = m.codec_data.size();
 
     _in_flight++;
-    _io_service.post([ this, packet = std::move(packet) ]() mutable {
+    resource_governor::add_bytes(resource_governor::buffer::RTM_SINK_BACKLOG, bytes);
+    _io_service.post([ this, packet = std::move(packet), bytes ]() mutable {
+      resource_governor::add_bytes(resource_governor::buffer::RTM_SINK_BACKLOG, -bytes);
       _client->publish(_metadata_channel, std::move(packet), this);
     });
   }
@@ -50,11 +54,14 @@ class rtm_sink_impl : public streams::subscriber<encoded_packet>,
 
     for (const network_frame &nf : network_frames) {
       nlohmann::json packet = nf.to_json();
+      const int64_t bytes = nf.base64_data.size();
 
       _in_flight++;
+      resource_governor::add_bytes(resource_governor::buffer::RTM_SINK_BACKLOG, bytes);
       _io_service.post([
-        this, packet = std::move(packet), creation_time = f.creation_time
+        this, packet = std::move(packet), creation_time = f.creation_time, bytes
       ]() mutable {
+        resource_governor::add_bytes(resource_governor::buffer::RTM_SINK_BACKLOG, -bytes);
         frame_publish_delay_milliseconds.Observe(
             std::chrono::duration_cast<std::chrono::milliseconds>(
                 std::chrono::system_clock::now() - creation_time)
@@ -0,0 +1,515 @@
+#include "shm_frames.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <new>
+
+#include "logging.h"
+
+namespace satori {
+namespace video {
+namespace shm_frames {
+
+namespace {
+
+constexpr uint32_t ring_magic = 0x53564652;
+constexpr uint32_t ring_version = 1;
+constexpr size_t alignment = 64;
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "atomics in shared memory have to be lock free");
+
+struct planes_header {
+  uint16_t width;
+  uint16_t height;
+  uint32_t strides[max_image_planes];
+  uint32_t sizes[max_image_planes];
+};
+
+struct frame_header {
+  int64_t id_i1;
+  int64_t id_i2;
+  int32_t pixel_format;
+  int64_t timestamp;
+  int64_t arrival_time;
+  int64_t reassembly_time;
+  int64_t decode_time;
+  int64_t conversion_time;
+  planes_header image;
+  uint32_t levels_count;
+  planes_header levels[max_image_levels];
+};
+
+// Slot content is valid when begin and end hold the same frame number:
+// writer sets begin before it copies a frame and end after that
+struct slot_header {
+  std::atomic<uint64_t> begin;
+  std::atomic<uint64_t> end;
+  frame_header frame;
+};
+
+struct reader_cursor {
+  // 0 if the cursor is free
+  std::atomic<int32_t> pid;
+  // number of the last frame the reader got
+  std::atomic<uint64_t> read;
+};
+
+struct ring_header {
+  // set last, so that readers don't see a half initialized ring
+  std::atomic<uint32_t> magic;
+  uint32_t version;
+  uint32_t slots_count;
+  uint64_t slot_data_size;
+  uint64_t slot_stride;
+  std::atomic<uint32_t> closed;
+  // frames are numbered from 1
+  std::atomic<uint64_t> written;
+  // guards nothing but the wait of readers for the next frame
+  pthread_mutex_t mutex;
+  pthread_cond_t written_condition;
+  reader_cursor readers[max_readers];
+};
+
+size_t align(size_t size) { return (size + alignment - 1) / alignment * alignment; }
+
+int64_t to_nanos(std::chrono::system_clock::time_point t) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch())
+      .count();
+}
+
+std::chrono::system_clock::time_point from_nanos(int64_t nanos) {
+  return std::chrono::system_clock::time_point{
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(
+          std::chrono::nanoseconds{nanos})};
+}
+
+#if defined(__linux__)
+constexpr clockid_t wait_clock = CLOCK_MONOTONIC;
+#else
+constexpr clockid_t wait_clock = CLOCK_REALTIME;
+#endif
+
+size_t planes_bytes(const std::string (&plane_data)[max_image_planes]) {
+  size_t result = 0;
+  for (const auto &p : plane_data) {
+    result += p.size();
+  }
+  return result;
+}
+
+size_t frame_bytes(const owned_image_frame &frame) {
+  size_t result = planes_bytes(frame.plane_data);
+  if (frame.levels) {
+    for (const auto &l : *frame.levels) {
+      result += planes_bytes(l.plane_data);
+    }
+  }
+  return result;
+}
+
+uint8_t *write_planes(const std::string (&plane_data)[max_image_planes],
+                      const uint32_t (&plane_strides)[max_image_planes], uint16_t width,
+                      uint16_t height, planes_header &header, uint8_t *out) {
+  header.width = width;
+  header.height = height;
+  for (size_t i = 0; i < max_image_planes; i++) {
+    header.strides[i] = plane_strides[i];
+    header.sizes[i] = static_cast<uint32_t>(plane_data[i].size());
+    memcpy(out, plane_data[i].data(), plane_data[i].size());
+    out += plane_data[i].size();
+  }
+  return out;
+}
+
+// Returns nullptr if sizes in the header run out of the slot, i.e. the slot is being
+// overwritten
+const uint8_t *read_planes(const planes_header &header, const uint8_t *in,
+                           const uint8_t *end, std::string (&plane_data)[max_image_planes],
+                           uint32_t (&plane_strides)[max_image_planes]) {
+  for (size_t i = 0; i < max_image_planes; i++) {
+    if (header.sizes[i] > static_cast<size_t>(end - in)) {
+      return nullptr;
+    }
+    plane_strides[i] = header.strides[i];
+    plane_data[i].assign(reinterpret_cast<const char *>(in), header.sizes[i]);
+    in += header.sizes[i];
+  }
+  return in;
+}
+
+void lock(ring_header &h) {
+  const int err = pthread_mutex_lock(&h.mutex);
+#if defined(__linux__)
+  if (err == EOWNERDEAD) {
+    // a process died while waiting, the mutex protects no data
+    pthread_mutex_consistent(&h.mutex);
+    return;
+  }
+#endif
+  CHECK_EQ(0, err) << "can't lock ring mutex: " << strerror(err);
+}
+
+void unlock(ring_header &h) { pthread_mutex_unlock(&h.mutex); }
+
+void notify_readers(ring_header &h) {
+  lock(h);
+  pthread_cond_broadcast(&h.written_condition);
+  unlock(h);
+}
+
+void init_sync(ring_header &h) {
+  pthread_mutexattr_t mutex_attr;
+  pthread_mutexattr_init(&mutex_attr);
+  pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+#if defined(__linux__)
+  pthread_mutexattr_setrobust(&mutex_attr, PTHREAD_MUTEX_ROBUST);
+#endif
+  pthread_mutex_init(&h.mutex, &mutex_attr);
+  pthread_mutexattr_destroy(&mutex_attr);
+
+  pthread_condattr_t cond_attr;
+  pthread_condattr_init(&cond_attr);
+  pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+#if defined(__linux__)
+  pthread_condattr_setclock(&cond_attr, wait_clock);
+#endif
+  pthread_cond_init(&h.written_condition, &cond_attr);
+  pthread_condattr_destroy(&cond_attr);
+}
+
+bool process_is_gone(int32_t pid) { return kill(pid, 0) != 0 && errno == ESRCH; }
+
+}  // namespace
+
+struct segment {
+  segment(void *data, size_t size, ino_t inode) : data{data}, size{size}, inode{inode} {}
+  ~segment() { munmap(data, size); }
+
+  ring_header &header() const { return *static_cast<ring_header *>(data); }
+
+  slot_header &slot(uint64_t frame_number) const {
+    const ring_header &h = header();
+    uint8_t *slots = static_cast<uint8_t *>(data) + align(sizeof(ring_header));
+    return *reinterpret_cast<slot_header *>(slots
+                                            + (frame_number % h.slots_count) * h.slot_stride);
+  }
+
+  uint8_t *slot_data(uint64_t frame_number) const {
+    return reinterpret_cast<uint8_t *>(&slot(frame_number)) + align(sizeof(slot_header));
+  }
+
+  void *const data;
+  const size_t size;
+  // tells apart a ring that was replaced by a new writer under the same name
+  const ino_t inode;
+};
+
+std::string object_name(const std::string &name) {
+  return !name.empty() && name[0] == '/' ? name : "/" + name;
+}
+
+writer::writer(const std::string &name, size_t slots_count)
+    : _name{object_name(name)}, _slots_count{slots_count} {
+  CHECK_GE(slots_count, 2) << "ring should have at least two slots";
+}
+
+writer::~writer() {
+  if (!_segment) {
+    return;
+  }
+  ring_header &h = _segment->header();
+  h.closed = 1;
+  notify_readers(h);
+  shm_unlink(_name.c_str());
+  LOG(INFO) << "removed frames ring " << _name;
+}
+
+bool writer::write(const owned_image_frame &frame) {
+  const size_t bytes = frame_bytes(frame);
+  const size_t levels_count = frame.levels ? frame.levels->size() : 0;
+  CHECK_LE(levels_count, max_image_levels);
+
+  if (!_segment) {
+    const size_t slot_stride = align(sizeof(slot_header)) + align(bytes);
+    const size_t size = align(sizeof(ring_header)) + _slots_count * slot_stride;
+
+    // a ring of a previous writer may be left after a crash
+    shm_unlink(_name.c_str());
+    const int fd = shm_open(_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (fd < 0) {
+      LOG(ERROR) << "can't create frames ring " << _name << ": " << strerror(errno);
+      return false;
+    }
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (ftruncate(fd, size) == 0 && fstat(fd, &st) == 0) {
+      data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    const int err = errno;
+    close(fd);
+    if (data == MAP_FAILED) {
+      LOG(ERROR) << "can't map frames ring " << _name << ": " << strerror(err);
+      shm_unlink(_name.c_str());
+      return false;
+    }
+
+    _segment = std::make_unique<segment>(data, size, st.st_ino);
+    ring_header &h = *new (data) ring_header;
+    h.version = ring_version;
+    h.slots_count = static_cast<uint32_t>(_slots_count);
+    h.slot_data_size = bytes;
+    h.slot_stride = slot_stride;
+    h.closed = 0;
+    h.written = 0;
+    init_sync(h);
+    for (auto &r : h.readers) {
+      r.pid = 0;
+      r.read = 0;
+    }
+    for (size_t i = 0; i < _slots_count; i++) {
+      slot_header &s = *new (&_segment->slot(i)) slot_header;
+      s.begin = 0;
+      s.end = 0;
+    }
+    h.magic.store(ring_magic, std::memory_order_release);
+
+    LOG(INFO) << "created frames ring " << _name << ", " << _slots_count << " slots of "
+              << bytes << " bytes";
+  }
+
+  ring_header &h = _segment->header();
+  if (bytes > h.slot_data_size) {
+    return false;
+  }
+
+  const uint64_t n = h.written.load(std::memory_order_relaxed) + 1;
+  slot_header &s = _segment->slot(n);
+  s.begin.store(n, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  frame_header &f = s.frame;
+  f.id_i1 = frame.id.i1;
+  f.id_i2 = frame.id.i2;
+  f.pixel_format = static_cast<int32_t>(frame.pixel_format);
+  f.timestamp = to_nanos(frame.timestamp);
+  f.arrival_time = to_nanos(frame.arrival_time);
+  f.reassembly_time = to_nanos(frame.reassembly_time);
+  f.decode_time = to_nanos(frame.decode_time);
+  f.conversion_time = to_nanos(frame.conversion_time);
+  f.levels_count = static_cast<uint32_t>(levels_count);
+
+  uint8_t *out = _segment->slot_data(n);
+  out = write_planes(frame.plane_data, frame.plane_strides, frame.width, frame.height,
+                     f.image, out);
+  for (size_t i = 0; i < levels_count; i++) {
+    const owned_image_level &l = (*frame.levels)[i];
+    out = write_planes(l.plane_data, l.plane_strides, l.width, l.height, f.levels[i], out);
+  }
+
+  s.end.store(n, std::memory_order_release);
+  h.written.store(n, std::memory_order_release);
+  notify_readers(h);
+  return true;
+}
+
+size_t writer::readers_count() const {
+  if (!_segment) {
+    return 0;
+  }
+  size_t result = 0;
+  for (const auto &r : _segment->header().readers) {
+    if (r.pid != 0) {
+      result++;
+    }
+  }
+  return result;
+}
+
+uint64_t writer::max_reader_lag() const {
+  if (!_segment) {
+    return 0;
+  }
+  const ring_header &h = _segment->header();
+  const uint64_t written = h.written;
+  uint64_t result = 0;
+  for (const auto &r : h.readers) {
+    if (r.pid != 0) {
+      const uint64_t read = r.read;
+      result = std::max(result, written > read ? written - read : 0);
+    }
+  }
+  return result;
+}
+
+std::unique_ptr<reader> reader::open(const std::string &name) {
+  const std::string object = object_name(name);
+  const int fd = shm_open(object.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    if (errno != ENOENT) {
+      LOG(ERROR) << "can't open frames ring " << object << ": " << strerror(errno);
+    }
+    return nullptr;
+  }
+
+  struct stat st;
+  void *data = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(ring_header)) {
+    data = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (data == MAP_FAILED) {
+    // the writer is creating the ring
+    return nullptr;
+  }
+
+  auto s = std::make_unique<segment>(data, st.st_size, st.st_ino);
+  ring_header &h = s->header();
+  if (h.magic.load(std::memory_order_acquire) != ring_magic) {
+    return nullptr;
+  }
+  if (h.version != ring_version) {
+    LOG(ERROR) << "frames ring " << object << " has version " << h.version
+               << ", expected " << ring_version;
+    return nullptr;
+  }
+
+  const int32_t pid = getpid();
+  for (int pass = 0; pass < 2; pass++) {
+    for (size_t i = 0; i < max_readers; i++) {
+      reader_cursor &c = h.readers[i];
+      int32_t expected = c.pid;
+      // cursors of crashed readers are taken over only when there are no free ones,
+      // a process of another pid namespace may look gone
+      if (expected != 0 && (pass == 0 || !process_is_gone(expected))) {
+        continue;
+      }
+      if (c.pid.compare_exchange_strong(expected, pid)) {
+        c.read = h.written.load();
+        LOG(INFO) << "attached to frames ring " << object << ", cursor " << i;
+        return std::unique_ptr<reader>(new reader(object, std::move(s), i));
+      }
+    }
+  }
+
+  LOG(ERROR) << "frames ring " << object << " has no free reader cursors";
+  return nullptr;
+}
+
+reader::reader(std::string name, std::unique_ptr<segment> s, size_t cursor_index)
+    : _name{std::move(name)},
+      _segment{std::move(s)},
+      _cursor_index{cursor_index},
+      _next{_segment->header().readers[cursor_index].read + 1} {}
+
+reader::~reader() { _segment->header().readers[_cursor_index].pid = 0; }
+
+// A crashed writer doesn't close the ring, the restarted one creates a new ring
+// under the same name
+bool reader::is_replaced() const {
+  const int fd = shm_open(_name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return true;
+  }
+  struct stat st;
+  const bool same = fstat(fd, &st) == 0 && st.st_ino == _segment->inode;
+  close(fd);
+  return !same;
+}
+
+read_status reader::read(owned_image_frame &frame, std::chrono::milliseconds timeout) {
+  ring_header &h = _segment->header();
+  reader_cursor &cursor = h.readers[_cursor_index];
+
+  while (true) {
+    const uint64_t written = h.written.load(std::memory_order_acquire);
+    if (_next <= written) {
+      // the writer may be overwriting the slot after the newest frame
+      const uint64_t oldest = written + 2 > h.slots_count ? written + 2 - h.slots_count : 1;
+      if (_next < oldest) {
+        _dropped += oldest - _next;
+        _next = oldest;
+      }
+
+      const slot_header &s = _segment->slot(_next);
+      if (s.end.load(std::memory_order_acquire) == _next) {
+        const frame_header f = s.frame;
+        const uint8_t *in = _segment->slot_data(_next);
+        const uint8_t *end = in + h.slot_data_size;
+
+        frame.id = {f.id_i1, f.id_i2};
+        frame.pixel_format = static_cast<image_pixel_format>(f.pixel_format);
+        frame.width = f.image.width;
+        frame.height = f.image.height;
+        frame.timestamp = from_nanos(f.timestamp);
+        frame.arrival_time = from_nanos(f.arrival_time);
+        frame.reassembly_time = from_nanos(f.reassembly_time);
+        frame.decode_time = from_nanos(f.decode_time);
+        frame.conversion_time = from_nanos(f.conversion_time);
+        in = read_planes(f.image, in, end, frame.plane_data, frame.plane_strides);
+
+        std::shared_ptr<std::vector<owned_image_level>> levels;
+        if (f.levels_count > 0 && f.levels_count <= max_image_levels) {
+          levels = std::make_shared<std::vector<owned_image_level>>(f.levels_count);
+          for (size_t i = 0; i < f.levels_count && in != nullptr; i++) {
+            owned_image_level &l = (*levels)[i];
+            l.width = f.levels[i].width;
+            l.height = f.levels[i].height;
+            in = read_planes(f.levels[i], in, end, l.plane_data, l.plane_strides);
+          }
+        }
+        frame.levels = levels;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (in != nullptr && s.begin.load(std::memory_order_relaxed) == _next) {
+          cursor.read = _next;
+          _next++;
+          return read_status::FRAME;
+        }
+      }
+      // overwritten while copied, oldest frame is recalculated
+      continue;
+    }
+
+    if (h.closed != 0) {
+      return read_status::CLOSED;
+    }
+
+    struct timespec deadline;
+    clock_gettime(wait_clock, &deadline);
+    const auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count()
+                       + deadline.tv_nsec;
+    deadline.tv_sec += nanos / 1000000000;
+    deadline.tv_nsec = nanos % 1000000000;
+
+    bool timed_out = false;
+    lock(h);
+    while (h.written.load() < _next && h.closed == 0 && !timed_out) {
+      const int err = pthread_cond_timedwait(&h.written_condition, &h.mutex, &deadline);
+#if defined(__linux__)
+      if (err == EOWNERDEAD) {
+        pthread_mutex_consistent(&h.mutex);
+      }
+#endif
+      timed_out = err == ETIMEDOUT;
+    }
+    unlock(h);
+
+    if (timed_out) {
+      return is_replaced() ? read_status::CLOSED : read_status::TIMEOUT;
+    }
+  }
+}
+
+}  // namespace shm_frames
+}  // namespace video
+}  // namespace satori
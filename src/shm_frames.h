@@ -0,0 +1,90 @@
+// Ring of decoded frames in POSIX shared memory. A decoder host process
+// decodes a stream once and writes frames to the ring, bot processes on the
+// same node read them instead of decoding the stream again. Writer never waits
+// for readers, a reader that falls behind skips to the oldest frame in the ring.
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "data.h"
+
+namespace satori {
+namespace video {
+namespace shm_frames {
+
+// Readers attached to the same ring at the same time
+constexpr size_t max_readers = 16;
+
+struct segment;
+
+// Creates the ring on the first frame, slot size is taken from that frame,
+// so the stream should have a fixed resolution. A ring left with the same name
+// by a previous writer is replaced. The ring is removed when the writer is destroyed.
+class writer {
+ public:
+  writer(const std::string &name, size_t slots_count);
+  ~writer();
+
+  writer(const writer &) = delete;
+  writer &operator=(const writer &) = delete;
+
+  // Returns false if the frame is bigger than a slot or the ring can't be created
+  bool write(const owned_image_frame &frame);
+
+  // Attached readers
+  size_t readers_count() const;
+
+  // Frames written but not read yet by the slowest reader
+  uint64_t max_reader_lag() const;
+
+ private:
+  const std::string _name;
+  const size_t _slots_count;
+  std::unique_ptr<segment> _segment;
+};
+
+enum class read_status {
+  FRAME,
+  TIMEOUT,
+  // writer is destroyed or its process is gone, the ring should be opened again
+  CLOSED,
+};
+
+class reader {
+ public:
+  // Returns nullptr if the ring doesn't exist yet or all reader cursors are taken
+  static std::unique_ptr<reader> open(const std::string &name);
+
+  ~reader();
+
+  reader(const reader &) = delete;
+  reader &operator=(const reader &) = delete;
+
+  // Waits for the next frame up to timeout
+  read_status read(owned_image_frame &frame, std::chrono::milliseconds timeout);
+
+  // Frames overwritten before this reader got to them
+  uint64_t dropped() const { return _dropped; }
+
+ private:
+  reader(std::string name, std::unique_ptr<segment> s, size_t cursor_index);
+
+  bool is_replaced() const;
+
+  const std::string _name;
+  std::unique_ptr<segment> _segment;
+  const size_t _cursor_index;
+  uint64_t _next;
+  uint64_t _dropped{0};
+};
+
+// POSIX shared memory object name, a leading slash is added if missing
+std::string object_name(const std::string &name);
+
+}  // namespace shm_frames
+}  // namespace video
+}  // namespace satori
@@ -0,0 +1,85 @@
+#include "video_streams.h"
+
+#include "metrics.h"
+#include "shm_frames.h"
+
+namespace satori {
+namespace video {
+
+namespace {
+
+auto &frames_total = prometheus::BuildCounter()
+                         .Name("shm_sink_frames_total")
+                         .Register(metrics_registry());
+
+auto &oversized_frames_total = prometheus::BuildCounter()
+                                   .Name("shm_sink_oversized_frames_total")
+                                   .Register(metrics_registry());
+
+auto &readers = prometheus::BuildGauge().Name("shm_sink_readers").Register(metrics_registry());
+
+auto &max_reader_lag_frames = prometheus::BuildGauge()
+                                  .Name("shm_sink_max_reader_lag_frames")
+                                  .Register(metrics_registry());
+
+class shm_sink_impl : public streams::subscriber<owned_image_packet>,
+                      boost::static_visitor<void> {
+ public:
+  shm_sink_impl(const std::string &name, size_t slots_count)
+      : _writer{name, slots_count},
+        _name{name},
+        _frames_total{frames_total.Add({{"name", name}})},
+        _oversized_frames_total{oversized_frames_total.Add({{"name", name}})},
+        _readers{readers.Add({{"name", name}})},
+        _max_reader_lag_frames{max_reader_lag_frames.Add({{"name", name}})} {}
+
+  void operator()(const owned_image_metadata & /*metadata*/) {}
+
+  void operator()(const owned_image_frame &f) {
+    if (!_writer.write(f)) {
+      LOG(ERROR) << "frame " << f.width << "x" << f.height
+                 << " doesn't fit into a slot of frames ring " << _name;
+      _oversized_frames_total.Increment();
+      return;
+    }
+    _frames_total.Increment();
+    _readers.Set(_writer.readers_count());
+    _max_reader_lag_frames.Set(_writer.max_reader_lag());
+  }
+
+ private:
+  void on_next(owned_image_packet &&packet) override {
+    boost::apply_visitor(*this, packet);
+    _src->request(1);
+  }
+
+  void on_error(std::error_condition ec) override { ABORT() << ec.message(); }
+
+  void on_complete() override {
+    LOG(INFO) << "frames ring " << _name << " is complete";
+    delete this;
+  }
+
+  void on_subscribe(streams::subscription &s) override {
+    _src = &s;
+    _src->request(1);
+  }
+
+  shm_frames::writer _writer;
+  const std::string _name;
+  prometheus::Counter &_frames_total;
+  prometheus::Counter &_oversized_frames_total;
+  prometheus::Gauge &_readers;
+  prometheus::Gauge &_max_reader_lag_frames;
+  streams::subscription *_src;
+};
+
+}  // namespace
+
+streams::subscriber<owned_image_packet> &shm_sink(const std::string &name,
+                                                  size_t slots_count) {
+  return *(new shm_sink_impl(name, slots_count));
+}
+
+}  // namespace video
+}  // namespace satori
@@ -0,0 +1,141 @@
+#include "video_streams.h"
+
+#include <gsl/gsl>
+#include <thread>
+
+#include "metrics.h"
+#include "shm_frames.h"
+#include "threadutils.h"
+
+namespace satori {
+namespace video {
+
+namespace {
+
+constexpr std::chrono::milliseconds read_timeout{100};
+
+auto &frames_total = prometheus::BuildCounter()
+                         .Name("shm_source_frames_total")
+                         .Register(metrics_registry());
+
+auto &dropped_total = prometheus::BuildCounter()
+                          .Name("shm_source_dropped_frames_total")
+                          .Register(metrics_registry());
+
+auto &attached_total = prometheus::BuildCounter()
+                           .Name("shm_source_attached_total")
+                           .Register(metrics_registry());
+
+class shm_source_impl {
+ public:
+  shm_source_impl(const std::string &name, image_pixel_format pixel_format,
+                  uint8_t pyramid_levels, streams::observer<owned_image_packet> &sink)
+      : _name{name},
+        _pixel_format{pixel_format},
+        _pyramid_levels{pyramid_levels},
+        _sink{sink},
+        _frames_total{frames_total.Add({{"name", name}})},
+        _dropped_total{dropped_total.Add({{"name", name}})},
+        _attached_total{attached_total.Add({{"name", name}})} {
+    std::thread([this]() {
+      threadutils::set_current_thread_name("shm " + _name);
+
+      auto self_destroyer = gsl::finally([this]() {
+        LOG(INFO) << "delete self: " << _name;
+        delete this;
+      });
+
+      read_loop();
+    })
+        .detach();
+  }
+
+  void stop() {
+    LOG(INFO) << "stopping shm source " << _name;
+    _active = false;
+  }
+
+ private:
+  void read_loop() {
+    bool waiting_logged = false;
+    while (_active) {
+      if (!_reader) {
+        _reader = shm_frames::reader::open(_name);
+        if (!_reader) {
+          if (!waiting_logged) {
+            LOG(INFO) << "waiting for frames ring " << _name;
+            waiting_logged = true;
+          }
+          std::this_thread::sleep_for(read_timeout);
+          continue;
+        }
+        waiting_logged = false;
+        _reported_dropped = 0;
+        _attached_total.Increment();
+      }
+
+      owned_image_frame frame;
+      const shm_frames::read_status status = _reader->read(frame, read_timeout);
+      if (status == shm_frames::read_status::CLOSED) {
+        LOG(INFO) << "frames ring " << _name << " is closed";
+        _reader.reset();
+        continue;
+      }
+
+      _dropped_total.Increment(_reader->dropped() - _reported_dropped);
+      _reported_dropped = _reader->dropped();
+      if (status != shm_frames::read_status::FRAME || !_active) {
+        continue;
+      }
+
+      if (frame.pixel_format != _pixel_format) {
+        ABORT() << "frames ring " << _name << " has pixel format "
+                << static_cast<int>(frame.pixel_format) << ", bot expects "
+                << static_cast<int>(_pixel_format);
+      }
+      const size_t levels_count = frame.levels ? frame.levels->size() : 0;
+      if (levels_count < _pyramid_levels) {
+        ABORT() << "frames ring " << _name << " has " << levels_count
+                << " pyramid levels, bot expects " << static_cast<int>(_pyramid_levels);
+      }
+      if (levels_count > _pyramid_levels) {
+        frame.levels = _pyramid_levels == 0
+                           ? nullptr
+                           : std::make_shared<std::vector<owned_image_level>>(
+                                 frame.levels->begin(),
+                                 frame.levels->begin() + _pyramid_levels);
+      }
+
+      _frames_total.Increment();
+      _sink.on_next(std::move(frame));
+    }
+  }
+
+  const std::string _name;
+  const image_pixel_format _pixel_format;
+  const uint8_t _pyramid_levels;
+  streams::observer<owned_image_packet> &_sink;
+  prometheus::Counter &_frames_total;
+  prometheus::Counter &_dropped_total;
+  prometheus::Counter &_attached_total;
+  std::unique_ptr<shm_frames::reader> _reader;
+  uint64_t _reported_dropped{0};
+  std::atomic<bool> _active{true};
+};
+
+}  // namespace
+
+streams::publisher<owned_image_packet> shm_source(const std::string &name,
+                                                  image_pixel_format pixel_format,
+                                                  uint8_t pyramid_levels) {
+  return streams::generators<owned_image_packet>::async<shm_source_impl>(
+             [name, pixel_format, pyramid_levels](
+                 streams::observer<owned_image_packet> &sink) {
+               return new shm_source_impl(name, pixel_format, pyramid_levels, sink);
+             },
+             [](shm_source_impl *impl) { impl->stop(); })
+         >> streams::flatten();
+}
+
+}  // namespace video
+}  // namespace satori
@@ -1,11 +1,15 @@
 #include "signal_utils.h"
 
+#include <boost/asio.hpp>
 #include <csignal>
 #include <cstring>
 #include <map>
+#include <memory>
+#include <thread>
 #include <vector>
 
 #include "logging.h"
+#include "threadutils.h"
 
 namespace satori {
 namespace video {
@@ -28,8 +32,46 @@ void on_signal(int signal) {
   }
 }
 
+// Never destroyed, the thread runs until the process exits
+boost::asio::io_service &handlers_io_service() {
+  static boost::asio::io_service *io_service = []() {
+    auto io = new boost::asio::io_service();
+    std::thread([io]() {
+      threadutils::set_current_thread_name("signal_handlers");
+      boost::asio::io_service::work work{*io};
+      io->run();
+    }).detach();
+    return io;
+  }();
+  return *io_service;
+}
+
+void wait_signal(const std::shared_ptr<boost::asio::signal_set> &signals,
+                 const signal_handler_fn &signal_handler) {
+  signals->async_wait([signals, signal_handler](const boost::system::error_code &ec,
+                                                int signal) {
+    if (ec) {
+      LOG(ERROR) << "error waiting for signals: " << ec.message();
+      return;
+    }
+    LOG(INFO) << "caught signal " << strsignal(signal);
+    signal_handler(signal);
+    wait_signal(signals, signal_handler);
+  });
+}
+
 }  // namespace
 
+void register_thread_handler(std::initializer_list<int> signals,
+                             signal_handler_fn const &signal_handler) {
+  // signals are installed right away, so they don't kill the process meanwhile
+  auto signal_set = std::make_shared<boost::asio::signal_set>(handlers_io_service());
+  for (int s : signals) {
+    signal_set->add(s);
+  }
+  wait_signal(signal_set, signal_handler);
+}
+
 void register_handler(std::initializer_list<int> signals,
                       signal_handler_fn const &signal_handler) {
   for (int s : signals) {
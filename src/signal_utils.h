@@ -12,6 +12,11 @@ using signal_handler_fn = std::function<void(int signal)>;
 void register_handler(std::initializer_list<int> signals,
                       signal_handler_fn const &signal_handler);
 
+// Unlike register_handler, the handler runs on a dedicated thread instead of the
+// signal handler, so it may lock mutexes, allocate memory, open files and start threads.
+void register_thread_handler(std::initializer_list<int> signals,
+                             signal_handler_fn const &signal_handler);
+
 }  // namespace signal
 }  // namespace video
 }  // namespace satori
\ No newline at end of file
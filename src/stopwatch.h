@@ -1,23 +1,33 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 
 namespace satori {
 namespace video {
 
-template <class Clock = std::chrono::system_clock>
+// Measures elapsed time. steady_clock is not affected by system clock
+// adjustments, like NTP steps, so it is the default.
+template <class Clock = std::chrono::steady_clock>
 class stopwatch {
  public:
   stopwatch() : _start(Clock::now()) {}
 
-  uint64_t millis() {
-    auto d = Clock::now() - _start;
-    return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
-  }
+  uint64_t nanos() const { return elapsed<std::chrono::nanoseconds>(); }
+
+  uint64_t micros() const { return elapsed<std::chrono::microseconds>(); }
+
+  // Rounded down, use micros() for sub-millisecond operations
+  uint64_t millis() const { return elapsed<std::chrono::milliseconds>(); }
 
  private:
+  template <typename Duration>
+  uint64_t elapsed() const {
+    return std::chrono::duration_cast<Duration>(Clock::now() - _start).count();
+  }
+
   typename Clock::time_point _start;
 };
 
 }  // namespace video
-}  // namespace satori
\ No newline at end of file
+}  // namespace satori
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "streams.h"
+
+namespace satori {
+namespace video {
+namespace streams {
+
+namespace impl {
+
+// Shared state of broadcast branches, keeps itself alive from the first branch
+// subscription until the source terminates or all branches cancel.
+// Recursive mutex lets synchronous branches request and cancel from on_next.
+template <typename T>
+class broadcast_source : public std::enable_shared_from_this<broadcast_source<T>>,
+                         subscriber<T> {
+ public:
+  broadcast_source(publisher<T> &&src, size_t count)
+      : _src(std::move(src)), _branches(count) {
+    for (branch &b : _branches) {
+      b.parent = this;
+    }
+  }
+
+  void subscribe(size_t index, subscriber<T> &sink) {
+    std::lock_guard<std::recursive_mutex> guard(_mutex);
+    branch &b = _branches[index];
+    CHECK(b.sink == nullptr && !_done) << "broadcast branch " << index
+                                       << " is subscribed twice";
+    if (!_self) {
+      _self = this->shared_from_this();
+    }
+    b.sink = &sink;
+    _active++;
+    _subscribed++;
+    sink.on_subscribe(b);
+
+    if (_subscribed == _branches.size() && !_done) {
+      LOG(5) << this << " broadcast subscribing to source";
+      _src->subscribe(*this);
+    }
+  }
+
+ private:
+  struct branch : subscription {
+    void request(int n) override { parent->request(*this, n); }
+    void cancel() override { parent->cancel(*this); }
+
+    broadcast_source *parent{nullptr};
+    subscriber<T> *sink{nullptr};
+    // total number of elements requested by the sink
+    int64_t requested{0};
+  };
+
+  void request(branch &b, int n) {
+    std::lock_guard<std::recursive_mutex> guard(_mutex);
+    if (_done || b.sink == nullptr) {
+      return;
+    }
+    b.requested += n;
+    request_source();
+  }
+
+  void cancel(branch &b) {
+    std::shared_ptr<broadcast_source> self;
+    subscription *source_sub = nullptr;
+    {
+      std::lock_guard<std::recursive_mutex> guard(_mutex);
+      if (_done || b.sink == nullptr) {
+        return;
+      }
+      b.sink = nullptr;
+      _active--;
+      if (_active > 0) {
+        // the cancelled branch may have been the slowest one
+        request_source();
+        return;
+      }
+      LOG(5) << this << " broadcast cancelling source";
+      self = std::move(_self);
+      source_sub = _source_sub;
+      _source_sub = nullptr;
+      _done = true;
+    }
+    if (source_sub != nullptr) {
+      source_sub->cancel();
+    }
+  }
+
+  // source is asked for as many elements as the slowest branch requested
+  void request_source() {
+    if (_source_sub == nullptr || _active == 0) {
+      return;
+    }
+    int64_t target = std::numeric_limits<int64_t>::max();
+    for (const branch &b : _branches) {
+      if (b.sink != nullptr) {
+        target = std::min(target, b.requested);
+      }
+    }
+    while (target > _source_requested) {
+      const int n = static_cast<int>(std::min<int64_t>(target - _source_requested, INT_MAX));
+      _source_requested += n;
+      _source_sub->request(n);
+    }
+  }
+
+  void on_subscribe(subscription &s) override {
+    std::lock_guard<std::recursive_mutex> guard(_mutex);
+    _source_sub = &s;
+    request_source();
+  }
+
+  void on_next(T &&t) override {
+    std::lock_guard<std::recursive_mutex> guard(_mutex);
+    const std::shared_ptr<broadcast_source> self = _self;
+    for (branch &b : _branches) {
+      if (b.sink != nullptr && !_done) {
+        T copy = t;
+        b.sink->on_next(std::move(copy));
+      }
+    }
+  }
+
+  void on_error(std::error_condition ec) override {
+    std::lock_guard<std::recursive_mutex> guard(_mutex);
+    const std::shared_ptr<broadcast_source> self = std::move(_self);
+    _source_sub = nullptr;
+    _done = true;
+    for (branch &b : _branches) {
+      if (b.sink != nullptr) {
+        subscriber<T> *sink = b.sink;
+        b.sink = nullptr;
+        sink->on_error(ec);
+      }
+    }
+  }
+
+  void on_complete() override {
+    std::lock_guard<std::recursive_mutex> guard(_mutex);
+    const std::shared_ptr<broadcast_source> self = std::move(_self);
+    _source_sub = nullptr;
+    _done = true;
+    for (branch &b : _branches) {
+      if (b.sink != nullptr) {
+        subscriber<T> *sink = b.sink;
+        b.sink = nullptr;
+        sink->on_complete();
+      }
+    }
+  }
+
+  std::recursive_mutex _mutex;
+  publisher<T> _src;
+  std::vector<branch> _branches;
+  std::shared_ptr<broadcast_source> _self;
+  subscription *_source_sub{nullptr};
+  int64_t _source_requested{0};
+  size_t _subscribed{0};
+  size_t _active{0};
+  bool _done{false};
+};
+
+template <typename T>
+class broadcast_branch : public publisher_impl<T> {
+ public:
+  broadcast_branch(std::shared_ptr<broadcast_source<T>> source, size_t index)
+      : _source(std::move(source)), _index(index) {}
+
+  void subscribe(subscriber<T> &s) override { _source->subscribe(_index, s); }
+
+ private:
+  const std::shared_ptr<broadcast_source<T>> _source;
+  const size_t _index;
+};
+
+}  // namespace impl
+
+// Splits a stream into count streams that get every element of the source,
+// elements are copied for every branch, so large ones should be shared pointers.
+// The source is subscribed once all branches are subscribed and is asked for as
+// many elements as the slowest branch requested, so that branches which should
+// not hold others back, buffer elements with threaded_worker.
+// The source is cancelled after all branches cancel.
+template <typename T>
+std::vector<publisher<T>> broadcast(publisher<T> &&src, size_t count) {
+  CHECK_GT(count, 0) << "broadcast needs at least one branch";
+  auto source = std::make_shared<impl::broadcast_source<T>>(std::move(src), count);
+  std::vector<publisher<T>> result;
+  for (size_t i = 0; i < count; i++) {
+    result.emplace_back(new impl::broadcast_branch<T>(source, i));
+  }
+  return result;
+}
+
+}  // namespace streams
+}  // namespace video
+}  // namespace satori
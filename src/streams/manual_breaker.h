@@ -0,0 +1,124 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include "streams.h"
+
+namespace satori {
+namespace video {
+namespace streams {
+
+// Lets code outside of the stream stop it, see manual_breaker().
+class breaker_handle {
+ public:
+  // Cancels upstream and completes downstream.
+  // Does nothing if the stream has already finished or was not subscribed yet.
+  void trigger() {
+    std::function<void()> fn;
+    {
+      std::lock_guard<std::mutex> guard(_mutex);
+      fn = std::move(_on_trigger);
+      _on_trigger = nullptr;
+    }
+    if (fn) {
+      fn();
+    }
+  }
+
+  void set(std::function<void()> &&on_trigger) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _on_trigger = std::move(on_trigger);
+  }
+
+  void reset() { set(nullptr); }
+
+ private:
+  std::mutex _mutex;
+  std::function<void()> _on_trigger;
+};
+
+namespace impl {
+
+class manual_breaker_op {
+ public:
+  explicit manual_breaker_op(std::shared_ptr<breaker_handle> handle)
+      : _handle(std::move(handle)) {}
+
+  template <typename T>
+  class instance : public subscriber<T>, subscription {
+   public:
+    instance(manual_breaker_op &&op, subscriber<T> &sink)
+        : _handle(std::move(op._handle)), _sink(sink) {
+      _handle->set([this]() {
+        LOG(INFO) << "manual_breaker_op(" << this << ") breaking the stream";
+        if (_source_sub != nullptr) {
+          LOG(INFO) << "cancelling upstream subscription";
+          _source_sub->cancel();
+        }
+        LOG(INFO) << "sending complete signal to downstream";
+        _sink.on_complete();
+        delete this;
+      });
+    }
+
+    static publisher<T> apply(publisher<T> &&source, manual_breaker_op &&op) {
+      return publisher<T>(new impl::op_publisher<T, T, manual_breaker_op>(
+          std::move(source), std::move(op)));
+    }
+
+   private:
+    void on_next(T &&t) override { _sink.on_next(std::move(t)); };
+
+    void on_error(std::error_condition ec) override {
+      LOG(ERROR) << "manual_breaker_op(" << this << ") on_error";
+      _handle->reset();
+      _sink.on_error(ec);
+      delete this;
+    };
+
+    void on_complete() override {
+      LOG(5) << "manual_breaker_op(" << this << ") on_complete";
+      _handle->reset();
+      _sink.on_complete();
+      delete this;
+    };
+
+    void on_subscribe(subscription &s) override {
+      LOG(INFO) << "manual_breaker_op(" << this << ") on_subscribe";
+      _source_sub = &s;
+      _sink.on_subscribe(*this);
+    };
+
+    void request(int n) override {
+      LOG(5) << "manual_breaker_op(" << this << ") request " << n;
+      _source_sub->request(n);
+    }
+
+    void cancel() override {
+      LOG(INFO) << "manual_breaker_op(" << this << ") cancel";
+      _handle->reset();
+      _source_sub->cancel();
+      delete this;
+    }
+
+    std::shared_ptr<breaker_handle> _handle;
+    subscriber<T> &_sink;
+    subscription *_source_sub{nullptr};
+  };
+
+ private:
+  std::shared_ptr<breaker_handle> _handle;
+};
+
+}  // namespace impl
+
+// Stream operator that cancels the stream when handle is triggered.
+// Unlike signal_breaker, any number of instances may exist.
+inline auto manual_breaker(std::shared_ptr<breaker_handle> handle) {
+  return impl::manual_breaker_op(std::move(handle));
+}
+
+}  // namespace streams
+}  // namespace video
+}  // namespace satori
@@ -13,6 +13,7 @@
 #include <vector>
 
 #include "../logging.h"
+#include "../resource_governor.h"
 #include "type_traits.h"
 
 namespace satori {
@@ -204,6 +205,8 @@ class async_publisher_impl : public publisher_impl<std::queue<T>> {
     ~sub() override {
       _generator.stop_fn(_state);
       _state = nullptr;
+      resource_governor::add_bytes(resource_governor::buffer::ASYNC_QUEUE,
+                                   -_queued_bytes);
     }
 
     void init() { _state = _generator.start_fn(*this); }
@@ -212,8 +215,11 @@ class async_publisher_impl : public publisher_impl<std::queue<T>> {
     void on_next(T &&t) override {
       {
         LOG(5) << "async_publisher_impl::sub::on_next";
+        const int64_t bytes = resource_governor::byte_size<T>{}(t);
         std::lock_guard<std::mutex> guard(_mutex);
         _queue.emplace(std::move(t));
+        _queued_bytes += bytes;
+        resource_governor::add_bytes(resource_governor::buffer::ASYNC_QUEUE, bytes);
       }
       sub_base_t::drain();
     }
@@ -234,6 +240,9 @@ class async_publisher_impl : public publisher_impl<std::queue<T>> {
         }
 
         _queue.swap(tmp);
+        resource_governor::add_bytes(resource_governor::buffer::ASYNC_QUEUE,
+                                     -_queued_bytes);
+        _queued_bytes = 0;
         LOG(5) << "async_publisher_impl::sub::drain_impl sending " << tmp.size()
                << " elements";
       }
@@ -245,6 +254,7 @@ class async_publisher_impl : public publisher_impl<std::queue<T>> {
     AsyncGeneratorImpl _generator;
     std::mutex _mutex;
     std::queue<T> _queue;
+    int64_t _queued_bytes{0};
     State *_state{nullptr};
   };
 
@@ -4,7 +4,9 @@
 #include <thread>
 
 #include "../metrics.h"
+#include "../resource_governor.h"
 #include "../threadutils.h"
+#include "../tracing.h"
 
 #include "channel.h"
 #include "streams.h"
@@ -17,8 +19,9 @@ namespace impl {
 
 class threaded_worker_op {
  public:
-  explicit threaded_worker_op(const std::string &name, boost::optional<size_t> max_queued_frames)
-      : _name(name), _max_queued_frames(max_queued_frames) {}
+  threaded_worker_op(const std::string &name, boost::optional<size_t> max_queued_frames,
+                     bool sheddable)
+      : _name(name), _max_queued_frames(max_queued_frames), _sheddable(sheddable) {}
 
   template <typename T>
   class instance : publisher_impl<std::queue<T>> {
@@ -26,10 +29,11 @@ class threaded_worker_op {
 
     class source : drain_source_impl<element_t>, subscriber<T> {
      public:
-      source(const std::string &name, boost::optional<size_t> max_queued_frames, publisher<T> &&src,
-             streams::subscriber<element_t> &sink)
+      source(const std::string &name, boost::optional<size_t> max_queued_frames,
+             bool sheddable, publisher<T> &&src, streams::subscriber<element_t> &sink)
           : _name(name),
             _max_queued_frames(max_queued_frames),
+            _sheddable(sheddable),
             drain_source_impl<element_t>(sink) {
         _worker_thread = std::make_unique<std::thread>(&source::worker_thread_loop, this);
 
@@ -49,6 +53,8 @@ class threaded_worker_op {
           _src->cancel();
           _src = nullptr;
         }
+        resource_governor::add_bytes(resource_governor::buffer::WORKER_QUEUE,
+                                     -_buffered_bytes);
         _worker_thread->detach();
       }
 
@@ -65,7 +71,21 @@ class threaded_worker_op {
           LOG(ERROR) << this << " input queue is full";
           return;
         }
+        if (_sheddable
+            && resource_governor::current_level() >= resource_governor::level::DROP_OLDEST
+            && !_buffer.empty()) {
+          resource_governor::record_shed(resource_governor::level::DROP_OLDEST,
+                                         _buffer.size());
+          std::queue<T>().swap(_buffer);
+          resource_governor::add_bytes(resource_governor::buffer::WORKER_QUEUE,
+                                       -_buffered_bytes);
+          _buffered_bytes = 0;
+        }
+        const int64_t bytes = resource_governor::byte_size<T>{}(t);
         _buffer.emplace(std::move(t));
+        _buffered_bytes += bytes;
+        resource_governor::add_bytes(resource_governor::buffer::WORKER_QUEUE, bytes);
+        tracing::instant("queue_push");
         _on_send.notify_one();
       }
 
@@ -168,9 +188,13 @@ class threaded_worker_op {
             return false;
           }
           _buffer.swap(tmp);
+          resource_governor::add_bytes(resource_governor::buffer::WORKER_QUEUE,
+                                       -_buffered_bytes);
+          _buffered_bytes = 0;
         }
 
         LOG(5) << this << " " << _name << " delivering batch: " << tmp.size();
+        tracing::instant("queue_pop");
         drain_source_impl<element_t>::deliver_on_next(std::move(tmp));
         return false;
       }
@@ -178,6 +202,7 @@ class threaded_worker_op {
       std::atomic_bool _worker_thread_ready{false};
       const std::string _name;
       const boost::optional<size_t> _max_queued_frames;
+      const bool _sheddable;
       std::mutex _mutex;
       std::condition_variable _on_send;
 
@@ -186,6 +211,7 @@ class threaded_worker_op {
       std::error_condition _ec;
 
       std::queue<T> _buffer;
+      int64_t _buffered_bytes{0};
       std::unique_ptr<std::thread> _worker_thread;
       std::atomic_bool _thread_should_be_active{true};
       subscription *_src{nullptr};
@@ -194,33 +220,43 @@ class threaded_worker_op {
    public:
     static publisher<std::queue<T>> apply(publisher<T> &&src, threaded_worker_op &&op) {
       return publisher<std::queue<T>>(
-          new instance(op._name, op._max_queued_frames, std::move(src)));
+          new instance(op._name, op._max_queued_frames, op._sheddable, std::move(src)));
     }
 
-    instance(const std::string &name, boost::optional<size_t> max_queued_frames, publisher<T> &&src)
-        : _name(name), _max_queued_frames(max_queued_frames), _src(std::move(src)) {}
+    instance(const std::string &name, boost::optional<size_t> max_queued_frames,
+             bool sheddable, publisher<T> &&src)
+        : _name(name),
+          _max_queued_frames(max_queued_frames),
+          _sheddable(sheddable),
+          _src(std::move(src)) {}
 
     void subscribe(subscriber<element_t> &s) override {
-      new source(_name, _max_queued_frames, std::move(_src), s);
+      new source(_name, _max_queued_frames, _sheddable, std::move(_src), s);
     }
 
    private:
     const std::string _name;
     const boost::optional<size_t> _max_queued_frames;
+    const bool _sheddable;
     publisher<T> _src;
   };
 
  private:
   const std::string _name;
   const boost::optional<size_t> _max_queued_frames;
+  const bool _sheddable;
 };
 
 }  // namespace impl
 
 // threaded worker transforms publisher<T> into publisher<std::queue<T>> by
 // spawning new thread and performing all element delivery in it.
-inline auto threaded_worker(const std::string &name, boost::optional<size_t> max_queued_frames = {}) {
-  return impl::threaded_worker_op(name, max_queued_frames);
+// Queue of a sheddable worker keeps only the newest element when resource
+// governor is at DROP_OLDEST level or above.
+inline auto threaded_worker(const std::string &name,
+                            boost::optional<size_t> max_queued_frames = {},
+                            bool sheddable = false) {
+  return impl::threaded_worker_op(name, max_queued_frames, sheddable);
 }
 
 }  // namespace streams
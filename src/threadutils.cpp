@@ -1,8 +1,18 @@
 #include "threadutils.h"
 
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
 #include "logging.h"
 
+#if defined(__linux__)
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
 namespace satori {
 namespace video {
 namespace threadutils {
@@ -36,6 +46,167 @@ std::string get_current_thread_name() {
 #endif
 }
 
+#if defined(__linux__)
+namespace {
+
+// Format is described in man 5 proc. Name is in parentheses and may contain
+// spaces and parentheses itself, so the fields are counted from the last ')'.
+bool read_task_stat(const std::string &task_dir, thread_cpu_usage &usage) {
+  std::ifstream in(task_dir + "/stat");
+  std::string line;
+  if (!std::getline(in, line)) {
+    return false;
+  }
+  const size_t name_begin = line.find('(');
+  const size_t name_end = line.rfind(')');
+  if (name_begin == std::string::npos || name_end == std::string::npos
+      || name_end < name_begin) {
+    return false;
+  }
+  usage.name = line.substr(name_begin + 1, name_end - name_begin - 1);
+
+  // fields after the name start from the 3rd one, utime and stime are 14th and 15th
+  std::istringstream fields(line.substr(name_end + 1));
+  std::string field;
+  uint64_t utime = 0;
+  uint64_t stime = 0;
+  for (int i = 3; i <= 15 && fields >> field; i++) {
+    if (i == 14) {
+      utime = std::stoull(field);
+    } else if (i == 15) {
+      stime = std::stoull(field);
+      static const double ticks_per_sec = sysconf(_SC_CLK_TCK);
+      usage.user_time_sec = utime / ticks_per_sec;
+      usage.system_time_sec = stime / ticks_per_sec;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool read_task_status(const std::string &task_dir, thread_cpu_usage &usage) {
+  std::ifstream in(task_dir + "/status");
+  std::string key;
+  int found = 0;
+  while (in >> key) {
+    if (key == "voluntary_ctxt_switches:") {
+      in >> usage.voluntary_context_switches;
+      found++;
+    } else if (key == "nonvoluntary_ctxt_switches:") {
+      in >> usage.involuntary_context_switches;
+      found++;
+    }
+    in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+  return found == 2;
+}
+
+}  // namespace
+
+std::vector<thread_cpu_usage> get_threads_cpu_usage() {
+  std::vector<thread_cpu_usage> result;
+  DIR *dir = opendir("/proc/self/task");
+  if (dir == nullptr) {
+    LOG(ERROR) << "can't open /proc/self/task: " << strerror(errno);
+    return result;
+  }
+  while (const dirent *entry = readdir(dir)) {
+    if (entry->d_name[0] < '0' || entry->d_name[0] > '9') {
+      continue;
+    }
+    const std::string task_dir = std::string{"/proc/self/task/"} + entry->d_name;
+    thread_cpu_usage usage{std::stoi(entry->d_name), "", 0, 0, 0, 0};
+    // thread may exit while being read
+    if (read_task_stat(task_dir, usage) && read_task_status(task_dir, usage)) {
+      result.push_back(std::move(usage));
+    }
+  }
+  closedir(dir);
+  return result;
+}
+#else
+std::vector<thread_cpu_usage> get_threads_cpu_usage() { return {}; }
+#endif
+
+struct thread_pool::batch {
+  size_t remaining;
+};
+
+thread_pool::thread_pool(const std::string &name, size_t threads_count) {
+  for (size_t i = 0; i < threads_count; i++) {
+    _threads.emplace_back(&thread_pool::worker_loop, this, name + std::to_string(i));
+  }
+}
+
+thread_pool::~thread_pool() {
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _stopping = true;
+  }
+  _task_added.notify_all();
+  for (auto &t : _threads) {
+    t.join();
+  }
+}
+
+void thread_pool::run(std::vector<std::function<void()>> &&tasks) {
+  if (tasks.empty()) {
+    return;
+  }
+
+  batch b{tasks.size()};
+  std::unique_lock<std::mutex> lock(_mutex);
+  for (auto &fn : tasks) {
+    _tasks.push_back(task{std::move(fn), &b});
+  }
+  _task_added.notify_all();
+
+  // calling thread helps instead of just waiting
+  while (b.remaining > 0) {
+    if (!run_one(lock)) {
+      _task_done.wait(lock);
+    }
+  }
+}
+
+bool thread_pool::run_one(std::unique_lock<std::mutex> &lock) {
+  if (_tasks.empty()) {
+    return false;
+  }
+
+  task t = std::move(_tasks.front());
+  _tasks.pop_front();
+  lock.unlock();
+  t.fn();
+  lock.lock();
+
+  t.owner->remaining--;
+  if (t.owner->remaining == 0) {
+    _task_done.notify_all();
+  }
+  return true;
+}
+
+void thread_pool::worker_loop(const std::string &name) {
+  set_current_thread_name(name);
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (true) {
+    if (run_one(lock)) {
+      continue;
+    }
+    if (_stopping) {
+      break;
+    }
+    _task_added.wait(lock);
+  }
+}
+
+thread_pool &shared_thread_pool() {
+  static thread_pool pool{
+      "bot_pool_", std::max(1u, std::thread::hardware_concurrency()) - 1};
+  return pool;
+}
+
 }  // namespace threadutils
 }  // namespace video
 }  // namespace satori
\ No newline at end of file
@@ -1,6 +1,13 @@
 #pragma once
 
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace satori {
 namespace video {
@@ -10,6 +17,57 @@ void set_current_thread_name(const std::string &original_name);
 
 std::string get_current_thread_name();
 
+// CPU usage of a thread of the current process since the thread started
+struct thread_cpu_usage {
+  int tid;
+  std::string name;
+  double user_time_sec;
+  double system_time_sec;
+  uint64_t voluntary_context_switches;
+  uint64_t involuntary_context_switches;
+};
+
+// Reads usage of all live threads of the current process from /proc,
+// returns nothing on other OSes
+std::vector<thread_cpu_usage> get_threads_cpu_usage();
+
+// Fixed set of named threads executing batches of tasks.
+// Can be shared by several callers, every run() waits only for its own tasks.
+class thread_pool {
+ public:
+  thread_pool(const std::string &name, size_t threads_count);
+  ~thread_pool();
+
+  thread_pool(const thread_pool &) = delete;
+  thread_pool &operator=(const thread_pool &) = delete;
+
+  // Executes tasks on pool threads and on the calling thread,
+  // returns when all of them are done.
+  void run(std::vector<std::function<void()>> &&tasks);
+
+  size_t threads_count() const { return _threads.size(); }
+
+ private:
+  struct batch;
+  struct task {
+    std::function<void()> fn;
+    batch *owner;
+  };
+
+  void worker_loop(const std::string &name);
+  bool run_one(std::unique_lock<std::mutex> &lock);
+
+  std::mutex _mutex;
+  std::condition_variable _task_added;
+  std::condition_variable _task_done;
+  std::deque<task> _tasks;
+  bool _stopping{false};
+  std::vector<std::thread> _threads;
+};
+
+// Process-wide pool with a thread per available core, except the calling one.
+thread_pool &shared_thread_pool();
+
 }  // namespace threadutils
 }  // namespace video
 }  // namespace satori
\ No newline at end of file
@@ -0,0 +1,243 @@
+#include "tracing.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <json.hpp>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "logging.h"
+#include "threadutils.h"
+
+namespace satori {
+namespace video {
+namespace tracing {
+
+namespace impl {
+std::atomic<bool> recording{false};
+}  // namespace impl
+
+namespace {
+
+// Older events of a thread are overwritten
+constexpr size_t buffer_capacity = 1 << 15;
+
+const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+int64_t to_micros(std::chrono::steady_clock::duration d) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+struct event {
+  const char *name;
+  char phase;  // 'X' for complete events, 'i' for instant ones
+  int64_t ts_us;
+  int64_t dur_us;
+};
+
+// Ring of events written only by its own thread, so no locks are needed.
+// The trace writer reads it after recording stops.
+struct thread_buffer {
+  thread_buffer(int tid, std::string thread_name)
+      : tid(tid), thread_name(std::move(thread_name)), events(buffer_capacity) {}
+
+  void push(const event &e) {
+    const uint64_t h = head.load(std::memory_order_relaxed);
+    events[h % buffer_capacity] = e;
+    head.store(h + 1, std::memory_order_release);
+  }
+
+  const int tid;
+  const std::string thread_name;
+  std::vector<event> events;
+  std::atomic<uint64_t> head{0};
+};
+
+struct tracer {
+  ~tracer() {
+    if (timer.joinable()) {
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+        stop_requested = true;
+      }
+      stop_condition.notify_all();
+      timer.join();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable stop_condition;
+  bool stop_requested{false};
+  std::thread timer;
+  std::string output_file{"trace.json"};
+  std::chrono::steady_clock::time_point window_start;
+  std::vector<std::shared_ptr<thread_buffer>> buffers;
+  int next_tid{1};
+};
+
+tracer &get_tracer() {
+  static tracer t;
+  return t;
+}
+
+thread_buffer &current_thread_buffer() {
+  thread_local std::shared_ptr<thread_buffer> buffer;
+  if (!buffer) {
+    tracer &t = get_tracer();
+    std::lock_guard<std::mutex> guard(t.mutex);
+    buffer = std::make_shared<thread_buffer>(t.next_tid++,
+                                             threadutils::get_current_thread_name());
+    t.buffers.push_back(buffer);
+  }
+  return *buffer;
+}
+
+void write_trace() {
+  impl::recording = false;
+
+  tracer &t = get_tracer();
+  std::vector<std::shared_ptr<thread_buffer>> buffers;
+  std::string output_file;
+  int64_t window_start_us;
+  {
+    std::lock_guard<std::mutex> guard(t.mutex);
+    buffers = t.buffers;
+    output_file = t.output_file;
+    window_start_us = to_micros(t.window_start - origin);
+  }
+
+  const int pid = getpid();
+  nlohmann::json events = nlohmann::json::array();
+  for (const auto &buffer : buffers) {
+    events.push_back({{"name", "thread_name"},
+                      {"ph", "M"},
+                      {"pid", pid},
+                      {"tid", buffer->tid},
+                      {"args", {{"name", buffer->thread_name}}}});
+
+    // the oldest slot may be overwritten by an event being recorded right now
+    const uint64_t head = buffer->head.load(std::memory_order_acquire);
+    const uint64_t first = head >= buffer_capacity ? head - buffer_capacity + 1 : 0;
+    for (uint64_t i = first; i < head; i++) {
+      const event &e = buffer->events[i % buffer_capacity];
+      if (e.ts_us < window_start_us) {
+        continue;
+      }
+      nlohmann::json item = {{"name", e.name},
+                             {"ph", std::string(1, e.phase)},
+                             {"pid", pid},
+                             {"tid", buffer->tid},
+                             {"ts", e.ts_us}};
+      if (e.phase == 'X') {
+        item["dur"] = e.dur_us;
+      } else {
+        item["s"] = "t";
+      }
+      events.push_back(std::move(item));
+    }
+  }
+
+  std::ofstream out(output_file);
+  if (!out) {
+    LOG(ERROR) << "can't open trace file " << output_file;
+    return;
+  }
+  out << nlohmann::json{{"traceEvents", events}, {"displayTimeUnit", "ms"}};
+  LOG(INFO) << "wrote " << events.size() << " trace events to " << output_file;
+
+  // buffers of finished threads are owned only by the tracer
+  buffers.clear();
+  std::lock_guard<std::mutex> guard(t.mutex);
+  t.buffers.erase(std::remove_if(t.buffers.begin(), t.buffers.end(),
+                                 [](const std::shared_ptr<thread_buffer> &b) {
+                                   return b.use_count() == 1;
+                                 }),
+                  t.buffers.end());
+}
+
+}  // namespace
+
+void set_output_file(const std::string &filename) {
+  tracer &t = get_tracer();
+  std::lock_guard<std::mutex> guard(t.mutex);
+  t.output_file = filename;
+}
+
+bool start(std::chrono::milliseconds duration) {
+  tracer &t = get_tracer();
+  std::thread previous;
+  {
+    std::lock_guard<std::mutex> guard(t.mutex);
+    if (impl::recording) {
+      LOG(WARNING) << "tracing is already on";
+      return false;
+    }
+    previous = std::move(t.timer);
+  }
+  // previous window has finished, but its thread may be still writing the file
+  if (previous.joinable()) {
+    previous.join();
+  }
+
+  std::lock_guard<std::mutex> guard(t.mutex);
+  if (impl::recording || t.timer.joinable()) {
+    LOG(WARNING) << "tracing is already on";
+    return false;
+  }
+  LOG(INFO) << "starting tracing for " << duration.count() << "ms";
+  t.window_start = std::chrono::steady_clock::now();
+  t.stop_requested = false;
+  impl::recording = true;
+  t.timer = std::thread([duration, &t]() {
+    threadutils::set_current_thread_name("trace_writer");
+    {
+      std::unique_lock<std::mutex> lock(t.mutex);
+      t.stop_condition.wait_for(lock, duration, [&t]() { return t.stop_requested; });
+    }
+    write_trace();
+  });
+  return true;
+}
+
+void stop() {
+  tracer &t = get_tracer();
+  std::thread timer;
+  {
+    std::lock_guard<std::mutex> guard(t.mutex);
+    t.stop_requested = true;
+    timer = std::move(t.timer);
+  }
+  t.stop_condition.notify_all();
+  if (timer.joinable()) {
+    timer.join();
+  }
+}
+
+namespace impl {
+
+void record_complete(const char *name, std::chrono::steady_clock::time_point start) {
+  if (!is_recording()) {
+    return;
+  }
+  const auto now = std::chrono::steady_clock::now();
+  current_thread_buffer().push(
+      {name, 'X', to_micros(start - origin), to_micros(now - start)});
+}
+
+void record_instant(const char *name) {
+  if (!is_recording()) {
+    return;
+  }
+  current_thread_buffer().push(
+      {name, 'i', to_micros(std::chrono::steady_clock::now() - origin), 0});
+}
+
+}  // namespace impl
+
+}  // namespace tracing
+}  // namespace video
+}  // namespace satori
@@ -0,0 +1,70 @@
+// Timeline of pipeline stages in Chrome Trace Event format, can be opened
+// in chrome://tracing or https://ui.perfetto.dev.
+// Recording is off by default, start() turns it on for a bounded window.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace satori {
+namespace video {
+namespace tracing {
+
+constexpr std::chrono::milliseconds default_duration{5000};
+
+// Sets the file trace is written to, trace.json by default
+void set_output_file(const std::string &filename);
+
+// Starts recording events of all threads, after the duration the events are written
+// to the output file and recording stops. Returns false if recording is already on.
+bool start(std::chrono::milliseconds duration);
+
+// Writes events recorded so far and stops recording, does nothing if it is off
+void stop();
+
+namespace impl {
+extern std::atomic<bool> recording;
+
+// Name should be a string literal, only the pointer is stored
+void record_complete(const char *name, std::chrono::steady_clock::time_point start);
+void record_instant(const char *name);
+}  // namespace impl
+
+inline bool is_recording() { return impl::recording.load(std::memory_order_relaxed); }
+
+// Records time spent in a block of code, has almost no cost when recording is off
+class scope {
+ public:
+  explicit scope(const char *name) : _name(name) {
+    if (is_recording()) {
+      _start = std::chrono::steady_clock::now();
+      _active = true;
+    }
+  }
+
+  ~scope() {
+    if (_active) {
+      impl::record_complete(_name, _start);
+    }
+  }
+
+  scope(const scope &) = delete;
+  scope &operator=(const scope &) = delete;
+
+ private:
+  const char *_name;
+  std::chrono::steady_clock::time_point _start;
+  bool _active{false};
+};
+
+// Records a point in time, like a hand-off between threads
+inline void instant(const char *name) {
+  if (is_recording()) {
+    impl::record_instant(name);
+  }
+}
+
+}  // namespace tracing
+}  // namespace video
+}  // namespace satori
@@ -38,7 +38,10 @@ class url_source_impl {
  public:
   url_source_impl(const std::string &url, const std::string &options,
                   streams::observer<encoded_packet> &sink)
-      : _url{url}, _sink{sink}, _reader_thread_name{"url " + url} {
+      : _url{url},
+        _sink{sink},
+        _reader_thread_name{"url " + url},
+        _frames_total{frames_total.Add({{"url", url}})} {
     avutils::init();
     created_total.Add({{"url", _url}}).Increment();
     std::thread([this, options]() {
@@ -165,8 +168,9 @@ class url_source_impl {
         frame.id = {_packets, _packets};
         frame.timestamp = packet_time;
         frame.creation_time = std::chrono::system_clock::now();
+        frame.reassembly_time = frame.creation_time;
         frame.key_frame = static_cast<bool>(_pkt.flags & AV_PKT_FLAG_KEY);
-        frames_total.Add({{"url", _url}}).Increment();
+        _frames_total.Increment();
         _sink.on_next(frame);
       }
     }
@@ -180,6 +184,7 @@ class url_source_impl {
   std::shared_ptr<AVCodecContext> _decoder_context;
   std::thread::id _reader_thread_id;
   const std::string _reader_thread_name;
+  prometheus::Counter &_frames_total;
   std::atomic<bool> _active{true};
   int _stream_idx{-1};
   int64_t _packets{0};
@@ -1,14 +1,25 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+
 #include "bot_environment.h"
 #include "bot_instance.h"
 #include "metrics.h"
 #include "stopwatch.h"
+#include "threadutils.h"
+#include "tracing.h"
 
 namespace satori {
 namespace video {
 void bot_message(bot_context& context, const bot_message_kind kind,
                  nlohmann::json&& message, const frame_id& id) {
   CHECK(message.is_object()) << "Message must be an object: " << message;
-  static_cast<bot_instance&>(context).queue_message(kind, std::move(message), id);
+  static_cast<bot_callback_context&>(context).queue_message(kind, std::move(message), id);
+}
+
+void bot_set_region_of_interest(bot_context& context, const image_region& region) {
+  static_cast<bot_callback_context&>(context).set_region_of_interest(region);
 }
 
 void multiframe_bot_register(const multiframe_bot_descriptor& bot) {
@@ -19,31 +30,132 @@ int multiframe_bot_main(int argc, char* argv[]) {
   return bot_environment::instance().main(argc, argv);
 }
 
+void encoded_bot_register(const encoded_bot_descriptor& bot) {
+  bot_environment::instance().register_encoded_bot(bot);
+}
+
+int encoded_bot_main(int argc, char* argv[]) {
+  return bot_environment::instance().main(argc, argv);
+}
+
 namespace {
+auto& frame_latency_millis =
+    prometheus::BuildHistogram()
+        .Name("frame_latency_millis")
+        .Register(metrics_registry())
+        .Add({}, std::vector<double>{0,   5,   10,  20,  30,   40,   50,   75,   100,
+                                     150, 200, 300, 400, 500,  750,  1000, 1500, 2000,
+                                     3000, 5000, 10000});
+
+bool has_arrival_time(const image_frame& frame) {
+  return frame.arrival_time.time_since_epoch().count() != 0;
+}
+
+double age_millis(const image_frame& frame) {
+  if (!has_arrival_time(frame)) {
+    return 0;
+  }
+  return std::chrono::duration<double, std::milli>(std::chrono::system_clock::now()
+                                                   - frame.arrival_time)
+      .count();
+}
+
+// Moving average of image callback duration, fed with the same values as
+// frame_processing_times_millis. Lanes of concurrent bots update it in parallel.
+class callback_duration_estimate {
+ public:
+  void observe(double millis) {
+    constexpr double alpha = 0.1;
+    std::lock_guard<std::mutex> guard(_mutex);
+    _millis = _observed ? _millis + alpha * (millis - _millis) : millis;
+    _observed = true;
+  }
+
+  double millis() {
+    std::lock_guard<std::mutex> guard(_mutex);
+    return _millis;
+  }
+
+ private:
+  std::mutex _mutex;
+  double _millis{0};
+  bool _observed{false};
+};
+
 void process_single_frame(bot_context& context, const bot_img_callback_t& callback,
+                          callback_duration_estimate& callback_duration,
                           const image_frame frame) {
   stopwatch<> s;
-  static_cast<bot_instance&>(context).set_current_frame_id(frame.id);
-  callback(context, frame);
-  static_cast<bot_instance&>(context).set_current_frame_id({0, 0});
-  context.metrics.frame_processing_time_ms.Observe(s.millis());
+  static_cast<bot_callback_context&>(context).set_current_frame_id(frame.id);
+  {
+    tracing::scope callback_scope("frame_callback");
+    callback(context, frame);
+  }
+  static_cast<bot_callback_context&>(context).set_current_frame_id({0, 0});
+  const double millis = s.micros() / 1000.0;
+  context.metrics.frame_processing_time_ms.Observe(millis);
   context.metrics.frames_processed_total.Increment();
+  callback_duration.observe(millis);
+  if (has_arrival_time(frame)) {
+    frame_latency_millis.Observe(age_millis(frame));
+  }
 }
 
-std::vector<image_frame> drop_strategy_as_needed(const gsl::span<image_frame>& frames) {
-  if (frames.size() > 1) {
-    return {frames[frames.size() / 2 - 1], *(frames.end() - 1)};
+// count frames evenly spaced over the batch, ending with the latest one
+std::vector<image_frame> evenly_spaced_frames(const gsl::span<image_frame>& frames,
+                                              size_t count) {
+  const size_t size = frames.size();
+  if (size <= count) {
+    return {frames.begin(), frames.end()};
   }
-  return {frames.begin(), frames.end()};
+  std::vector<image_frame> result;
+  for (size_t i = 0; i < count; i++) {
+    result.push_back(frames[size - 1 - (count - 1 - i) * size / count]);
+  }
+  return result;
 }
 
-std::vector<image_frame> drop_strategy_never(const gsl::span<image_frame>& frames) {
+// concurrency is bigger than 1 only for bots processing several frames at once
+std::vector<image_frame> drop_strategy_as_needed(const gsl::span<image_frame>& frames,
+                                                 size_t concurrency) {
+  const size_t size = frames.size();
+  if (size > 1 && concurrency <= 2) {
+    return {frames[size / 2 - 1], *(frames.end() - 1)};
+  }
+  return evenly_spaced_frames(frames, concurrency);
+}
+
+std::vector<image_frame> drop_strategy_never(const gsl::span<image_frame>& frames,
+                                             size_t /*concurrency*/) {
   return {frames.begin(), frames.end()};
 }
 
-using select_function_t =
-    std::function<std::vector<image_frame>(const gsl::span<image_frame>& frames)>;
+// Processes as many frames as fit into the latency budget: the latest frame
+// has to be done before it gets older than the budget. If it is already late,
+// only the latest frame is processed.
+std::vector<image_frame> drop_strategy_deadline(const gsl::span<image_frame>& frames,
+                                                size_t concurrency,
+                                                double latency_budget_ms,
+                                                double callback_ms) {
+  const double remaining_ms = latency_budget_ms - age_millis(*(frames.end() - 1));
+
+  size_t count = frames.size();
+  if (remaining_ms <= 0) {
+    count = 1;
+  } else if (callback_ms > 0) {
+    // every lane processes its frames one after another
+    const double rounds = std::floor(remaining_ms / callback_ms);
+    count = static_cast<size_t>(std::max(1.0, std::min<double>(rounds * concurrency,
+                                                               frames.size())));
+  }
+
+  return evenly_spaced_frames(frames, count);
+}
+
+using select_function_t = std::function<std::vector<image_frame>(
+    const gsl::span<image_frame>& frames, size_t concurrency)>;
 
+// Every registered bot drops frames on its own
 struct drop_strategy {
   void update(const nlohmann::json& config) {
     if (!config.is_object()) {
@@ -62,31 +174,70 @@ struct drop_strategy {
                                             ? body["frame_drop_strategy"]
                                             : "as_needed";
 
-      if (drop_strategy != "as_needed" && drop_strategy != "never") {
+      if (!set(drop_strategy, body)) {
         ABORT() << "Unsupported drop strategy: " << config;
       }
+    }
 
-      LOG(4) << "new drop strategy: " << drop_strategy;
+    // unlike configure, tune keeps current strategy if it is not specified
+    // and doesn't abort on bad input, because it comes from control channel
+    if (config["action"] == "tune" && config.find("body") != config.end()) {
+      auto& body = config["body"];
+      if (body.find("frame_drop_strategy") == body.end()) {
+        return;
+      }
 
-      if (drop_strategy == "never") {
-        select_function = drop_strategy_never;
+      if (!body["frame_drop_strategy"].is_string()) {
+        LOG(ERROR) << "frame_drop_strategy is not a string: " << config;
         return;
       }
+      const std::string drop_strategy = body["frame_drop_strategy"];
+      if (!set(drop_strategy, body)) {
+        LOG(ERROR) << "Unsupported drop strategy: " << config;
+      }
+    }
+  }
+
+  // returns false if strategy or its parameters are not supported
+  bool set(const std::string& drop_strategy, const nlohmann::json& body) {
+    LOG(4) << "new drop strategy: " << drop_strategy;
+
+    if (drop_strategy == "never") {
+      select_function = drop_strategy_never;
+      return true;
+    }
+
+    if (drop_strategy == "deadline") {
+      auto it = body.find("latency_budget_ms");
+      if (it == body.end() || !it->is_number() || it->get<double>() <= 0) {
+        LOG(ERROR) << "deadline drop strategy requires positive latency_budget_ms";
+        return false;
+      }
+      const double latency_budget_ms = it->get<double>();
+      select_function = [this, latency_budget_ms](const gsl::span<image_frame>& frames,
+                                                  size_t concurrency) {
+        return drop_strategy_deadline(frames, concurrency, latency_budget_ms,
+                                      callback_duration.millis());
+      };
+      return true;
+    }
+
+    if (drop_strategy == "as_needed") {
       select_function = drop_strategy_as_needed;
+      return true;
     }
+
+    return false;
   }
 
-  select_function_t select_function;
+  select_function_t select_function{drop_strategy_as_needed};
+  callback_duration_estimate callback_duration;
 };
 
-drop_strategy& get_drop_strategy() {
-  static drop_strategy strategy{drop_strategy_as_needed};
-  return strategy;
-}
-
-bot_ctrl_callback_t to_drop_disabling_callback(const bot_ctrl_callback_t& callback) {
-  return [callback](bot_context& context, const nlohmann::json& message) {
-    get_drop_strategy().update(message);
+bot_ctrl_callback_t to_drop_disabling_callback(const bot_ctrl_callback_t& callback,
+                                               std::shared_ptr<drop_strategy> strategy) {
+  return [callback, strategy](bot_context& context, const nlohmann::json& message) {
+    strategy->update(message);
     if (callback) {
       return callback(context, message);
     }
@@ -94,13 +245,74 @@ bot_ctrl_callback_t to_drop_disabling_callback(const bot_ctrl_callback_t& callba
   };
 }
 
+// Splits selected frames between lanes, every lane has its own context and processes
+// its frames in order on the shared thread pool. Batches are processed one after
+// another, so the slowest frame of a batch delays the next batch for all lanes.
+class parallel_frame_processor {
+ public:
+  parallel_frame_processor(const bot_img_callback_t& callback, uint8_t concurrency,
+                           std::shared_ptr<drop_strategy> strategy)
+      : _callback(callback), _concurrency(concurrency), _strategy(std::move(strategy)) {}
+
+  void process(bot_context& context, const std::vector<image_frame>& frames) {
+    auto& instance = static_cast<bot_instance&>(context);
+    // lanes belong to the instance, the processor is shared by all jobs of the bot
+    const auto& lanes = instance.worker_contexts(_concurrency);
+
+    const size_t lanes_count = std::min<size_t>(lanes.size(), frames.size());
+    std::vector<std::function<void()>> tasks;
+    for (size_t lane = 0; lane < lanes_count; lane++) {
+      tasks.emplace_back([this, &frames, &lanes, lane, lanes_count]() {
+        for (size_t i = lane; i < frames.size(); i += lanes_count) {
+          process_single_frame(*lanes[lane], _callback, _strategy->callback_duration,
+                               frames[i]);
+        }
+      });
+    }
+    threadutils::shared_thread_pool().run(std::move(tasks));
+
+    std::vector<struct bot_message> messages;
+    for (auto& lane : lanes) {
+      for (auto& msg : lane->take_messages()) {
+        messages.push_back(std::move(msg));
+      }
+    }
+    std::stable_sort(messages.begin(), messages.end(),
+                     [](const struct bot_message& lhs, const struct bot_message& rhs) {
+                       return lhs.id.i1 < rhs.id.i1;
+                     });
+    for (auto& msg : messages) {
+      instance.queue_message(msg.kind, std::move(msg.data), msg.id);
+    }
+  }
+
+ private:
+  const bot_img_callback_t _callback;
+  const uint8_t _concurrency;
+  const std::shared_ptr<drop_strategy> _strategy;
+};
+
 multiframe_bot_img_callback_t to_multiframe_bot_callback(
-    const bot_img_callback_t& callback) {
-  return [callback](bot_context& context, const gsl::span<image_frame>& frames) {
+    const bot_img_callback_t& callback, uint8_t concurrency,
+    std::shared_ptr<drop_strategy> strategy) {
+  if (concurrency > 1) {
+    auto processor =
+        std::make_shared<parallel_frame_processor>(callback, concurrency, strategy);
+    return [processor, concurrency, strategy](bot_context& context,
+                                              const gsl::span<image_frame>& frames) {
+      CHECK(!frames.empty());
+      auto selected_frames = strategy->select_function(frames, concurrency);
+      processor->process(context, selected_frames);
+      context.metrics.frames_dropped_total.Increment(frames.size()
+                                                     - selected_frames.size());
+    };
+  }
+
+  return [callback, strategy](bot_context& context, const gsl::span<image_frame>& frames) {
     CHECK(!frames.empty());
-    auto selected_frames = get_drop_strategy().select_function(frames);
+    auto selected_frames = strategy->select_function(frames, 1);
     for (const auto& f : selected_frames) {
-      process_single_frame(context, callback, f);
+      process_single_frame(context, callback, strategy->callback_duration, f);
     }
     context.metrics.frames_dropped_total.Increment(frames.size()
                                                    - selected_frames.size());
@@ -110,8 +322,13 @@ multiframe_bot_img_callback_t to_multiframe_bot_callback(
 }  // namespace
 
 void bot_register(const bot_descriptor& bot) {
-  multiframe_bot_register({bot.pixel_format, to_multiframe_bot_callback(bot.img_callback),
-                           to_drop_disabling_callback(bot.ctrl_callback)});
+  CHECK_GT(bot.concurrency, 0) << "bad concurrency";
+  auto strategy = std::make_shared<drop_strategy>();
+  multiframe_bot_register(
+      {bot.pixel_format,
+       to_multiframe_bot_callback(bot.img_callback, bot.concurrency, strategy),
+       to_drop_disabling_callback(bot.ctrl_callback, strategy), bot.pyramid_levels,
+       bot.region_of_interest, bot.name});
 }
 
 int bot_main(int argc, char** argv) { return multiframe_bot_main(argc, argv); }
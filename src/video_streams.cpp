@@ -6,6 +6,8 @@
 #include "base64.h"
 #include "logging.h"
 #include "metrics.h"
+#include "resource_governor.h"
+#include "tracing.h"
 #include "video_error.h"
 #include "video_streams.h"
 
@@ -40,6 +42,7 @@ streams::op<network_packet, encoded_packet> decode_network_stream() {
     }
 
     streams::publisher<encoded_packet> operator()(const network_frame &nf) {
+      tracing::scope reassembly_scope("reassembly");
       if (_chunk != nf.chunk) {
         LOG(ERROR) << "chunk mismatch f.id=" << nf.id << " expected " << _chunk
                    << ", got " << nf.chunk;
@@ -59,6 +62,8 @@ streams::op<network_packet, encoded_packet> decode_network_stream() {
       const auto data_or_error = base64::decode(nf.base64_data);
       CHECK(data_or_error.ok()) << "bad base64 data: " << nf.base64_data;
       _aggregated_data.append(data_or_error.get());
+      resource_governor::add_bytes(resource_governor::buffer::NETWORK_FRAME_CHUNKS,
+                                   data_or_error.get().size());
 
       if (nf.chunk == nf.chunks) {
         encoded_frame frame;
@@ -66,6 +71,7 @@ streams::op<network_packet, encoded_packet> decode_network_stream() {
         frame.id = _id;
         frame.timestamp = _timestamp;
         frame.creation_time = _creation_time;
+        frame.reassembly_time = std::chrono::system_clock::now();
         frame.key_frame = _key_frame;
 
         reset();
@@ -78,8 +84,12 @@ streams::op<network_packet, encoded_packet> decode_network_stream() {
       return streams::publishers::empty<encoded_packet>();
     }
 
+    ~packet_visitor() { reset(); }
+
    private:
     void reset() {
+      resource_governor::add_bytes(resource_governor::buffer::NETWORK_FRAME_CHUNKS,
+                                   -static_cast<int64_t>(_aggregated_data.size()));
       _chunk = 1;
       _aggregated_data.clear();
     }
@@ -108,5 +118,17 @@ streams::op<encoded_packet, encoded_packet> repeat_metadata() {
   });
 }
 
+streams::op<encoded_packet, encoded_packet> keyframes_only() {
+  return [](streams::publisher<encoded_packet> &&src) {
+    return std::move(src) >> streams::flat_map([](encoded_packet &&packet) {
+             const encoded_frame *f = boost::get<encoded_frame>(&packet);
+             if (f != nullptr && !f->key_frame) {
+               return streams::publishers::empty<encoded_packet>();
+             }
+             return streams::publishers::of({std::move(packet)});
+           });
+  };
+}
+
 }  // namespace video
 }  // namespace satori
@@ -4,7 +4,9 @@
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
 #include <functional>
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 
 #include "data.h"
@@ -35,9 +37,53 @@ streams::publisher<network_packet> rtm_source(
 
 streams::op<network_packet, encoded_packet> decode_network_stream();
 
+// Decoding parameters that can be changed from any thread while the stream is running.
+// Decoder rebuilds its filter graph before the next frame after a change.
+class decoder_settings {
+ public:
+  explicit decoder_settings(const image_region &region_of_interest = {0, 0, 1, 1});
+
+  void set_region_of_interest(const image_region &region);
+  image_region region_of_interest() const;
+
+  // Overrides bounding size decoder was created with
+  void set_bounding_size(const image_size &size);
+  boost::optional<image_size> bounding_size() const;
+
+  // Decoded frames above this rate are skipped before scaling, 0 means no limit
+  void set_max_fps(double fps);
+  double max_fps() const;
+
+  // Incremented on every change
+  uint64_t version() const { return _version; }
+
+ private:
+  mutable std::mutex _mutex;
+  image_region _region_of_interest;
+  boost::optional<image_size> _bounding_size;
+  double _max_fps{0};
+  std::atomic<uint64_t> _version{0};
+};
+
+// pyramid_levels tells how many downscaled copies of every frame should be built,
+// see owned_image_frame::levels.
+// settings are optional and may be shared with the code that changes them.
 streams::op<encoded_packet, owned_image_packet> decode_image_frames(
     const image_size &bounding_size, image_pixel_format pixel_format,
-    bool keep_aspect_ratio);
+    bool keep_aspect_ratio, uint8_t pyramid_levels = 0,
+    std::shared_ptr<decoder_settings> settings = nullptr);
+
+// Decoded frames of another process, written with shm_sink on the same node.
+// Waits for the ring to be created and attaches again when the writer restarts.
+// Frames the reader falls behind on are dropped, see shm_frames.h.
+streams::publisher<owned_image_packet> shm_source(const std::string &name,
+                                                  image_pixel_format pixel_format,
+                                                  uint8_t pyramid_levels = 0);
+
+// Writes decoded frames to a shared memory ring, so that several bot processes
+// share the decoder. The ring is removed when the stream completes.
+streams::subscriber<owned_image_packet> &shm_sink(const std::string &name,
+                                                  size_t slots_count);
 
 streams::subscriber<encoded_packet> &rtm_sink(
     const std::shared_ptr<rtm::publisher> &client, boost::asio::io_service &io_service,
@@ -48,9 +94,22 @@ streams::subscriber<encoded_packet> &video_file_sink(
     const boost::optional<std::chrono::system_clock::duration> &segment_duration,
     std::unordered_map<std::string, std::string> &&options);
 
-streams::op<owned_image_packet, encoded_packet> encode_as_mjpeg();
+struct mjpeg_encoder_options {
+  // JPEG quantizer scale 2-31, lower is better quality and bigger snapshots
+  int quality{5};
+  // Frames closer than 1/max_fps seconds to the previous snapshot are dropped,
+  // zero means no limit
+  double max_fps{0};
+};
+
+// Every produced frame is a standalone JPEG image, metadata codec name is "mjpeg"
+streams::op<owned_image_packet, encoded_packet> encode_as_mjpeg(
+    const mjpeg_encoder_options &options = mjpeg_encoder_options{});
 
 streams::op<encoded_packet, encoded_packet> repeat_metadata();
 
+// Passes metadata and key frames only, so that decoder skips all other frames
+streams::op<encoded_packet, encoded_packet> keyframes_only();
+
 }  // namespace video
 }  // namespace satori
@@ -1,11 +1,47 @@
 #pragma once
 
+#include <string>
+
 #include "data.h"
 #include "streams/streams.h"
 
 namespace satori {
 namespace video {
 
+// VP9 encoder parameters, see https://www.webmproject.org/docs/encoder-parameters/
+// Default values keep the behavior encoder had before parameters were exposed.
+struct vp9_encoder_profile {
+  // "realtime", "good" or "best"
+  std::string deadline{"good"};
+  // Trades quality for speed, up to 8 for realtime deadline and up to 5 otherwise
+  int cpu_used{1};
+  // Row based multithreading, lets several threads work within a tile column
+  bool row_mt{false};
+  int threads{4};
+  // log2 of the number of tile columns
+  int tile_columns{6};
+  bool frame_parallel{true};
+  // Alternate reference frames need lag_in_frames > 0
+  bool auto_alt_ref{true};
+  // The upper limit on the number of frames into the future that the encoder can look,
+  // every frame of lag adds a frame of latency
+  uint8_t lag_in_frames{25};
+  // Target bitrate in bits per second, zero together with crf means constant quality
+  int64_t bitrate{10000000};
+  // Constant quality level 0-63, negative value disables it
+  int crf{-1};
+  // Max distance between key frames, in frames
+  int keyframe_interval{12};
+};
+
+// Supported presets are "default", "realtime" for low latency live streams
+// and "archive" for recordings
+vp9_encoder_profile vp9_preset(const std::string &name);
+
+streams::op<owned_image_packet, encoded_packet> encode_vp9(
+    const vp9_encoder_profile &profile);
+
+// Uses default profile with given lag
 streams::op<owned_image_packet, encoded_packet> encode_vp9(uint8_t lag_in_frames);
-}
+}  // namespace video
 }  // namespace satori
@@ -19,6 +19,15 @@ BOOST_AUTO_TEST_CASE(av_pixel_format) {
 
   BOOST_CHECK_EQUAL(AV_PIX_FMT_RGB0,
                     avutils::to_av_pixel_format(image_pixel_format::RGB0));
+
+  BOOST_CHECK_EQUAL(AV_PIX_FMT_GRAY8,
+                    avutils::to_av_pixel_format(image_pixel_format::GRAY8));
+
+  BOOST_CHECK_EQUAL(AV_PIX_FMT_YUV420P,
+                    avutils::to_av_pixel_format(image_pixel_format::YUV420P));
+
+  BOOST_CHECK_EQUAL(AV_PIX_FMT_NV12,
+                    avutils::to_av_pixel_format(image_pixel_format::NV12));
 }
 
 BOOST_AUTO_TEST_CASE(pixel_image_format) {
@@ -27,6 +36,15 @@ BOOST_AUTO_TEST_CASE(pixel_image_format) {
 
   BOOST_CHECK_EQUAL((int)image_pixel_format::RGB0,
                     (int)avutils::to_image_pixel_format(AV_PIX_FMT_RGB0));
+
+  BOOST_CHECK_EQUAL((int)image_pixel_format::GRAY8,
+                    (int)avutils::to_image_pixel_format(AV_PIX_FMT_GRAY8));
+
+  BOOST_CHECK_EQUAL((int)image_pixel_format::YUV420P,
+                    (int)avutils::to_image_pixel_format(AV_PIX_FMT_YUV420P));
+
+  BOOST_CHECK_EQUAL((int)image_pixel_format::NV12,
+                    (int)avutils::to_image_pixel_format(AV_PIX_FMT_NV12));
 }
 
 BOOST_AUTO_TEST_CASE(encoder_context) {
@@ -168,6 +186,26 @@ BOOST_AUTO_TEST_CASE(av_frame_to_image) {
   BOOST_CHECK_EQUAL(0xcd, (uint8_t)frame.plane_data[0][data_size - 1]);
 }
 
+BOOST_AUTO_TEST_CASE(planar_av_frame_to_image) {
+  const int width = 32;
+  const int height = 18;
+
+  std::shared_ptr<AVFrame> av_frame =
+      avutils::av_frame(width, height, 1, AV_PIX_FMT_YUV420P);
+
+  owned_image_frame frame = avutils::to_image_frame(*av_frame);
+
+  BOOST_CHECK_EQUAL((int)image_pixel_format::YUV420P, (int)frame.pixel_format);
+  BOOST_CHECK_EQUAL(width, frame.plane_strides[0]);
+  BOOST_CHECK_EQUAL(width / 2, frame.plane_strides[1]);
+  BOOST_CHECK_EQUAL(width / 2, frame.plane_strides[2]);
+
+  BOOST_CHECK_EQUAL(width * height, frame.plane_data[0].size());
+  BOOST_CHECK_EQUAL(width / 2 * height / 2, frame.plane_data[1].size());
+  BOOST_CHECK_EQUAL(width / 2 * height / 2, frame.plane_data[2].size());
+  BOOST_CHECK_EQUAL(0, frame.plane_data[3].size());
+}
+
 }  // namespace video
 }  // namespace satori
 
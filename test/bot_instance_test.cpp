@@ -100,3 +100,447 @@ BOOST_AUTO_TEST_CASE(basic) {
     BOOST_TEST("dummy-shutdown-value", m.data["dummy-shutdown-key"]);
   }
 }
+
+BOOST_AUTO_TEST_CASE(tune) {
+  std::vector<nlohmann::json> commands;
+
+  sv::multiframe_bot_descriptor descriptor;
+  descriptor.pixel_format = sv::image_pixel_format::RGB0;
+  descriptor.img_callback = [](sv::bot_context &, const gsl::span<sv::image_frame> &) {};
+  descriptor.ctrl_callback = [&commands](sv::bot_context &,
+                                         const nlohmann::json &command) {
+    commands.push_back(command);
+    return nullptr;
+  };
+
+  auto settings = std::make_shared<sv::decoder_settings>();
+  sv::bot_instance bot_instance{"dummy-bot-id", sv::execution_mode::BATCH, descriptor,
+                                settings};
+
+  sv::owned_image_frame small_frame{};
+  small_frame.width = 320;
+  small_frame.height = 240;
+  sv::owned_image_frame large_frame{};
+  large_frame.width = 640;
+  large_frame.height = 480;
+
+  sv::owned_image_packets before_tune;
+  before_tune.push(small_frame);
+  sv::owned_image_packets after_tune;
+  after_tune.push(large_frame);
+
+  std::vector<sv::bot_input> bot_input;
+  bot_input.emplace_back(std::move(before_tune));
+  bot_input.emplace_back(nlohmann::json{
+      {"to", "dummy-bot-id"},
+      {"action", "tune"},
+      {"body", {{"resolution", "640x480"}, {"max_fps", 5}}}});
+  bot_input.emplace_back(std::move(after_tune));
+
+  auto bot_output_stream =
+      sv::streams::publishers::of(std::move(bot_input)) >> bot_instance.run_bot();
+  bot_output_stream->process([](sv::bot_output &&) {});
+
+  BOOST_TEST(settings->version() == 2);
+  BOOST_TEST(settings->bounding_size().is_initialized());
+  BOOST_TEST(settings->bounding_size()->width == 640);
+  BOOST_TEST(settings->bounding_size()->height == 480);
+  BOOST_TEST(settings->max_fps() == 5);
+
+  // tune, image_metadata, shutdown
+  BOOST_REQUIRE_EQUAL(3, commands.size());
+  BOOST_TEST(commands[0]["action"] == "tune");
+  BOOST_TEST(commands[1]["action"] == "image_metadata");
+  BOOST_TEST(commands[1]["body"]["width"] == 640);
+  BOOST_TEST(commands[1]["body"]["height"] == 480);
+  BOOST_TEST(commands[2]["action"] == "shutdown");
+}
+
+BOOST_AUTO_TEST_CASE(tune_bad_input) {
+  sv::multiframe_bot_descriptor descriptor;
+  descriptor.pixel_format = sv::image_pixel_format::RGB0;
+  descriptor.img_callback = [](sv::bot_context &, const gsl::span<sv::image_frame> &) {};
+
+  auto settings = std::make_shared<sv::decoder_settings>();
+  sv::bot_instance bot_instance{"dummy-bot-id", sv::execution_mode::BATCH, descriptor,
+                                settings};
+
+  // control channel input is logged and ignored
+  std::vector<sv::bot_input> bot_input;
+  bot_input.emplace_back(nlohmann::json{
+      {"to", "dummy-bot-id"},
+      {"action", "tune"},
+      {"body", {{"resolution", 640}, {"max_fps", "fast"}}}});
+  bot_input.emplace_back(
+      nlohmann::json{{"to", "dummy-bot-id"}, {"action", "tune"}, {"body", "640x480"}});
+
+  auto bot_output_stream =
+      sv::streams::publishers::of(std::move(bot_input)) >> bot_instance.run_bot();
+  bot_output_stream->process([](sv::bot_output &&) {});
+
+  BOOST_TEST(settings->version() == 0);
+  BOOST_TEST(!settings->bounding_size().is_initialized());
+  BOOST_TEST(settings->max_fps() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(profile_bad_input) {
+  sv::multiframe_bot_descriptor descriptor;
+  descriptor.pixel_format = sv::image_pixel_format::RGB0;
+  descriptor.img_callback = [](sv::bot_context &, const gsl::span<sv::image_frame> &) {};
+
+  sv::bot_instance bot_instance{"dummy-bot-id", sv::execution_mode::BATCH, descriptor};
+
+  std::vector<sv::bot_input> bot_input;
+  bot_input.emplace_back(nlohmann::json{{"to", "dummy-bot-id"},
+                                        {"action", "start_profiling"},
+                                        {"request_id", 1},
+                                        {"body", {{"cpu", "yes"}}}});
+  bot_input.emplace_back(nlohmann::json{
+      {"to", "dummy-bot-id"}, {"action", "start_profiling"}, {"request_id", 2}, {"body", 1}});
+
+  std::vector<nlohmann::json> replies;
+  auto bot_output_stream =
+      sv::streams::publishers::of(std::move(bot_input)) >> bot_instance.run_bot();
+  bot_output_stream->process([&replies](sv::bot_output &&o) {
+    if (auto *m = boost::get<struct sv::bot_message>(&o)) {
+      if (m->kind == sv::bot_message_kind::CONTROL) {
+        replies.push_back(m->data);
+      }
+    }
+  });
+
+  BOOST_REQUIRE_EQUAL(2, replies.size());
+  for (const nlohmann::json &reply : replies) {
+    BOOST_TEST(reply["action"] == "start_profiling");
+    BOOST_TEST(reply.count("error") == 1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(pyramid_change) {
+  std::vector<uint8_t> levels_counts;
+  std::vector<uint16_t> level_widths;
+  int metadata_commands = 0;
+
+  sv::multiframe_bot_descriptor descriptor;
+  descriptor.pixel_format = sv::image_pixel_format::GRAY8;
+  descriptor.img_callback = [&levels_counts, &level_widths](
+                                sv::bot_context &context,
+                                const gsl::span<sv::image_frame> & /*frames*/) {
+    levels_counts.push_back(context.frame_metadata->levels_count);
+    level_widths.push_back(context.frame_metadata->levels[0].width);
+  };
+  descriptor.ctrl_callback = [&metadata_commands](sv::bot_context &,
+                                                  const nlohmann::json &command) {
+    if (command["action"] == "image_metadata") {
+      metadata_commands++;
+    }
+    return nullptr;
+  };
+
+  sv::bot_instance bot_instance{"dummy-bot-id", sv::execution_mode::BATCH, descriptor};
+
+  // frame size is the same, while the region of interest changes the levels
+  sv::owned_image_frame frame{};
+  frame.width = 320;
+  frame.height = 240;
+  auto levels = std::make_shared<std::vector<sv::owned_image_level>>(1);
+  (*levels)[0].width = 160;
+  (*levels)[0].height = 120;
+  frame.levels = levels;
+
+  sv::owned_image_frame cropped_frame = frame;
+  auto cropped_levels = std::make_shared<std::vector<sv::owned_image_level>>(2);
+  (*cropped_levels)[0].width = 80;
+  (*cropped_levels)[0].height = 120;
+  cropped_frame.levels = cropped_levels;
+
+  std::vector<sv::bot_input> bot_input;
+  for (const sv::owned_image_frame &f : {frame, cropped_frame}) {
+    sv::owned_image_packets packets;
+    packets.push(f);
+    bot_input.emplace_back(std::move(packets));
+  }
+
+  auto bot_output_stream =
+      sv::streams::publishers::of(std::move(bot_input)) >> bot_instance.run_bot();
+  bot_output_stream->process([](sv::bot_output &&) {});
+
+  BOOST_REQUIRE_EQUAL(2, levels_counts.size());
+  BOOST_TEST(levels_counts[0] == 1);
+  BOOST_TEST(level_widths[0] == 160);
+  BOOST_TEST(levels_counts[1] == 2);
+  BOOST_TEST(level_widths[1] == 80);
+  BOOST_TEST(metadata_commands == 1);
+}
+
+BOOST_AUTO_TEST_CASE(worker_context) {
+  sv::multiframe_bot_descriptor descriptor;
+  descriptor.pixel_format = sv::image_pixel_format::RGB0;
+  descriptor.img_callback = &::process_image;
+
+  sv::bot_instance bot_instance{"dummy-bot-id", sv::execution_mode::BATCH, descriptor};
+  int data{0};
+  bot_instance.instance_data = &data;
+
+  // lanes run on different threads, so they don't share instance data
+  sv::bot_worker_context worker{bot_instance};
+  BOOST_CHECK(worker.instance_data == nullptr);
+  BOOST_CHECK_EQUAL(bot_instance.frame_metadata, worker.frame_metadata);
+
+  worker.set_current_frame_id({7, 8});
+  sv::bot_message(worker, sv::bot_message_kind::ANALYSIS, {{"key", "value"}});
+  worker.set_current_frame_id({0, 0});
+
+  std::list<struct sv::bot_message> messages = worker.take_messages();
+  BOOST_CHECK_EQUAL(1, messages.size());
+  BOOST_CHECK_EQUAL(7, messages.front().id.i1);
+  BOOST_CHECK_EQUAL(8, messages.front().id.i2);
+  BOOST_TEST(worker.take_messages().empty());
+}
+
+BOOST_AUTO_TEST_CASE(worker_instance_data) {
+  std::vector<int> configured;
+  int released{0};
+
+  sv::multiframe_bot_descriptor descriptor;
+  descriptor.pixel_format = sv::image_pixel_format::RGB0;
+  descriptor.img_callback = [](sv::bot_context &, const gsl::span<sv::image_frame> &) {};
+  descriptor.ctrl_callback = [&configured, &released](sv::bot_context &context,
+                                                      const nlohmann::json &command) {
+    if (command["action"] == "configure") {
+      context.instance_data = new int(static_cast<int>(configured.size()));
+      configured.push_back(command["body"]["key"]);
+      return nlohmann::json{{"configured", true}};
+    }
+    if (command["action"] == "shutdown") {
+      delete static_cast<int *>(context.instance_data);
+      context.instance_data = nullptr;
+      released++;
+    }
+    return nlohmann::json(nullptr);
+  };
+
+  sv::bot_instance bot_instance{"dummy-bot-id", sv::execution_mode::BATCH, descriptor};
+  bot_instance.configure({{"key", 5}});
+
+  // every lane is configured once and gets its own instance data
+  const auto &workers = bot_instance.worker_contexts(2);
+  BOOST_REQUIRE_EQUAL(2, workers.size());
+  BOOST_TEST(&bot_instance.worker_contexts(2) == &workers);
+  BOOST_TEST(configured == std::vector<int>({5, 5, 5}), boost::test_tools::per_element());
+  BOOST_REQUIRE(workers[0]->instance_data != nullptr);
+  BOOST_REQUIRE(workers[1]->instance_data != nullptr);
+  BOOST_TEST(workers[0]->instance_data != bot_instance.instance_data);
+  BOOST_TEST(workers[0]->instance_data != workers[1]->instance_data);
+  BOOST_TEST(workers[0]->take_messages().empty());
+
+  auto bot_output_stream =
+      sv::streams::publishers::empty<sv::bot_input>() >> bot_instance.run_bot();
+  size_t messages{0};
+  bot_output_stream->process([&messages](sv::bot_output &&) { messages++; });
+
+  // configure response of the instance, lanes' responses are not published
+  BOOST_TEST(messages == 1);
+  BOOST_TEST(released == 3);
+  BOOST_TEST(workers[0]->instance_data == nullptr);
+  BOOST_TEST(workers[1]->instance_data == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(frame_times) {
+  const std::chrono::system_clock::time_point capture_time{std::chrono::seconds(10)};
+  const std::chrono::system_clock::time_point arrival_time{std::chrono::seconds(11)};
+
+  std::vector<sv::image_frame> received;
+  sv::multiframe_bot_descriptor descriptor;
+  descriptor.pixel_format = sv::image_pixel_format::RGB0;
+  descriptor.img_callback = [&received](sv::bot_context & /*context*/,
+                                        const gsl::span<sv::image_frame> &frames) {
+    received.insert(received.end(), frames.begin(), frames.end());
+  };
+
+  sv::bot_instance bot_instance{"dummy-bot-id", sv::execution_mode::BATCH, descriptor,
+                                nullptr, "dummy-channel"};
+
+  sv::owned_image_frame frame{};
+  frame.timestamp = capture_time;
+  frame.arrival_time = arrival_time;
+  frame.decode_time = arrival_time + std::chrono::milliseconds(5);
+  sv::owned_image_packets frames;
+  frames.push(frame);
+
+  std::vector<sv::bot_input> bot_input;
+  bot_input.emplace_back(std::move(frames));
+  auto bot_output_stream =
+      sv::streams::publishers::of(std::move(bot_input)) >> bot_instance.run_bot();
+  bot_output_stream->process([](sv::bot_output && /*o*/) {});
+
+  BOOST_REQUIRE_EQUAL(1, received.size());
+  BOOST_TEST((received[0].capture_time == capture_time));
+  BOOST_TEST((received[0].arrival_time == arrival_time));
+}
+
+BOOST_AUTO_TEST_CASE(load) {
+  sv::multiframe_bot_descriptor descriptor;
+  descriptor.pixel_format = sv::image_pixel_format::RGB0;
+  descriptor.img_callback = [](sv::bot_context &context,
+                               const gsl::span<sv::image_frame> &frames) {
+    context.metrics.frames_dropped_total.Increment(frames.size() - 1);
+  };
+
+  sv::bot_instance bot_instance{"dummy-bot-id", sv::execution_mode::BATCH, descriptor,
+                                nullptr, "load-channel"};
+
+  sv::owned_image_packets frames;
+  for (int i = 0; i < 3; i++) {
+    sv::owned_image_frame frame{};
+    frame.plane_data[0] = std::string(100, 'x');
+    frames.push(frame);
+  }
+
+  std::vector<sv::bot_input> bot_input;
+  bot_input.emplace_back(std::move(frames));
+  auto bot_output_stream =
+      sv::streams::publishers::of(std::move(bot_input)) >> bot_instance.run_bot();
+  bot_output_stream->process([](sv::bot_output && /*o*/) {});
+
+  const nlohmann::json load = bot_instance.take_load();
+  BOOST_CHECK_EQUAL(3, load["queue_depth"].get<int>());
+  BOOST_TEST(load["queue_bytes"].get<uint64_t>() >= 300);
+  BOOST_TEST(load["decode_fps"].get<double>() > 0);
+  BOOST_TEST(load["dropped_fps"].get<double>() > 0);
+  BOOST_TEST(load["processing_p95_ms"].get<double>() >= 0);
+
+  const nlohmann::json next = bot_instance.take_load();
+  BOOST_CHECK_EQUAL(0, next["queue_depth"].get<int>());
+  BOOST_CHECK_EQUAL(0, next["dropped_fps"].get<double>());
+}
+
+BOOST_AUTO_TEST_CASE(migration_state) {
+  std::vector<nlohmann::json> commands;
+
+  sv::multiframe_bot_descriptor descriptor;
+  descriptor.pixel_format = sv::image_pixel_format::RGB0;
+  descriptor.img_callback = [](sv::bot_context &, const gsl::span<sv::image_frame> &) {};
+  descriptor.ctrl_callback = [&commands](sv::bot_context &,
+                                         const nlohmann::json &command) -> nlohmann::json {
+    commands.push_back(command);
+    if (command["action"] == "shutdown") {
+      return {{"tracks", 3}};
+    }
+    return nullptr;
+  };
+
+  sv::bot_instance bot_instance{"dummy-bot-id", sv::execution_mode::BATCH, descriptor};
+  bot_instance.configure(nullptr, {{"tracks", 2}});
+
+  BOOST_REQUIRE_EQUAL(1, commands.size());
+  BOOST_TEST(commands[0]["action"] == "configure");
+  BOOST_TEST(commands[0]["body"] == nlohmann::json::object());
+  BOOST_TEST(commands[0]["state"]["tracks"] == 2);
+  BOOST_TEST(bot_instance.shutdown_response().is_null());
+
+  auto bot_output_stream =
+      sv::streams::publishers::of(std::vector<sv::bot_input>{}) >> bot_instance.run_bot();
+  bot_output_stream->process([](sv::bot_output &&) {});
+
+  BOOST_REQUIRE_EQUAL(2, commands.size());
+  BOOST_TEST(commands[1]["action"] == "shutdown");
+  BOOST_TEST(bot_instance.shutdown_response()["tracks"] == 3);
+}
+
+BOOST_AUTO_TEST_CASE(shared_frames) {
+  std::vector<const uint8_t *> received;
+
+  sv::multiframe_bot_descriptor descriptor;
+  descriptor.pixel_format = sv::image_pixel_format::GRAY8;
+  descriptor.img_callback = [&received](sv::bot_context & /*context*/,
+                                        const gsl::span<sv::image_frame> &frames) {
+    received.push_back(frames[0].plane_data[0]);
+  };
+
+  sv::owned_image_frame frame{};
+  frame.width = 10;
+  frame.height = 10;
+  frame.plane_strides[0] = 10;
+  frame.plane_data[0] = std::string(100, 'x');
+  const sv::shared_image_packet packet = std::make_shared<sv::owned_image_packet>(frame);
+
+  // bots of one process get the same decoded frame
+  for (const std::string &name : {"detector", "tracker"}) {
+    sv::bot_instance bot_instance{name, sv::execution_mode::BATCH, descriptor};
+    sv::shared_image_packets frames;
+    frames.push(packet);
+
+    std::vector<sv::bot_input> bot_input;
+    bot_input.emplace_back(std::move(frames));
+    auto bot_output_stream =
+        sv::streams::publishers::of(std::move(bot_input)) >> bot_instance.run_bot();
+    bot_output_stream->process([](sv::bot_output && /*o*/) {});
+  }
+
+  const auto *shared_frame = boost::get<sv::owned_image_frame>(packet.get());
+  BOOST_REQUIRE_EQUAL(2, received.size());
+  BOOST_TEST(received[0] == (const uint8_t *)shared_frame->plane_data[0].data());
+  BOOST_TEST(received[1] == received[0]);
+}
+
+BOOST_AUTO_TEST_CASE(encoded_frames) {
+  struct received_frame {
+    std::string codec_name;
+    std::string data;
+    bool key_frame;
+    int64_t id;
+  };
+  std::vector<received_frame> received;
+
+  sv::multiframe_bot_descriptor descriptor{};
+  sv::bot_instance bot_instance{
+      "encoded-bot-id", sv::execution_mode::BATCH, descriptor, nullptr, "",
+      [&received](sv::bot_context &context, const sv::encoded_stream_metadata &metadata,
+                  const sv::encoded_frame_view &frame) {
+        received.push_back({metadata.codec_name,
+                            std::string((const char *)frame.data, frame.size),
+                            frame.key_frame, frame.id.i1});
+        sv::bot_message(context, sv::bot_message_kind::ANALYSIS, {{"size", frame.size}});
+      }};
+
+  sv::encoded_frame key_frame;
+  key_frame.data = "key";
+  key_frame.id = {1, 1};
+  key_frame.key_frame = true;
+  sv::encoded_frame delta_frame;
+  delta_frame.data = "delta";
+  delta_frame.id = {2, 2};
+
+  sv::encoded_packets packets;
+  packets.push(key_frame);
+  packets.push(sv::encoded_metadata{"h264", "sps"});
+  packets.push(key_frame);
+  packets.push(delta_frame);
+
+  std::vector<sv::bot_input> bot_input;
+  bot_input.emplace_back(std::move(packets));
+  auto bot_output_stream =
+      sv::streams::publishers::of(std::move(bot_input)) >> bot_instance.run_bot();
+
+  std::vector<struct sv::bot_message> messages;
+  bot_output_stream->process([&messages](sv::bot_output &&o) {
+    if (auto *m = boost::get<struct sv::bot_message>(&o)) {
+      messages.push_back(*m);
+    }
+  });
+
+  // metadata is empty until the source sends it
+  BOOST_REQUIRE_EQUAL(3, received.size());
+  BOOST_TEST(received[0].codec_name.empty());
+  BOOST_TEST(received[1].codec_name == "h264");
+  BOOST_TEST(received[1].data == "key");
+  BOOST_TEST(received[1].key_frame);
+  BOOST_TEST(received[2].data == "delta");
+  BOOST_TEST(!received[2].key_frame);
+  BOOST_TEST(received[2].id == 2);
+
+  BOOST_REQUIRE_EQUAL(3, messages.size());
+  BOOST_TEST(messages[2].id.i1 == 2);
+  BOOST_TEST(messages[2].data["size"] == 5);
+}
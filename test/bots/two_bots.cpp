@@ -0,0 +1,40 @@
+#include <satorivideo/video_bot.h>
+
+#include <json.hpp>
+
+namespace sv = satori::video;
+
+namespace two_bots {
+
+void process_first(sv::bot_context &context, const sv::image_frame & /*frame*/) {
+  sv::bot_message(context, sv::bot_message_kind::ANALYSIS, {{"msg", "first_frame"}});
+}
+
+// frames are shared, so the region of the first bot doesn't reach the second one
+nlohmann::json process_first_command(sv::bot_context &context,
+                                     const nlohmann::json &command) {
+  if (command["action"] == "configure") {
+    sv::bot_set_region_of_interest(context, {0, 0, 0.5, 0.5});
+  }
+  return nullptr;
+}
+
+void process_second(sv::bot_context &context, const sv::image_frame & /*frame*/) {
+  sv::bot_message(context, sv::bot_message_kind::ANALYSIS,
+                  {{"msg", "second_frame"}, {"width", context.frame_metadata->width}});
+}
+
+}  // namespace two_bots
+
+int main(int argc, char *argv[]) {
+  sv::bot_descriptor first{sv::image_pixel_format::BGR, &two_bots::process_first,
+                          &two_bots::process_first_command};
+  first.name = "first";
+  sv::bot_register(first);
+
+  sv::bot_descriptor second{sv::image_pixel_format::BGR, &two_bots::process_second};
+  second.name = "second";
+  sv::bot_register(second);
+
+  return sv::bot_main(argc, argv);
+}
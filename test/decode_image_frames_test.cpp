@@ -3,6 +3,7 @@
 #define BOOST_TEST_ALTERNATIVE_INIT_API
 #include <boost/test/included/unit_test.hpp>
 
+#include <cmath>
 #include <fstream>
 #include "avutils.h"
 #include "base64.h"
@@ -177,6 +178,198 @@ BOOST_AUTO_TEST_CASE(id_test) {
   BOOST_TEST(ids[5] == id(6, 6));
 }
 
+BOOST_AUTO_TEST_CASE(pyramid_test) {
+  LOG_SCOPE_FUNCTION(INFO);
+
+  boost::asio::io_service io;
+
+  std::vector<sv::owned_image_frame> frames;
+  auto stream =
+      sv::file_source(io, "test_data/test.mp4", false, true)
+      >> sv::decode_image_frames({320, 240}, sv::image_pixel_format::BGR, true, 2);
+
+  auto when_done = stream->process([&frames](sv::owned_image_packet &&pkt) {
+    if (const sv::owned_image_frame *f = boost::get<sv::owned_image_frame>(&pkt)) {
+      frames.push_back(*f);
+    }
+  });
+  BOOST_TEST(when_done.ok());
+
+  BOOST_TEST(frames.size() == 6);
+  for (const auto &f : frames) {
+    BOOST_TEST(f.width == 320);
+    BOOST_TEST(f.height == 240);
+    BOOST_REQUIRE(f.levels);
+    BOOST_TEST(f.levels->size() == 2);
+    BOOST_TEST((*f.levels)[0].width == 160);
+    BOOST_TEST((*f.levels)[0].height == 120);
+    BOOST_TEST((*f.levels)[1].width == 80);
+    BOOST_TEST((*f.levels)[1].height == 60);
+    BOOST_TEST(!(*f.levels)[1].plane_data[0].empty());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(yuv_passthrough_test) {
+  LOG_SCOPE_FUNCTION(INFO);
+
+  boost::asio::io_service io;
+
+  std::vector<sv::owned_image_frame> frames;
+  auto stream =
+      sv::file_source(io, "test_data/test.mp4", false, true)
+      >> sv::decode_image_frames({-1, -1}, sv::image_pixel_format::YUV420P, true);
+
+  auto when_done = stream->process([&frames](sv::owned_image_packet &&pkt) {
+    if (const sv::owned_image_frame *f = boost::get<sv::owned_image_frame>(&pkt)) {
+      frames.push_back(*f);
+    }
+  });
+  BOOST_TEST(when_done.ok());
+
+  BOOST_TEST(frames.size() == 6);
+  for (const auto &f : frames) {
+    BOOST_TEST((int)f.pixel_format == (int)sv::image_pixel_format::YUV420P);
+    BOOST_TEST(f.width == 640);
+    BOOST_TEST(f.height == 480);
+    BOOST_TEST(f.plane_data[0].size() == f.plane_strides[0] * 480);
+    BOOST_TEST(f.plane_data[1].size() == f.plane_strides[1] * 240);
+    BOOST_TEST(f.plane_data[2].size() == f.plane_strides[2] * 240);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(gray_test) {
+  LOG_SCOPE_FUNCTION(INFO);
+
+  boost::asio::io_service io;
+
+  std::vector<sv::owned_image_frame> frames;
+  auto stream = sv::file_source(io, "test_data/test.mp4", false, true)
+                >> sv::decode_image_frames({320, 240}, sv::image_pixel_format::GRAY8, true);
+
+  auto when_done = stream->process([&frames](sv::owned_image_packet &&pkt) {
+    if (const sv::owned_image_frame *f = boost::get<sv::owned_image_frame>(&pkt)) {
+      frames.push_back(*f);
+    }
+  });
+  BOOST_TEST(when_done.ok());
+
+  BOOST_TEST(frames.size() == 6);
+  for (const auto &f : frames) {
+    BOOST_TEST((int)f.pixel_format == (int)sv::image_pixel_format::GRAY8);
+    BOOST_TEST(f.width == 320);
+    BOOST_TEST(f.height == 240);
+    BOOST_TEST(f.plane_data[1].empty());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(region_of_interest_test) {
+  LOG_SCOPE_FUNCTION(INFO);
+
+  boost::asio::io_service io;
+
+  auto settings = std::make_shared<sv::decoder_settings>(sv::image_region{0.5, 0, 0.5, 1});
+  std::vector<sv::owned_image_frame> frames;
+  auto stream = sv::file_source(io, "test_data/test.mp4", false, true)
+                >> sv::decode_image_frames({-1, -1}, sv::image_pixel_format::BGR, true, 0,
+                                           settings);
+
+  auto when_done =
+      stream->process([&frames, &settings](sv::owned_image_packet &&pkt) {
+        if (const sv::owned_image_frame *f = boost::get<sv::owned_image_frame>(&pkt)) {
+          frames.push_back(*f);
+          if (frames.size() == 3) {
+            settings->set_region_of_interest({0.25, 0.25, 0.5, 0.5});
+          }
+        }
+      });
+  BOOST_TEST(when_done.ok());
+
+  BOOST_TEST(frames.size() == 6);
+  for (size_t i = 0; i < frames.size(); i++) {
+    const sv::owned_image_frame &f = frames[i];
+    BOOST_TEST(f.width == 320);
+    BOOST_TEST(f.height == (i < 3 ? 480 : 240));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(empty_region_of_interest_test) {
+  sv::decoder_settings settings{sv::image_region{0.5, 0, 0.5, 1}};
+
+  // regions without area are ignored, the previous one is kept
+  settings.set_region_of_interest({0, 0, 0, 1});
+  settings.set_region_of_interest({0.25, 0, -0.5, 1});
+  settings.set_region_of_interest({1, 0, 0.5, 1});
+  settings.set_region_of_interest({0, 0, 1, std::nan("")});
+
+  BOOST_TEST(settings.version() == 0);
+  BOOST_TEST(settings.region_of_interest().x == 0.5);
+  BOOST_TEST(settings.region_of_interest().width == 0.5);
+
+  settings.set_region_of_interest({0.25, 0.25, 2, 2});
+  BOOST_TEST(settings.version() == 1);
+  BOOST_TEST(settings.region_of_interest().width == 0.75);
+  BOOST_TEST(settings.region_of_interest().height == 0.75);
+}
+
+BOOST_AUTO_TEST_CASE(bounding_size_change_test) {
+  LOG_SCOPE_FUNCTION(INFO);
+
+  boost::asio::io_service io;
+
+  auto settings = std::make_shared<sv::decoder_settings>();
+  std::vector<sv::owned_image_frame> frames;
+  auto stream = sv::file_source(io, "test_data/test.mp4", false, true)
+                >> sv::decode_image_frames({320, 240}, sv::image_pixel_format::BGR, true,
+                                           2, settings);
+
+  auto when_done =
+      stream->process([&frames, &settings](sv::owned_image_packet &&pkt) {
+        if (const sv::owned_image_frame *f = boost::get<sv::owned_image_frame>(&pkt)) {
+          frames.push_back(*f);
+          if (frames.size() == 2) {
+            settings->set_bounding_size({160, 120});
+          }
+        }
+      });
+  BOOST_TEST(when_done.ok());
+
+  BOOST_TEST(frames.size() == 6);
+  for (size_t i = 0; i < frames.size(); i++) {
+    const sv::owned_image_frame &f = frames[i];
+    BOOST_TEST(f.width == (i < 2 ? 320 : 160));
+    BOOST_TEST(f.height == (i < 2 ? 240 : 120));
+    BOOST_TEST((*f.levels)[0].width == f.width / 2);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(max_fps_test) {
+  LOG_SCOPE_FUNCTION(INFO);
+
+  boost::asio::io_service io;
+
+  auto settings = std::make_shared<sv::decoder_settings>();
+  settings->set_max_fps(1000);
+
+  std::vector<sv::owned_image_frame> frames;
+  auto stream = sv::file_source(io, "test_data/test.mp4", false, true)
+                >> sv::decode_image_frames({320, 240}, sv::image_pixel_format::BGR, true,
+                                           0, settings);
+
+  auto when_done =
+      stream->process([&frames, &settings](sv::owned_image_packet &&pkt) {
+        if (const sv::owned_image_frame *f = boost::get<sv::owned_image_frame>(&pkt)) {
+          frames.push_back(*f);
+          if (frames.size() == 2) {
+            settings->set_max_fps(0.001);
+          }
+        }
+      });
+  BOOST_TEST(when_done.ok());
+
+  // the rest of the file fits into a single interval
+  BOOST_TEST(frames.size() == 3);
+}
+
 int main(int argc, char *argv[]) {
   sv::init_logging(argc, argv);
   return boost::unit_test::unit_test_main(init_unit_test, argc, argv);
@@ -0,0 +1,64 @@
+#define BOOST_TEST_MODULE H264EncoderTest
+#include <boost/test/included/unit_test.hpp>
+
+#include "avutils.h"
+#include "h264_encoder.h"
+#include "logging.h"
+
+using namespace satori::video;
+
+BOOST_AUTO_TEST_CASE(h264_encoder) {
+  avutils::init();
+  if (avcodec_find_encoder_by_name("libx264") == nullptr) {
+    BOOST_TEST_MESSAGE("libx264 is not available, skipping");
+    return;
+  }
+
+  h264_encoder_profile profile;
+  profile.keyframe_interval = 10;
+
+  const int number_of_frames = 30;
+  const int width = 16;
+  const int height = 8;
+  auto frames =
+      streams::publishers::range(0, number_of_frames) >> streams::map([](int i) {
+        owned_image_frame f;
+        f.id = {i, i};
+        f.pixel_format = image_pixel_format::YUV420P;
+        f.width = width;
+        f.height = height;
+        f.plane_strides[0] = width;
+        f.plane_strides[1] = width / 2;
+        f.plane_strides[2] = width / 2;
+        f.plane_data[0] = std::string(width * height, static_cast<char>(i * 8));
+        f.plane_data[1] = std::string(width * height / 4, static_cast<char>(0x80));
+        f.plane_data[2] = std::string(width * height / 4, static_cast<char>(0x80));
+        return owned_image_packet{f};
+      });
+
+  int metadata_count{0};
+  int frames_count{0};
+  int frames_from_last_key_frame_count{0};
+  auto encoded_stream = std::move(frames) >> encode_h264(profile);
+  auto when_done = encoded_stream->process([&metadata_count, &frames_count,
+                                            &frames_from_last_key_frame_count,
+                                            &profile](encoded_packet &&packet) {
+    if (const encoded_metadata *m = boost::get<encoded_metadata>(&packet)) {
+      BOOST_CHECK_EQUAL("h264", m->codec_name);
+      // SPS and PPS
+      BOOST_TEST(!m->codec_data.empty());
+      metadata_count++;
+    } else if (const encoded_frame *f = boost::get<encoded_frame>(&packet)) {
+      if (f->key_frame) {
+        BOOST_TEST(frames_from_last_key_frame_count <= profile.keyframe_interval);
+        frames_from_last_key_frame_count = 0;
+      }
+      frames_from_last_key_frame_count++;
+      frames_count++;
+    }
+  });
+  BOOST_CHECK(when_done.ok());
+
+  BOOST_CHECK_EQUAL(1, metadata_count);
+  BOOST_CHECK_EQUAL(number_of_frames, frames_count);
+}
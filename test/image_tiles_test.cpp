@@ -0,0 +1,94 @@
+#define BOOST_TEST_MODULE ImageTilesTest
+#include <boost/test/included/unit_test.hpp>
+
+#include <string>
+
+#include "image_tiles.h"
+
+namespace sv = satori::video;
+
+BOOST_AUTO_TEST_CASE(split_without_overlap) {
+  sv::image_tiling tiling;
+  tiling.columns = 3;
+  tiling.rows = 2;
+  const std::vector<sv::tile_rect> rects = sv::split_into_tiles(100, 50, tiling);
+
+  BOOST_CHECK_EQUAL(6, rects.size());
+  int area = 0;
+  for (const auto &r : rects) {
+    area += r.width * r.height;
+  }
+  BOOST_CHECK_EQUAL(100 * 50, area);
+
+  // row by row
+  BOOST_CHECK_EQUAL(0, rects[0].x);
+  BOOST_CHECK_EQUAL(33, rects[1].x);
+  BOOST_CHECK_EQUAL(0, rects[3].x);
+  BOOST_CHECK_EQUAL(25, rects[3].y);
+  BOOST_CHECK_EQUAL(100, rects[2].x + rects[2].width);
+  BOOST_CHECK_EQUAL(50, rects[5].y + rects[5].height);
+}
+
+BOOST_AUTO_TEST_CASE(split_with_overlap_and_alignment) {
+  sv::image_tiling tiling;
+  tiling.columns = 2;
+  tiling.rows = 1;
+  tiling.overlap = 5;
+  const std::vector<sv::tile_rect> rects = sv::split_into_tiles(101, 20, tiling, 2);
+
+  BOOST_CHECK_EQUAL(2, rects.size());
+  BOOST_CHECK_EQUAL(0, rects[0].x);
+  BOOST_CHECK_EQUAL(55, rects[0].width);
+  BOOST_CHECK_EQUAL(44, rects[1].x);
+  BOOST_CHECK_EQUAL(101, rects[1].x + rects[1].width);
+  BOOST_CHECK_EQUAL(20, rects[1].height);
+}
+
+BOOST_AUTO_TEST_CASE(yuv420p_tiles) {
+  const int width = 16;
+  const int height = 8;
+  const int stride = 32;  // wider than the image, like in decoded frames
+
+  std::string y(stride * height, 0);
+  std::string u(stride * height / 2, 0);
+  std::string v(stride * height / 2, 0);
+  for (int row = 0; row < height; row++) {
+    for (int col = 0; col < width; col++) {
+      y[row * stride + col] = static_cast<char>(row * width + col);
+    }
+  }
+  for (int row = 0; row < height / 2; row++) {
+    for (int col = 0; col < width / 2; col++) {
+      u[row * stride + col] = static_cast<char>(row * width / 2 + col);
+    }
+  }
+
+  sv::image_frame frame;
+  frame.plane_data[0] = reinterpret_cast<const uint8_t *>(y.data());
+  frame.plane_data[1] = reinterpret_cast<const uint8_t *>(u.data());
+  frame.plane_data[2] = reinterpret_cast<const uint8_t *>(v.data());
+  frame.plane_data[3] = nullptr;
+
+  sv::image_metadata metadata{width, height, {stride, stride, stride, 0}, 0};
+
+  sv::image_tiling tiling;
+  tiling.columns = 2;
+  tiling.rows = 2;
+
+  // Boost.Test is not thread safe, so results are checked after all tiles are done
+  std::vector<sv::image_tile> tiles(4);
+  sv::process_tiles(frame, metadata, sv::image_pixel_format::YUV420P, tiling,
+                    [&tiles](const sv::image_tile &tile) { tiles[tile.index] = tile; });
+
+  for (int i = 0; i < 4; i++) {
+    const sv::image_tile &tile = tiles[i];
+    BOOST_CHECK_EQUAL(i, tile.index);
+    BOOST_CHECK_EQUAL(8, tile.width);
+    BOOST_CHECK_EQUAL(4, tile.height);
+    // top-left pixels of the tile
+    BOOST_CHECK_EQUAL(tile.y * width + tile.x, (int)tile.plane_data[0][0]);
+    BOOST_CHECK_EQUAL(tile.y / 2 * width / 2 + tile.x / 2, (int)tile.plane_data[1][0]);
+  }
+  BOOST_CHECK_EQUAL(8, tiles[3].x);
+  BOOST_CHECK_EQUAL(4, tiles[3].y);
+}
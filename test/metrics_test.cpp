@@ -0,0 +1,43 @@
+#define BOOST_TEST_MODULE MetricsTest
+#include <boost/test/included/unit_test.hpp>
+
+#include "metrics.h"
+
+namespace sv = satori::video;
+
+BOOST_AUTO_TEST_CASE(metric_cache_resolves_labels_once) {
+  prometheus::Registry registry;
+  auto &family = prometheus::BuildCounter().Name("test_total").Register(registry);
+  sv::metric_cache<prometheus::Counter> cache{family, "channel", {{"id", "bot"}}};
+
+  prometheus::Counter &a = cache.get("a");
+  BOOST_CHECK_EQUAL(&a, &cache.get("a"));
+  BOOST_CHECK_NE(&a, &cache.get("b"));
+  BOOST_CHECK_EQUAL(&a, &family.Add({{"channel", "a"}, {"id", "bot"}}));
+
+  cache.get("a").Increment(3);
+  BOOST_CHECK_EQUAL(3, a.Value());
+}
+
+BOOST_AUTO_TEST_CASE(metric_cache_histogram) {
+  prometheus::Registry registry;
+  auto &family = prometheus::BuildHistogram().Name("test_millis").Register(registry);
+  sv::metric_cache<prometheus::Histogram> cache{family, "stage"};
+
+  prometheus::Histogram &h = cache.get("decode", std::vector<double>{1, 10});
+  BOOST_CHECK_EQUAL(&h, &cache.get("decode", std::vector<double>{1, 10}));
+}
+
+BOOST_AUTO_TEST_CASE(log_linear_buckets) {
+  const std::vector<double> buckets = sv::log_linear_buckets(1, 1000, 9);
+  const std::vector<double> expected = {0,  1,  2,  3,  4,   5,   6,   7,   8,   9,
+                                        10, 20, 30, 40, 50,  60,  70,  80,  90,  100,
+                                        200, 300, 400, 500, 600, 700, 800, 900, 1000};
+  BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), buckets.begin(),
+                                buckets.end());
+
+  const std::vector<double> coarse = sv::log_linear_buckets(10, 1000, 2);
+  const std::vector<double> expected_coarse = {0, 10, 55, 100, 550, 1000};
+  BOOST_CHECK_EQUAL_COLLECTIONS(expected_coarse.begin(), expected_coarse.end(),
+                                coarse.begin(), coarse.end());
+}
@@ -0,0 +1,105 @@
+#define BOOST_TEST_MODULE MJPEGEncoderTest
+#include <boost/test/included/unit_test.hpp>
+
+#include "video_streams.h"
+
+using namespace satori::video;
+
+namespace {
+
+streams::publisher<owned_image_packet> frames(int number_of_frames,
+                                              std::chrono::milliseconds interval) {
+  return streams::publishers::range(0, number_of_frames)
+         >> streams::map([interval](int i) {
+             const int width = 8;
+             const int height = 8;
+             owned_image_frame f;
+             f.id = {i, i};
+             f.timestamp = std::chrono::system_clock::time_point{} + i * interval;
+             f.pixel_format = image_pixel_format::RGB0;
+             f.width = width;
+             f.height = height;
+             f.plane_data[0] = std::string(width * height * 3, static_cast<char>(i));
+             f.plane_strides[0] = width * 3;
+             return owned_image_packet{f};
+           });
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(mjpeg_encoder) {
+  const int number_of_frames = 10;
+
+  int metadata_count{0};
+  int frames_count{0};
+  auto encoded_stream =
+      frames(number_of_frames, std::chrono::milliseconds(10)) >> encode_as_mjpeg();
+  auto when_done = encoded_stream->process(
+      [&metadata_count, &frames_count](encoded_packet &&packet) {
+        if (const encoded_metadata *m = boost::get<encoded_metadata>(&packet)) {
+          BOOST_CHECK_EQUAL("mjpeg", m->codec_name);
+          metadata_count++;
+        } else if (const encoded_frame *f = boost::get<encoded_frame>(&packet)) {
+          BOOST_TEST(f->key_frame);
+          // JPEG start of image marker
+          BOOST_TEST(f->data.size() > 2);
+          BOOST_CHECK_EQUAL(0xff, (uint8_t)f->data[0]);
+          BOOST_CHECK_EQUAL(0xd8, (uint8_t)f->data[1]);
+          frames_count++;
+        }
+      });
+  BOOST_CHECK(when_done.ok());
+
+  BOOST_CHECK_EQUAL(1, metadata_count);
+  BOOST_CHECK_EQUAL(number_of_frames, frames_count);
+}
+
+BOOST_AUTO_TEST_CASE(mjpeg_encoder_rate_limit) {
+  mjpeg_encoder_options options;
+  options.quality = 10;
+  options.max_fps = 20;
+
+  std::vector<int64_t> ids;
+  auto encoded_stream =
+      frames(10, std::chrono::milliseconds(10)) >> encode_as_mjpeg(options);
+  auto when_done = encoded_stream->process([&ids](encoded_packet &&packet) {
+    if (const encoded_frame *f = boost::get<encoded_frame>(&packet)) {
+      ids.push_back(f->id.i1);
+    }
+  });
+  BOOST_CHECK(when_done.ok());
+
+  // one snapshot per 50 milliseconds
+  BOOST_CHECK_EQUAL(2, ids.size());
+  BOOST_CHECK_EQUAL(0, ids[0]);
+  BOOST_CHECK_EQUAL(5, ids[1]);
+}
+
+BOOST_AUTO_TEST_CASE(keyframes_only_test) {
+  std::vector<encoded_packet> packets;
+  packets.emplace_back(encoded_metadata{});
+  for (int i = 0; i < 6; i++) {
+    encoded_frame f;
+    f.id = {i, i};
+    f.key_frame = (i % 3 == 0);
+    packets.emplace_back(std::move(f));
+  }
+
+  int metadata_count{0};
+  std::vector<int64_t> ids;
+  auto when_done =
+      (streams::publishers::of(std::move(packets)) >> keyframes_only())
+          ->process([&metadata_count, &ids](encoded_packet &&packet) {
+            if (const encoded_frame *f = boost::get<encoded_frame>(&packet)) {
+              ids.push_back(f->id.i1);
+            } else {
+              metadata_count++;
+            }
+          });
+  BOOST_CHECK(when_done.ok());
+
+  BOOST_CHECK_EQUAL(1, metadata_count);
+  BOOST_CHECK_EQUAL(2, ids.size());
+  BOOST_CHECK_EQUAL(0, ids[0]);
+  BOOST_CHECK_EQUAL(3, ids[1]);
+}
@@ -0,0 +1,38 @@
+#define BOOST_TEST_MODULE PoolControllerTest
+#include <boost/test/included/unit_test.hpp>
+
+#include "pool_controller.h"
+
+namespace sv = satori::video;
+
+BOOST_AUTO_TEST_CASE(capacity_without_resources) {
+  sv::pool_resource_model model;
+  model.max_jobs = 5;
+  BOOST_CHECK_EQUAL(5, sv::available_capacity(model, 0, {400, 1 << 30}));
+  BOOST_CHECK_EQUAL(2, sv::available_capacity(model, 3, {400, 1 << 30}));
+  BOOST_CHECK_EQUAL(0, sv::available_capacity(model, 5, {0, 0}));
+}
+
+BOOST_AUTO_TEST_CASE(capacity_from_measured_jobs) {
+  sv::pool_resource_model model;
+  model.max_jobs = 10;
+  model.cpu_percent = 400;
+
+  // two heavy jobs take 150% each, no more fit
+  BOOST_CHECK_EQUAL(0, sv::available_capacity(model, 2, {300, 0}));
+  BOOST_CHECK_EQUAL(1, sv::available_capacity(model, 2, {250, 0}));
+  // two light jobs take 20% each
+  BOOST_CHECK_EQUAL(8, sv::available_capacity(model, 2, {40, 0}));
+  // usage over the budget
+  BOOST_CHECK_EQUAL(0, sv::available_capacity(model, 2, {500, 0}));
+}
+
+BOOST_AUTO_TEST_CASE(capacity_from_expected_cost) {
+  sv::pool_resource_model model;
+  model.max_jobs = 10;
+  model.memory_bytes = 1000;
+  model.job_memory_bytes = 300;
+
+  BOOST_CHECK_EQUAL(3, sv::available_capacity(model, 0, {0, 0}));
+  BOOST_CHECK_EQUAL(2, sv::available_capacity(model, 0, {0, 200}));
+}
@@ -0,0 +1,105 @@
+#define BOOST_TEST_MODULE ResourceGovernorTest
+#include <boost/test/included/unit_test.hpp>
+
+#include "data.h"
+#include "resource_governor.h"
+#include "streams/streams.h"
+#include "streams/threaded_worker.h"
+
+namespace sv = satori::video;
+namespace rg = satori::video::resource_governor;
+
+namespace {
+
+void relax_to_normal(const rg::budget &b) {
+  while (rg::current_level() != rg::level::NORMAL) {
+    rg::evaluate(b, {0, 0});
+  }
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(escalation_and_relaxing) {
+  rg::budget b;
+  b.max_bytes = 1000;
+  b.max_cpu_percent = 100;
+
+  BOOST_CHECK(rg::level::NORMAL == rg::evaluate(b, {1000, 100}));
+  BOOST_CHECK(rg::level::KEYFRAMES_ONLY == rg::evaluate(b, {1001, 0}));
+  BOOST_CHECK(rg::level::DROP_OLDEST == rg::evaluate(b, {0, 150}));
+  BOOST_CHECK(rg::level::REFUSE_JOBS == rg::evaluate(b, {2000, 0}));
+  BOOST_CHECK(rg::level::REFUSE_JOBS == rg::evaluate(b, {2000, 0}));
+  BOOST_CHECK(rg::level::REFUSE_JOBS == rg::current_level());
+
+  // between 80% and 100% of the budget the level holds
+  for (int i = 0; i < 2 * rg::calm_periods_to_relax; i++) {
+    BOOST_CHECK(rg::level::REFUSE_JOBS == rg::evaluate(b, {900, 0}));
+  }
+
+  for (int i = 1; i < rg::calm_periods_to_relax; i++) {
+    BOOST_CHECK(rg::level::REFUSE_JOBS == rg::evaluate(b, {100, 10}));
+  }
+  BOOST_CHECK(rg::level::DROP_OLDEST == rg::evaluate(b, {100, 10}));
+
+  relax_to_normal(b);
+}
+
+BOOST_AUTO_TEST_CASE(no_limits) {
+  rg::budget b;
+  BOOST_CHECK(rg::level::NORMAL == rg::evaluate(b, {1 << 30, 1000}));
+}
+
+BOOST_AUTO_TEST_CASE(byte_sizes) {
+  sv::encoded_frame f;
+  f.data = std::string(1000, 'x');
+  BOOST_TEST(rg::byte_size<sv::encoded_packet>{}(sv::encoded_packet{f}) >= 1000);
+
+  sv::owned_image_frame image;
+  image.plane_data[0] = std::string(300, 'y');
+  image.plane_data[1] = std::string(200, 'u');
+  BOOST_TEST(rg::byte_size<sv::owned_image_packet>{}(sv::owned_image_packet{image})
+             >= 500);
+
+  BOOST_CHECK_EQUAL(sizeof(int), rg::byte_size<int>{}(1));
+}
+
+BOOST_AUTO_TEST_CASE(worker_queue_accounting) {
+  const int64_t before = rg::buffered_bytes();
+  std::vector<sv::encoded_packet> items;
+  for (int i = 0; i < 10; i++) {
+    sv::encoded_frame f;
+    f.data = std::string(1000, 'x');
+    items.emplace_back(f);
+  }
+
+  size_t received = 0;
+  auto p = sv::streams::publishers::of(std::move(items))
+           >> sv::streams::threaded_worker("test_worker") >> sv::streams::flatten();
+  auto when_done = p->process([&received](sv::encoded_packet && /*pkt*/) { received++; });
+  while (!when_done.resolved()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  // worker thread releases its queue after the stream is complete
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  BOOST_CHECK_EQUAL(10, received);
+  BOOST_CHECK_EQUAL(before, rg::buffered_bytes());
+}
+
+BOOST_AUTO_TEST_CASE(shared_packet_accounting) {
+  const int64_t before = rg::buffered_bytes();
+  sv::owned_image_frame image;
+  image.plane_data[0] = std::string(10000, 'y');
+  const int64_t size = rg::byte_size<sv::owned_image_packet>{}(image);
+
+  sv::shared_image_packet packet = sv::share_image_packet(image);
+  std::vector<sv::shared_image_packet> copies(3, packet);
+  // queues of several bots hold the same packet, it counts once
+  BOOST_CHECK_EQUAL(before + size, rg::buffered_bytes());
+  BOOST_TEST(rg::byte_size<sv::shared_image_packet>{}(packet) < 100);
+
+  packet.reset();
+  copies.resize(1);
+  BOOST_CHECK_EQUAL(before + size, rg::buffered_bytes());
+  copies.clear();
+  BOOST_CHECK_EQUAL(before, rg::buffered_bytes());
+}
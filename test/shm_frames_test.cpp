@@ -0,0 +1,140 @@
+#define BOOST_TEST_MODULE ShmFramesTest
+#include <boost/test/included/unit_test.hpp>
+
+#include <unistd.h>
+
+#include "data.h"
+#include "shm_frames.h"
+
+namespace sv = satori::video;
+namespace shm = satori::video::shm_frames;
+
+namespace {
+
+constexpr std::chrono::milliseconds no_wait{0};
+
+std::string ring_name(const std::string &test) {
+  return "shm_frames_test_" + test + "_" + std::to_string(getpid());
+}
+
+sv::owned_image_frame make_frame(int64_t i, uint8_t levels = 0) {
+  sv::owned_image_frame frame{};
+  frame.id = {i, i};
+  frame.pixel_format = sv::image_pixel_format::GRAY8;
+  frame.width = 4;
+  frame.height = 2;
+  frame.plane_strides[0] = 4;
+  frame.plane_data[0] = std::string(8, static_cast<char>(i));
+  frame.timestamp = std::chrono::system_clock::time_point{std::chrono::seconds{i}};
+  if (levels > 0) {
+    auto l = std::make_shared<std::vector<sv::owned_image_level>>(levels);
+    for (auto &level : *l) {
+      level.width = 2;
+      level.height = 1;
+      level.plane_strides[0] = 2;
+      level.plane_data[0] = std::string(2, static_cast<char>(i));
+    }
+    frame.levels = l;
+  }
+  return frame;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(write_and_read) {
+  const std::string name = ring_name("write_and_read");
+  shm::writer w{name, 4};
+  BOOST_CHECK(!shm::reader::open(name));
+
+  BOOST_TEST(w.write(make_frame(1, 2)));
+  auto r = shm::reader::open(name);
+  BOOST_REQUIRE(r);
+  BOOST_TEST(w.readers_count() == 1);
+
+  sv::owned_image_frame frame;
+  BOOST_TEST((r->read(frame, no_wait) == shm::read_status::TIMEOUT));
+
+  BOOST_TEST(w.write(make_frame(2, 2)));
+  BOOST_TEST(w.max_reader_lag() == 1);
+  BOOST_TEST((r->read(frame, no_wait) == shm::read_status::FRAME));
+  BOOST_TEST(w.max_reader_lag() == 0);
+  BOOST_TEST(frame.id.i1 == 2);
+  BOOST_TEST((frame.pixel_format == sv::image_pixel_format::GRAY8));
+  BOOST_TEST(frame.width == 4);
+  BOOST_TEST(frame.height == 2);
+  BOOST_TEST(frame.plane_strides[0] == 4);
+  BOOST_TEST(frame.plane_data[0] == std::string(8, 2));
+  BOOST_TEST(frame.plane_data[1].empty());
+  BOOST_TEST((frame.timestamp
+              == std::chrono::system_clock::time_point{std::chrono::seconds{2}}));
+  BOOST_REQUIRE(frame.levels);
+  BOOST_TEST(frame.levels->size() == 2);
+  BOOST_TEST((*frame.levels)[1].plane_data[0] == std::string(2, 2));
+
+  r.reset();
+  BOOST_TEST(w.readers_count() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(slow_reader_skips_frames) {
+  const std::string name = ring_name("slow_reader");
+  shm::writer w{name, 4};
+  BOOST_TEST(w.write(make_frame(1)));
+  auto r = shm::reader::open(name);
+  BOOST_REQUIRE(r);
+
+  for (int64_t i = 2; i <= 11; i++) {
+    BOOST_TEST(w.write(make_frame(i)));
+  }
+
+  // the ring keeps 3 frames readable while the 4th slot is being overwritten
+  sv::owned_image_frame frame;
+  for (int64_t i = 9; i <= 11; i++) {
+    BOOST_TEST((r->read(frame, no_wait) == shm::read_status::FRAME));
+    BOOST_TEST(frame.id.i1 == i);
+  }
+  BOOST_TEST(r->dropped() == 7);
+  BOOST_TEST((r->read(frame, no_wait) == shm::read_status::TIMEOUT));
+}
+
+BOOST_AUTO_TEST_CASE(oversized_frame) {
+  const std::string name = ring_name("oversized");
+  shm::writer w{name, 2};
+  BOOST_TEST(w.write(make_frame(1)));
+  BOOST_TEST(!w.write(make_frame(2, 1)));
+}
+
+BOOST_AUTO_TEST_CASE(closed_and_replaced) {
+  const std::string name = ring_name("closed");
+  auto w = std::make_unique<shm::writer>(name, 2);
+  BOOST_TEST(w->write(make_frame(1)));
+  auto r = shm::reader::open(name);
+  BOOST_REQUIRE(r);
+
+  w.reset();
+  sv::owned_image_frame frame;
+  BOOST_TEST((r->read(frame, no_wait) == shm::read_status::CLOSED));
+
+  w = std::make_unique<shm::writer>(name, 2);
+  BOOST_TEST(w->write(make_frame(1)));
+  r = shm::reader::open(name);
+  BOOST_REQUIRE(r);
+
+  // a crashed writer is replaced without closing the ring
+  shm::writer next{name, 2};
+  BOOST_TEST(next.write(make_frame(1)));
+  BOOST_TEST((r->read(frame, no_wait) == shm::read_status::CLOSED));
+}
+
+BOOST_AUTO_TEST_CASE(readers_limit) {
+  const std::string name = ring_name("readers_limit");
+  shm::writer w{name, 2};
+  BOOST_TEST(w.write(make_frame(1)));
+
+  std::vector<std::unique_ptr<shm::reader>> readers;
+  for (size_t i = 0; i < shm::max_readers; i++) {
+    readers.push_back(shm::reader::open(name));
+    BOOST_REQUIRE(readers.back());
+  }
+  BOOST_TEST(w.readers_count() == shm::max_readers);
+  BOOST_CHECK(!shm::reader::open(name));
+}
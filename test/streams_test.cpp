@@ -12,6 +12,8 @@
 
 #include "logging_impl.h"
 #include "streams/asio_streams.h"
+#include "streams/broadcast.h"
+#include "streams/manual_breaker.h"
 #include "streams/streams.h"
 #include "streams/threaded_worker.h"
 
@@ -271,6 +273,58 @@ BOOST_AUTO_TEST_CASE(delay_finally) {
   BOOST_TEST(terminated);
 }
 
+BOOST_AUTO_TEST_CASE(manual_breaker) {
+  boost::asio::io_service io_service;
+  bool terminated = false;
+  auto handle = std::make_shared<streams::breaker_handle>();
+  auto p = streams::publishers::range(1, 300000000)
+           >> streams::asio::interval<int>(io_service, 5ms)
+           >> streams::do_finally([&terminated]() { terminated = true; })
+           >> streams::manual_breaker(handle);
+
+  auto when_done = p->process([&io_service, handle](int &&i) {
+    if (i == 3) {
+      // breaking from outside of the stream delivery, like bot_environment does
+      io_service.post([handle]() { handle->trigger(); });
+    }
+  });
+  run_wait(io_service, when_done);
+
+  BOOST_TEST(when_done.ok());
+  BOOST_TEST(terminated);
+
+  // no-op once the stream is finished
+  handle->trigger();
+}
+
+BOOST_AUTO_TEST_CASE(manual_breaker_drains_worker) {
+  boost::asio::io_service io_service;
+  auto handle = std::make_shared<streams::breaker_handle>();
+  std::vector<int> queued;
+  std::vector<int> delivered;
+  auto p = streams::publishers::range(1, 300000000)
+           >> streams::asio::interval<int>(io_service, 1ms)
+           >> streams::manual_breaker(handle) >> streams::map([&queued](int &&i) {
+               queued.push_back(i);
+               return i;
+             })
+           >> streams::threaded_worker("test-drain") >> streams::flatten();
+
+  auto when_done = p->process([&io_service, handle, &delivered](int &&i) {
+    delivered.push_back(i);
+    if (i == 3) {
+      io_service.post([handle]() { handle->trigger(); });
+    }
+    // slow consumer, so that elements pile up in the worker queue
+    std::this_thread::sleep_for(10ms);
+  });
+  run_wait(io_service, when_done);
+
+  BOOST_TEST(when_done.ok());
+  BOOST_TEST(queued.size() > 3);
+  BOOST_TEST(delivered == queued);
+}
+
 template <typename T>
 struct collector_sink : public streams::subscriber<T> {
   void on_next(T &&t) override {
@@ -375,6 +429,66 @@ BOOST_AUTO_TEST_CASE(timeout_err) {
   BOOST_TEST(e == strings({"1", "error:timeout"}));
 }
 
+BOOST_AUTO_TEST_CASE(broadcast) {
+  auto branches = streams::broadcast(streams::publishers::range(1, 5), 2);
+  std::vector<int> first;
+  std::vector<int> second;
+
+  auto first_done = branches[0]->process([&first](int &&i) { first.push_back(i); });
+  // the source waits for all branches
+  BOOST_TEST(first.empty());
+  auto second_done = branches[1]->process([&second](int &&i) { second.push_back(i); });
+
+  BOOST_TEST(first_done.ok());
+  BOOST_TEST(second_done.ok());
+  BOOST_TEST(first == std::vector<int>({1, 2, 3, 4}));
+  BOOST_TEST(second == std::vector<int>({1, 2, 3, 4}));
+}
+
+BOOST_AUTO_TEST_CASE(broadcast_cancel) {
+  bool terminated = false;
+  auto branches = streams::broadcast(
+      streams::publishers::range(1, 300000000)
+          >> streams::do_finally([&terminated]() { terminated = true; }),
+      2);
+  auto first = std::move(branches[0]) >> streams::take(2);
+  auto second = std::move(branches[1]) >> streams::take(3);
+  std::vector<int> first_items;
+  std::vector<int> second_items;
+
+  auto first_done =
+      first->process([&first_items](int &&i) { first_items.push_back(i); });
+  auto second_done =
+      second->process([&second_items](int &&i) { second_items.push_back(i); });
+
+  BOOST_TEST(first_done.ok());
+  BOOST_TEST(second_done.ok());
+  BOOST_TEST(first_items == std::vector<int>({1, 2}));
+  BOOST_TEST(second_items == std::vector<int>({1, 2, 3}));
+  BOOST_TEST(terminated);
+}
+
+BOOST_AUTO_TEST_CASE(broadcast_threaded) {
+  LOG_SCOPE_FUNCTION(INFO);
+  auto branches = streams::broadcast(streams::publishers::range(1, 5), 2);
+  auto first = std::move(branches[0]) >> streams::threaded_worker("test-first")
+               >> streams::flatten();
+  auto second = std::move(branches[1]) >> streams::threaded_worker("test-second")
+                >> streams::flatten();
+  std::vector<int> first_items;
+  std::vector<int> second_items;
+
+  auto first_done =
+      first->process([&first_items](int &&i) { first_items.push_back(i); });
+  auto second_done =
+      second->process([&second_items](int &&i) { second_items.push_back(i); });
+  spin_wait(first_done, 1ms);
+  spin_wait(second_done, 1ms);
+
+  BOOST_TEST(first_items == std::vector<int>({1, 2, 3, 4}));
+  BOOST_TEST(second_items == std::vector<int>({1, 2, 3, 4}));
+}
+
 int main(int argc, char *argv[]) {
   init_logging(argc, argv);
   return boost::unit_test::unit_test_main(init_unit_test, argc, argv);
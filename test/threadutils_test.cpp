@@ -1,6 +1,9 @@
 #define BOOST_TEST_MODULE ThreadUtilsTest
 #include <boost/test/included/unit_test.hpp>
 
+#include <atomic>
+#include <set>
+
 #include "threadutils.h"
 
 namespace sv = satori::video;
@@ -17,3 +20,69 @@ BOOST_AUTO_TEST_CASE(long_name) {
   sv::threadutils::set_current_thread_name("asdfasdfasdfasdf");
   BOOST_CHECK_EQUAL("asdfasdfasdfasd", sv::threadutils::get_current_thread_name());
 }
+
+BOOST_AUTO_TEST_CASE(thread_pool_run) {
+  sv::threadutils::thread_pool pool{"test_pool_", 3};
+  BOOST_CHECK_EQUAL(3, pool.threads_count());
+
+  std::atomic<int> counter{0};
+  std::mutex mutex;
+  std::set<std::thread::id> threads;
+  std::vector<std::function<void()>> tasks;
+  for (int i = 0; i < 100; i++) {
+    tasks.emplace_back([&counter, &mutex, &threads]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      counter++;
+      std::lock_guard<std::mutex> guard(mutex);
+      threads.insert(std::this_thread::get_id());
+    });
+  }
+  pool.run(std::move(tasks));
+
+  BOOST_CHECK_EQUAL(100, counter.load());
+  BOOST_TEST(threads.size() > 1);
+}
+
+BOOST_AUTO_TEST_CASE(thread_pool_without_threads) {
+  // calling thread does all the work
+  sv::threadutils::thread_pool pool{"test_pool_", 0};
+  int counter{0};
+  pool.run({[&counter]() { counter++; }, [&counter]() { counter++; }});
+  BOOST_CHECK_EQUAL(2, counter);
+}
+
+#if defined(__linux__)
+BOOST_AUTO_TEST_CASE(threads_cpu_usage) {
+  std::atomic<bool> named{false};
+  std::atomic<bool> done{false};
+  std::thread t([&named, &done]() {
+    sv::threadutils::set_current_thread_name("busy (test)");
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    named = true;
+    while (!done) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+  while (!named) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  const std::vector<sv::threadutils::thread_cpu_usage> usage =
+      sv::threadutils::get_threads_cpu_usage();
+  done = true;
+  t.join();
+
+  bool found = false;
+  for (const auto &u : usage) {
+    BOOST_TEST(u.tid > 0);
+    BOOST_TEST(u.user_time_sec >= 0);
+    BOOST_TEST(u.system_time_sec >= 0);
+    if (u.name == "busy (test)") {
+      found = true;
+      BOOST_TEST(u.voluntary_context_switches > 0);
+    }
+  }
+  BOOST_TEST(usage.size() >= 2);
+  BOOST_TEST(found);
+}
+#endif
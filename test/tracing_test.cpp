@@ -0,0 +1,80 @@
+#define BOOST_TEST_MODULE TracingTest
+#include <boost/test/included/unit_test.hpp>
+
+#include <fstream>
+#include <json.hpp>
+#include <set>
+#include <thread>
+
+#include "threadutils.h"
+#include "tracing.h"
+
+namespace sv = satori::video;
+
+namespace {
+
+nlohmann::json read_trace(const std::string &filename) {
+  std::ifstream in(filename);
+  return nlohmann::json::parse(in);
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(records_events_of_all_threads) {
+  const std::string filename = "tracing_test.json";
+  sv::tracing::set_output_file(filename);
+
+  { sv::tracing::scope before("not_recorded"); }
+
+  BOOST_TEST(sv::tracing::start(std::chrono::seconds(60)));
+  BOOST_TEST(sv::tracing::is_recording());
+  BOOST_TEST(!sv::tracing::start(std::chrono::seconds(60)));
+
+  sv::threadutils::set_current_thread_name("main_thread");
+  { sv::tracing::scope s("main_scope"); }
+  std::thread t([]() {
+    sv::threadutils::set_current_thread_name("other_thread");
+    sv::tracing::scope s("other_scope");
+    sv::tracing::instant("other_instant");
+  });
+  t.join();
+
+  sv::tracing::stop();
+  BOOST_TEST(!sv::tracing::is_recording());
+  { sv::tracing::scope after("not_recorded"); }
+
+  const nlohmann::json trace = read_trace(filename);
+  std::set<std::string> names;
+  std::set<std::string> thread_names;
+  for (const auto &e : trace["traceEvents"]) {
+    if (e["ph"] == "M") {
+      thread_names.insert(e["args"]["name"].get<std::string>());
+    } else {
+      names.insert(e["name"].get<std::string>());
+    }
+  }
+
+  BOOST_TEST((names == std::set<std::string>{"main_scope", "other_scope", "other_instant"}));
+  BOOST_TEST(thread_names.count("main_thread") == 1);
+  BOOST_TEST(thread_names.count("other_thread") == 1);
+}
+
+BOOST_AUTO_TEST_CASE(stops_after_duration) {
+  const std::string filename = "tracing_test_window.json";
+  sv::tracing::set_output_file(filename);
+
+  BOOST_TEST(sv::tracing::start(std::chrono::milliseconds(10)));
+  { sv::tracing::scope s("in_window"); }
+  while (sv::tracing::is_recording()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  // waits for the file to be written
+  sv::tracing::stop();
+
+  const nlohmann::json trace = read_trace(filename);
+  bool found = false;
+  for (const auto &e : trace["traceEvents"]) {
+    found |= e["name"] == "in_window";
+  }
+  BOOST_TEST(found);
+}
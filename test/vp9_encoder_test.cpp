@@ -52,3 +52,81 @@ BOOST_AUTO_TEST_CASE(vp9_encoder) {
             << ", key_frames_count = " << key_frames_count;
   BOOST_TEST(min_key_frames_count <= key_frames_count);
 }
+
+BOOST_AUTO_TEST_CASE(vp9_encoder_yuv420p) {
+  const int number_of_frames = 10;
+  const int width = 16;
+  const int height = 8;
+  auto frames =
+      streams::publishers::range(0, number_of_frames) >> streams::map([](int i) {
+        owned_image_frame f;
+        f.id = {i, i};
+        f.pixel_format = image_pixel_format::YUV420P;
+        f.width = width;
+        f.height = height;
+        // strides are wider than planes, like in decoded frames
+        f.plane_strides[0] = 32;
+        f.plane_strides[1] = 32;
+        f.plane_strides[2] = 32;
+        f.plane_data[0] = std::string(32 * height, static_cast<char>(i * 10));
+        f.plane_data[1] = std::string(32 * height / 2, static_cast<char>(0x80));
+        f.plane_data[2] = std::string(32 * height / 2, static_cast<char>(0x80));
+        return owned_image_packet{f};
+      });
+
+  int metadata_count{0};
+  int frames_count{0};
+  auto encoded_stream = std::move(frames) >> encode_vp9(1);
+  auto when_done = encoded_stream->process(
+      [&metadata_count, &frames_count](encoded_packet &&packet) {
+        if (boost::get<encoded_metadata>(&packet) != nullptr) {
+          metadata_count++;
+        } else {
+          frames_count++;
+        }
+      });
+  BOOST_CHECK(when_done.ok());
+
+  BOOST_CHECK_EQUAL(1, metadata_count);
+  BOOST_CHECK_EQUAL(number_of_frames, frames_count);
+}
+
+BOOST_AUTO_TEST_CASE(vp9_encoder_realtime_preset) {
+  const vp9_encoder_profile profile = vp9_preset("realtime");
+  BOOST_CHECK_EQUAL(0, profile.lag_in_frames);
+  BOOST_CHECK(!profile.auto_alt_ref);
+
+  const int number_of_frames = 60;
+  auto frames =
+      streams::publishers::range(0, number_of_frames) >> streams::map([](int i) {
+        uint8_t pixel_data[] = {0xff, 0x88, 0x11};
+        owned_image_frame f;
+        f.id = {i, i};
+        f.pixel_format = image_pixel_format::RGB0;
+        f.width = 1;
+        f.height = 1;
+        f.plane_data[0] = std::string{pixel_data, pixel_data + sizeof(pixel_data)};
+        f.plane_strides[0] = 3;
+        return owned_image_packet{f};
+      });
+
+  int frames_count{0};
+  int frames_from_last_key_frame_count{0};
+  auto encoded_stream = std::move(frames) >> encode_vp9(profile);
+  auto when_done = encoded_stream->process(
+      [&frames_count, &frames_from_last_key_frame_count,
+       &profile](encoded_packet &&packet) {
+        if (const encoded_frame *f = boost::get<encoded_frame>(&packet)) {
+          if (f->key_frame) {
+            BOOST_TEST(frames_from_last_key_frame_count <= profile.keyframe_interval);
+            frames_from_last_key_frame_count = 0;
+          }
+          frames_from_last_key_frame_count++;
+          frames_count++;
+        }
+      });
+  BOOST_CHECK(when_done.ok());
+
+  // no lag, every frame is encoded right away
+  BOOST_CHECK_EQUAL(number_of_frames, frames_count);
+}